@@ -0,0 +1,158 @@
+#include "logserver.h"
+#include "qlogliteasynclogger.h"
+#include "qloglitelogger.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <benchmark/benchmark.h>
+#include <memory>
+
+namespace
+{
+
+const quint16 PORT = LogProtocol::DEFAULT_PORT + 2;
+const int FLUSH_INTERVAL = 4096;
+
+const int MESSAGE_COUNT = 1024;
+
+enum Api
+{
+    QSTRING_API,
+    DEFAULT_API,
+    UTF8_API,
+};
+
+QString message(qint64 i)
+{
+    return QString("Request %1 finished after %2 ms").arg(i).arg(i % 997);
+}
+
+// Formatting a message costs more than logging it, so the sync benchmarks
+// cycle through messages made up front.
+struct Messages
+{
+    Messages()
+    {
+        for (int i = 0; i < MESSAGE_COUNT; ++i)
+        {
+            text.append(message(i));
+            utf8.append(text.last().toUtf8());
+        }
+    }
+
+    QVector<QString> text;
+    QVector<QByteArray> utf8;
+};
+
+const Messages& messages()
+{
+    static Messages messages;
+    return messages;
+}
+
+void syncLog(benchmark::State& state, Api api)
+{
+    QLogLiteLogger logger;
+    logger.setDefaultModule("bench");
+    logger.setDefaultChannel("sync");
+    logger.connectToLocal(LogServer::localName(PORT), QCoreApplication::applicationPid(), "bench", "loglite-client-bench");
+    logger.flush();
+    auto& text = messages().text;
+    auto& utf8 = messages().utf8;
+    qint64 i = 0;
+    for (auto _ : state)
+    {
+        auto index = i % MESSAGE_COUNT;
+        switch (api)
+        {
+        case QSTRING_API:
+            logger.log(QLogLiteLogger::SEVERITY_INFO, QString("bench"), QString("sync"), text[index]);
+            break;
+        case DEFAULT_API:
+            logger.info(text[index]);
+            break;
+        case UTF8_API:
+            logger.info(utf8[index]);
+            break;
+        }
+        if (++i % FLUSH_INTERVAL == 0)
+        {
+            // The synchronous logger only writes from the event loop of the
+            // calling thread, which this loop never returns to.
+            state.PauseTiming();
+            logger.flush();
+            QCoreApplication::processEvents();
+            state.ResumeTiming();
+        }
+    }
+    logger.flush();
+    state.SetItemsProcessed(state.iterations());
+}
+
+void asyncLog(benchmark::State& state, QLogLiteAsyncLogger* logger)
+{
+    qint64 i = 0;
+    qint64 dropped = 0;
+    for (auto _ : state)
+    {
+        dropped += !logger->log(QLogLiteLogger::SEVERITY_INFO, "bench", "async", message(i++));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["dropped"] = benchmark::Counter(dropped);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication a(argc, argv);
+
+    QThread serverThread;
+    auto server = new LogServer;
+    server->moveToThread(&serverThread);
+    QObject::connect(server, &LogServer::messagesReceived, server, [](const QVector<LogMessage*>& received)
+    {
+        qDeleteAll(received);
+    });
+    QObject::connect(&serverThread, &QThread::finished, server, &QObject::deleteLater);
+    serverThread.start();
+    bool listening = false;
+    QMetaObject::invokeMethod(server, [&]()
+    {
+        listening = server->listen(PORT);
+    }, Qt::BlockingQueuedConnection);
+    if (!listening)
+    {
+        qCritical("Could not listen on port %d", PORT);
+        serverThread.quit();
+        serverThread.wait();
+        return 1;
+    }
+
+    std::unique_ptr<QLogLiteAsyncLogger> drop(new QLogLiteAsyncLogger(65536, QLogLiteAsyncLogger::DropWhenFull));
+    std::unique_ptr<QLogLiteAsyncLogger> block(new QLogLiteAsyncLogger(65536, QLogLiteAsyncLogger::BlockWhenFull));
+    drop->connectToLocal(LogServer::localName(PORT), a.applicationPid(), "bench", "loglite-client-bench");
+    block->connectToLocal(LogServer::localName(PORT), a.applicationPid(), "bench", "loglite-client-bench");
+    drop->flush();
+    block->flush();
+
+    messages();
+    benchmark::RegisterBenchmark("SyncLog/QString", syncLog, QSTRING_API);
+    benchmark::RegisterBenchmark("SyncLog/Default", syncLog, DEFAULT_API);
+    benchmark::RegisterBenchmark("SyncLog/Utf8", syncLog, UTF8_API);
+    benchmark::RegisterBenchmark("AsyncLog/Drop", asyncLog, drop.get())->Threads(1)->Threads(4);
+    benchmark::RegisterBenchmark("AsyncLog/Block", asyncLog, block.get())->Threads(1)->Threads(4);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    drop.reset();
+    block.reset();
+    serverThread.quit();
+    serverThread.wait();
+    return 0;
+}
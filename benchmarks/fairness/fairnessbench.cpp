@@ -0,0 +1,237 @@
+#include "loadgenerator.h"
+#include "logfilter.h"
+#include "logmodel.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+
+namespace
+{
+
+const quint64 FLOOD_PID = 1000000;
+const quint64 SLOW_PID = 2000000;
+const quint64 BURST_PID = 3000000;
+
+double percentile(const QVector<qint64>& sorted, double fraction)
+{
+    if (sorted.isEmpty())
+    {
+        return 0;
+    }
+    auto index = std::min<qsizetype>(sorted.size() - 1, qsizetype(fraction * sorted.size()));
+    return sorted[index] / 1e6;
+}
+
+LoadGenerator* startGenerator(const LoadGenerator::Settings& settings, QThread& thread)
+{
+    auto generator = new LoadGenerator(settings);
+    generator->moveToThread(&thread);
+    QObject::connect(&thread, &QThread::started, generator, &LoadGenerator::start);
+    QObject::connect(&thread, &QThread::finished, generator, &QObject::deleteLater);
+    thread.start();
+    return generator;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication a(argc, argv);
+    a.setApplicationName("loglite-fairness-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Checks that one flooding client does not starve slow clients or the event loop");
+    parser.addHelpOption();
+    QCommandLineOption portOption(QStringList() << "p" << "port", "Port used for the benchmark server.", "port", QString::number(LogProtocol::DEFAULT_PORT + 2));
+    QCommandLineOption slowClientsOption(QStringList() << "c" << "slow-clients", "Number of slow clients.", "count", "8");
+    QCommandLineOption slowRateOption(QStringList() << "r" << "slow-rate", "Messages per second sent by each slow client.", "rate", "20");
+    QCommandLineOption durationOption(QStringList() << "d" << "duration", "Seconds the slow clients send for.", "seconds", "10");
+    QCommandLineOption burstOption("burst", "Messages sent by a client that disconnects right after sending them.", "count", "20000");
+    QCommandLineOption floodSizeOption("flood-size", "Flood message size in bytes as min[:max].", "size", "256:1024");
+    QCommandLineOption maxLatencyOption("max-p99", "Fail when the slow clients' p99 latency exceeds this many milliseconds.", "ms", "250");
+    QCommandLineOption jsonOption("json", "Write the results as JSON to a file.", "file");
+    parser.addOptions({portOption, slowClientsOption, slowRateOption, durationOption, burstOption, floodSizeOption, maxLatencyOption, jsonOption});
+    parser.process(a);
+
+    auto port = parser.value(portOption).toUShort();
+    auto duration = std::max(1, parser.value(durationOption).toInt());
+
+    LoadGenerator::Settings flood;
+    flood.port = port;
+    flood.connections = 1;
+    flood.messagesPerConnection = 0;
+    auto sizes = parser.value(floodSizeOption).split(':');
+    flood.minSize = sizes.value(0).toInt();
+    flood.maxSize = std::max(flood.minSize, sizes.value(1, sizes.value(0)).toInt());
+    flood.firstPid = FLOOD_PID;
+
+    LoadGenerator::Settings slow;
+    slow.port = port;
+    slow.connections = std::max(1, parser.value(slowClientsOption).toInt());
+    auto slowRate = std::max(1.0, parser.value(slowRateOption).toDouble());
+    slow.rate = slowRate * slow.connections;
+    slow.messagesPerConnection = qint64(slowRate * duration);
+    slow.stampLatency = true;
+    slow.firstPid = SLOW_PID;
+    slow.seed = 2;
+    qint64 expected = slow.connections * slow.messagesPerConnection;
+
+    LoadGenerator::Settings burst;
+    burst.port = port;
+    burst.connections = 1;
+    burst.messagesPerConnection = std::max(0, parser.value(burstOption).toInt());
+    burst.firstPid = BURST_PID;
+    burst.seed = 3;
+
+    LogModel model(nullptr, port);
+    if (!model.isListening())
+    {
+        qCritical() << "Could not listen on port" << port;
+        return 1;
+    }
+    LogFilter filter;
+    filter.setSourceModel(&model);
+
+    QVector<qint64> latencies;
+    qint64 received = 0;
+    qint64 flooded = 0;
+    qint64 bursted = 0;
+    QObject::connect(&filter, &QAbstractItemModel::rowsInserted, [&](const QModelIndex&, int first, int last)
+    {
+        auto now = LoadGenerator::steadyNanoseconds();
+        for (int row = first; row <= last; ++row)
+        {
+            auto message = model.message(filter.mapToSource(filter.index(row, 0)).row());
+            if (!message || message->isMultilineContinuation)
+            {
+                continue;
+            }
+            qint64 stamp;
+            if (message->pid >= BURST_PID)
+            {
+                ++bursted;
+            }
+            else if (message->pid >= SLOW_PID && LoadGenerator::parseLatencyStamp(message->originalMessage, stamp))
+            {
+                latencies.append(now - stamp);
+                ++received;
+            }
+            else if (message->pid >= FLOOD_PID && message->pid < SLOW_PID)
+            {
+                ++flooded;
+            }
+        }
+    });
+
+    // Keep memory bounded while the flood runs.
+    QTimer trim;
+    QObject::connect(&trim, &QTimer::timeout, &model, [&]()
+    {
+        if (model.rowCount() > 200000)
+        {
+            model.clear();
+        }
+    });
+    trim.start(500);
+
+    // The gap between ticks of a 10 ms timer shows how long the event loop
+    // was kept busy by reads.
+    QVector<qint64> stalls;
+    QElapsedTimer tickClock;
+    QTimer tick;
+    tick.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&tick, &QTimer::timeout, [&]()
+    {
+        stalls.append(tickClock.nsecsElapsed());
+        tickClock.restart();
+    });
+
+    QThread floodThread;
+    QThread slowThread;
+    QThread burstThread;
+    auto floodGenerator = startGenerator(flood, floodThread);
+    // Let the flood build a backlog before the slow clients connect.
+    QTimer::singleShot(500, [&]()
+    {
+        startGenerator(slow, slowThread);
+        if (burst.messagesPerConnection)
+        {
+            startGenerator(burst, burstThread);
+        }
+        tickClock.start();
+        tick.start(10);
+    });
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 timeout = (duration + 10) * qint64(1000);
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, &a, [&]()
+    {
+        if ((received >= expected && bursted >= burst.messagesPerConnection) || clock.elapsed() > timeout)
+        {
+            QCoreApplication::quit();
+        }
+    });
+    poll.start(10);
+    a.exec();
+
+    QMetaObject::invokeMethod(floodGenerator, &LoadGenerator::stop, Qt::BlockingQueuedConnection);
+    floodThread.quit();
+    slowThread.quit();
+    burstThread.quit();
+    floodThread.wait();
+    slowThread.wait();
+    burstThread.wait();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(stalls.begin(), stalls.end());
+    double maxP99 = parser.value(maxLatencyOption).toDouble();
+    bool passed = received >= expected && bursted >= burst.messagesPerConnection && flooded > 0 && percentile(latencies, 0.99) <= maxP99;
+
+    QJsonObject result;
+    result["slowClients"] = slow.connections;
+    result["expected"] = expected;
+    result["received"] = received;
+    result["flooded"] = flooded;
+    result["burstExpected"] = burst.messagesPerConnection;
+    result["burstReceived"] = bursted;
+    result["latencyP50Ms"] = percentile(latencies, 0.5);
+    result["latencyP99Ms"] = percentile(latencies, 0.99);
+    result["latencyMaxMs"] = percentile(latencies, 1);
+    result["stallP99Ms"] = percentile(stalls, 0.99);
+    result["stallMaxMs"] = percentile(stalls, 1);
+    result["passed"] = passed;
+
+    QTextStream out(stdout);
+    out << "slow clients received " << received << "/" << expected << " messages, flood delivered " << flooded << "\n"
+        << "burst client received " << bursted << "/" << burst.messagesPerConnection << " messages\n"
+        << "slow latency p50 " << percentile(latencies, 0.5) << " ms, p99 " << percentile(latencies, 0.99)
+        << " ms, max " << percentile(latencies, 1) << " ms\n"
+        << "event loop gap p99 " << percentile(stalls, 0.99) << " ms, max " << percentile(stalls, 1) << " ms\n"
+        << (passed ? "PASS" : "FAIL") << "\n";
+
+    if (parser.isSet(jsonOption))
+    {
+        QFile file(parser.value(jsonOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qCritical() << "Could not write" << file.fileName();
+            return 1;
+        }
+        file.write(QJsonDocument(result).toJson());
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+#include "loadgenerator.h"
+#include "logfilter.h"
+#include "logmodel.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+
+namespace
+{
+
+struct Memory
+{
+    qint64 rss;
+    qint64 peak;
+};
+
+Memory readMemory()
+{
+    Memory memory = {0, 0};
+#ifdef Q_OS_LINUX
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        auto lines = status.readAll().split('\n');
+        for (auto it = lines.begin(); it != lines.end(); ++it)
+        {
+            auto fields = it->simplified().split(' ');
+            if (fields.size() < 2)
+            {
+                continue;
+            }
+            if (fields[0] == "VmRSS:")
+            {
+                memory.rss = fields[1].toLongLong();
+            }
+            else if (fields[0] == "VmHWM:")
+            {
+                memory.peak = fields[1].toLongLong();
+            }
+        }
+    }
+#endif
+    return memory;
+}
+
+double percentile(const QVector<qint64>& sorted, double fraction)
+{
+    if (sorted.isEmpty())
+    {
+        return 0;
+    }
+    auto index = std::min<qsizetype>(sorted.size() - 1, qsizetype(fraction * sorted.size()));
+    return sorted[index] / 1000.0;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication a(argc, argv);
+    a.setApplicationName("loglite-ingestion-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures LogModel ingestion throughput, latency and memory");
+    parser.addHelpOption();
+    QCommandLineOption portOption(QStringList() << "p" << "port", "Port used for the benchmark server.", "port", QString::number(LogProtocol::DEFAULT_PORT + 1));
+    QCommandLineOption connectionsOption(QStringList() << "c" << "connections", "Number of concurrent connections.", "count", "4");
+    QCommandLineOption messagesOption(QStringList() << "n" << "messages", "Messages per connection.", "count", "250000");
+    QCommandLineOption rateOption(QStringList() << "r" << "rate", "Total messages per second, 0 for unthrottled.", "rate", "0");
+    QCommandLineOption sizeOption(QStringList() << "s" << "size", "Message size in bytes as min[:max].", "size", "32:256");
+    QCommandLineOption multilineOption("multiline", "Fraction of messages containing line breaks.", "ratio", "0.05");
+    QCommandLineOption breakLinesOption("break-lines", "Split multi-line messages into rows.");
+    QCommandLineOption timeoutOption("timeout", "Seconds to wait for all messages.", "seconds", "300");
+    QCommandLineOption jsonOption("json", "Write the results as JSON to a file.", "file");
+    parser.addOptions({portOption, connectionsOption, messagesOption, rateOption, sizeOption, multilineOption,
+                       breakLinesOption, timeoutOption, jsonOption});
+    parser.process(a);
+
+    LoadGenerator::Settings settings;
+    settings.port = parser.value(portOption).toUShort();
+    settings.connections = std::max(1, parser.value(connectionsOption).toInt());
+    settings.messagesPerConnection = std::max<qint64>(1, parser.value(messagesOption).toLongLong());
+    settings.rate = parser.value(rateOption).toDouble();
+    auto sizes = parser.value(sizeOption).split(':');
+    settings.minSize = sizes.value(0).toInt();
+    settings.maxSize = std::max(settings.minSize, sizes.value(1, sizes.value(0)).toInt());
+    settings.multilineRatio = parser.value(multilineOption).toDouble();
+    settings.stampLatency = true;
+    qint64 expected = settings.connections * settings.messagesPerConnection;
+
+    auto baseline = readMemory();
+
+    LogModel model(nullptr, settings.port);
+    if (!model.isListening())
+    {
+        qCritical() << "Could not listen on port" << settings.port;
+        return 1;
+    }
+    model.setBreakLines(parser.isSet(breakLinesOption));
+    LogFilter filter;
+    filter.setSourceModel(&model);
+
+    QVector<qint64> latencies;
+    latencies.reserve(expected);
+    qint64 received = 0;
+    QElapsedTimer clock;
+    qint64 lastReceived = 0;
+    QObject::connect(&filter, &QAbstractItemModel::rowsInserted, [&](const QModelIndex&, int first, int last)
+    {
+        auto now = LoadGenerator::steadyNanoseconds();
+        for (int row = first; row <= last; ++row)
+        {
+            auto message = model.message(filter.mapToSource(filter.index(row, 0)).row());
+            qint64 stamp;
+            if (message && !message->isMultilineContinuation && LoadGenerator::parseLatencyStamp(message->originalMessage, stamp))
+            {
+                latencies.append(now - stamp);
+                ++received;
+            }
+        }
+        lastReceived = clock.nsecsElapsed();
+    });
+
+    QThread thread;
+    auto generator = new LoadGenerator(settings);
+    generator->moveToThread(&thread);
+    QObject::connect(&thread, &QThread::started, generator, &LoadGenerator::start);
+    QObject::connect(&thread, &QThread::finished, generator, &QObject::deleteLater);
+
+    auto timeout = parser.value(timeoutOption).toLongLong() * 1000;
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, &a, [&]()
+    {
+        if (received >= expected || clock.elapsed() > timeout)
+        {
+            QCoreApplication::quit();
+        }
+    });
+    clock.start();
+    thread.start();
+    poll.start(10);
+    a.exec();
+
+    thread.quit();
+    thread.wait();
+
+    auto memory = readMemory();
+    std::sort(latencies.begin(), latencies.end());
+    double seconds = std::max<qint64>(1, lastReceived) / 1e9;
+
+    QJsonObject result;
+    result["connections"] = settings.connections;
+    result["expected"] = expected;
+    result["received"] = received;
+    result["seconds"] = seconds;
+    result["messagesPerSecond"] = received / seconds;
+    result["latencyP50Us"] = percentile(latencies, 0.5);
+    result["latencyP99Us"] = percentile(latencies, 0.99);
+    result["rssBaselineKb"] = baseline.rss;
+    result["rssKb"] = memory.rss;
+    result["rssPeakKb"] = memory.peak;
+    result["rows"] = model.rowCount();
+
+    QTextStream out(stdout);
+    out << "received " << received << "/" << expected << " messages in " << seconds << " s\n"
+        << "throughput " << qint64(received / seconds) << " msg/s\n"
+        << "latency p50 " << percentile(latencies, 0.5) << " us, p99 " << percentile(latencies, 0.99) << " us\n"
+        << "rss " << memory.rss << " kB (baseline " << baseline.rss << " kB, peak " << memory.peak << " kB)\n";
+
+    if (parser.isSet(jsonOption))
+    {
+        QFile file(parser.value(jsonOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qCritical() << "Could not write" << file.fileName();
+            return 1;
+        }
+        file.write(QJsonDocument(result).toJson());
+    }
+    return received >= expected ? 0 : 1;
+}
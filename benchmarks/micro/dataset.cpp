@@ -0,0 +1,231 @@
+#include "dataset.h"
+#include "logmap.h"
+#include "logmonitorfilemodel.h"
+#include "logview.h"
+
+namespace
+{
+
+const qint64 BASE_TIMESTAMP = 1767225600000;
+
+const char* s_words[] = {
+    "client", "server", "frame", "update", "request", "response", "entity", "buffer",
+    "texture", "network", "session", "packet", "state", "timeout", "resource", "load",
+};
+
+const char* s_modules[] = {
+    "network", "render", "audio", "script",
+};
+
+const char* s_channels[] = {
+    "general", "io", "timing", "memory",
+};
+
+quint64 mix(quint64 value)
+{
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+}
+
+
+BenchModel::BenchModel(QObject* parent)
+    :AbstractLogModel(parent),
+      m_committed(0)
+{
+    m_statistics.error = 0;
+    m_statistics.warning = 0;
+    m_statistics.notice = 0;
+    m_statistics.info = 0;
+    m_statistics.clients = 0;
+    m_statistics.dropped = 0;
+}
+
+const BenchModel::Statistics &BenchModel::statistics() const
+{
+    return m_statistics;
+}
+
+bool BenchModel::isListening() const
+{
+    return false;
+}
+
+void BenchModel::append(LogMessage* message)
+{
+    addMessage(message);
+}
+
+void BenchModel::commit()
+{
+    if (m_messages.size() > m_committed)
+    {
+        beginInsertRows(QModelIndex(), m_committed, m_messages.size() - 1);
+        endInsertRows();
+        m_committed = m_messages.size();
+    }
+    emitFoldedRows();
+}
+
+void BenchModel::clear()
+{
+    if (!m_messages.size())
+    {
+        return;
+    }
+    beginRemoveRows(QModelIndex(), 0, m_messages.size() - 1);
+    deleteMessages();
+    m_committed = 0;
+    endRemoveRows();
+}
+
+
+const char* Dataset::NEEDLE = "needle-in-the-haystack";
+
+Dataset& Dataset::get(int rows)
+{
+    static std::unique_ptr<Dataset> s_dataset;
+    if (!s_dataset || s_dataset->rows() != rows)
+    {
+        s_dataset.reset();
+        s_dataset.reset(new Dataset(rows));
+    }
+    return *s_dataset;
+}
+
+LogMessage* Dataset::makeMessage(int row)
+{
+    auto random = mix(quint64(row));
+    auto message = new LogMessage;
+    message->timestamp.setMSecsSinceEpoch(BASE_TIMESTAMP + qint64(row) * 7);
+    message->pid = 1000 + random % 8;
+    auto severity = (random >> 8) % 100;
+    message->severity = severity < 70 ? SEVERITY_INFO : severity < 90 ? SEVERITY_NOTICE : severity < 98 ? SEVERITY_WARN : SEVERITY_ERR;
+    message->machineName = "bench";
+    message->executablePath = QString("C:/bench/process%1.exe").arg(message->pid);
+    message->module = s_modules[(random >> 16) % 4];
+    message->channel = s_channels[(random >> 20) % 4];
+    int words = 4 + (random >> 24) % 24;
+    bool multiline = (random >> 32) % 100 < 5;
+    for (int i = 0; i < words; ++i)
+    {
+        if (i)
+        {
+            message->message.append(multiline && i % 6 == 0 ? '\n' : ' ');
+        }
+        message->message.append(s_words[mix(random + i) % 16]);
+    }
+    message->isMultilineContinuation = false;
+    return message;
+}
+
+Filter Dataset::makeFilter(Filter::Operator op, const QString& operand)
+{
+    Filter filter;
+    filter.m_juncture = Filter::AND;
+    Filter::Condition severity;
+    severity.m_field = LOGFIELD_SEVERITY;
+    severity.m_op = Filter::GTE;
+    severity.m_operand = SEVERITY_NOTICE;
+    filter.m_conditions.append(severity);
+    Filter::Condition message;
+    message.m_field = LOGFIELD_MESSAGE;
+    message.m_op = op;
+    message.m_operand = operand;
+    filter.m_conditions.append(message);
+    filter.prepare();
+    return filter;
+}
+
+HighlightSet Dataset::makeHighlights()
+{
+    HighlightSet set;
+    const char* words[] = {"timeout", "packet", "texture"};
+    const QColor colors[] = {QColor(255, 200, 200), QColor(200, 255, 200), QColor(200, 200, 255)};
+    for (int i = 0; i < 3; ++i)
+    {
+        HighlightSet::Highlight highlight;
+        highlight.m_background = colors[i];
+        highlight.m_juncture = Filter::OR;
+        Filter::Condition condition;
+        condition.m_field = LOGFIELD_MESSAGE;
+        condition.m_op = Filter::CONTAINS;
+        condition.m_operand = words[i];
+        highlight.m_conditions.append(condition);
+        set.m_highlights.append(highlight);
+    }
+    set.prepare();
+    return set;
+}
+
+Dataset::Dataset(int rows)
+    :m_rows(rows),
+      m_model(new BenchModel)
+{
+    for (int i = 0; i < rows - 1; ++i)
+    {
+        m_model->append(makeMessage(i));
+    }
+    auto last = makeMessage(rows - 1);
+    last->message = NEEDLE;
+    m_model->append(last);
+    m_model->commit();
+
+    m_filter.reset(new LogFilter);
+    m_filter->setSourceModel(m_model.get());
+    m_view.reset(new LogView);
+    m_view->setModel(m_filter.get());
+    m_map.reset(new LogMap);
+    m_map->setModel(m_filter.get());
+    m_map->setBuddyView(m_view.get());
+    m_map->resize(16, 1024);
+}
+
+Dataset::~Dataset()
+{
+    m_map.reset();
+    m_view.reset();
+    m_filter.reset();
+    m_model.reset();
+}
+
+int Dataset::rows() const
+{
+    return m_rows;
+}
+
+BenchModel* Dataset::model() const
+{
+    return m_model.get();
+}
+
+LogFilter* Dataset::filter() const
+{
+    return m_filter.get();
+}
+
+LogView* Dataset::view() const
+{
+    return m_view.get();
+}
+
+LogMap* Dataset::map() const
+{
+    return m_map.get();
+}
+
+QString Dataset::lswPath()
+{
+    if (m_lswPath.isEmpty())
+    {
+        auto path = m_directory.filePath("dataset.lsw");
+        if (LogMonitorFileModel::saveModel(m_model.get(), path))
+        {
+            m_lswPath = path;
+        }
+    }
+    return m_lswPath;
+}
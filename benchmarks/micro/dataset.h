@@ -0,0 +1,61 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <QTemporaryDir>
+#include <memory>
+#include "abstractlogmodel.h"
+#include "logfilter.h"
+
+class LogMap;
+class LogView;
+
+
+class BenchModel : public AbstractLogModel
+{
+public:
+    BenchModel(QObject* parent = nullptr);
+
+    const Statistics &statistics() const;
+    bool isListening() const;
+
+    void append(LogMessage* message);
+    void commit();
+public slots:
+    void clear();
+private:
+    Statistics m_statistics;
+    int m_committed;
+};
+
+
+class Dataset
+{
+public:
+    static const char* NEEDLE;
+
+    static Dataset& get(int rows);
+    static LogMessage* makeMessage(int row);
+    static Filter makeFilter(Filter::Operator op, const QString& operand);
+    static HighlightSet makeHighlights();
+
+    ~Dataset();
+
+    int rows() const;
+    BenchModel* model() const;
+    LogFilter* filter() const;
+    LogView* view() const;
+    LogMap* map() const;
+    QString lswPath();
+private:
+    Dataset(int rows);
+
+    int m_rows;
+    std::unique_ptr<BenchModel> m_model;
+    std::unique_ptr<LogFilter> m_filter;
+    std::unique_ptr<LogView> m_view;
+    std::unique_ptr<LogMap> m_map;
+    QTemporaryDir m_directory;
+    QString m_lswPath;
+};
+
+#endif // DATASET_H
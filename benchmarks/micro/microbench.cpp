@@ -0,0 +1,304 @@
+#include "dataset.h"
+#include "logmap.h"
+#include "logmonitorfilemodel.h"
+#include "logview.h"
+#include "reorderbuffer.h"
+#include "templateminer.h"
+#include <QApplication>
+#include <QItemSelectionModel>
+#include <QTemporaryDir>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+void addMessage(benchmark::State& state, int rows)
+{
+    for (auto _ : state)
+    {
+        BenchModel model;
+        for (int i = 0; i < rows; ++i)
+        {
+            model.append(Dataset::makeMessage(i));
+        }
+        model.commit();
+        state.PauseTiming();
+        model.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void addMessageFolded(benchmark::State& state, int rows)
+{
+    // Bursts of a thousand identical messages, the worst case for a client
+    // logging in a tight loop.
+    for (auto _ : state)
+    {
+        BenchModel model;
+        model.setFoldRepeats(true);
+        for (int i = 0; i < rows; ++i)
+        {
+            model.append(Dataset::makeMessage(i / 1000));
+        }
+        model.commit();
+        state.PauseTiming();
+        model.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void reorderMessages(benchmark::State& state, int rows)
+{
+    // Eight clients whose clocks are up to 350 ms apart, arriving a thousand
+    // messages per millisecond behind a one second window.
+    const int batch = 1000;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        QVector<LogMessage*> messages;
+        messages.reserve(rows);
+        for (int i = 0; i < rows; ++i)
+        {
+            auto message = Dataset::makeMessage(i);
+            message->timestamp = message->timestamp.addMSecs(qint64(message->pid % 8) * 50);
+            messages.append(message);
+        }
+        QVector<LogMessage*> released;
+        released.reserve(rows);
+        state.ResumeTiming();
+
+        ReorderBuffer buffer;
+        buffer.setMaxDelay(1000);
+        for (int i = 0; i < rows; ++i)
+        {
+            buffer.add(messages[i], i / batch);
+            if (i % batch == batch - 1)
+            {
+                buffer.take(i / batch, released);
+            }
+        }
+        buffer.takeAll(released);
+
+        state.PauseTiming();
+        state.counters["late"] = double(buffer.late());
+        qDeleteAll(released);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void mineTemplates(benchmark::State& state, int rows)
+{
+    // Mining runs off the GUI thread but has to keep up with ingestion, so
+    // messages carry a counter and an id the miner needs to generalise.
+    QVector<QString> messages;
+    messages.reserve(rows);
+    for (int i = 0; i < rows; ++i)
+    {
+        std::unique_ptr<LogMessage> message(Dataset::makeMessage(i % 4096));
+        messages.append(QString("%1 id=%2 after %3ms").arg(message->message).arg(i).arg(i % 997));
+    }
+    for (auto _ : state)
+    {
+        TemplateMiner miner;
+        for (auto it = messages.begin(); it != messages.end(); ++it)
+        {
+            benchmark::DoNotOptimize(miner.add(*it));
+        }
+        state.counters["templates"] = miner.size();
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void dataRole(benchmark::State& state, int rows, int role)
+{
+    auto model = Dataset::get(rows).model();
+    int columns = model->columnCount();
+    for (auto _ : state)
+    {
+        for (int row = 0; row < rows; ++row)
+        {
+            for (int column = 0; column < columns; ++column)
+            {
+                benchmark::DoNotOptimize(model->data(model->index(row, column), role));
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * rows * columns);
+}
+
+void headerDecoration(benchmark::State& state, int rows)
+{
+    auto model = Dataset::get(rows).model();
+    for (auto _ : state)
+    {
+        for (int row = 0; row < rows; ++row)
+        {
+            benchmark::DoNotOptimize(model->headerData(row, Qt::Vertical, Qt::DecorationRole));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void filterAcceptsRow(benchmark::State& state, int rows, Filter::Operator op, QString operand)
+{
+    auto filter = Dataset::get(rows).filter();
+    auto custom = Dataset::makeFilter(op, operand);
+    filter->setCustomFilter(operand.isNull() ? nullptr : &custom);
+    for (auto _ : state)
+    {
+        int accepted = 0;
+        for (int row = 0; row < rows; ++row)
+        {
+            accepted += filter->filterAcceptsRow(row, QModelIndex());
+        }
+        benchmark::DoNotOptimize(accepted);
+    }
+    filter->setCustomFilter(nullptr);
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void highlightBackground(benchmark::State& state, int rows)
+{
+    auto model = Dataset::get(rows).model();
+    auto highlights = Dataset::makeHighlights();
+    for (auto _ : state)
+    {
+        for (int row = 0; row < rows; ++row)
+        {
+            benchmark::DoNotOptimize(highlights.getBackgroundColor(model->message(row)));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void paintMap(benchmark::State& state, int rows)
+{
+    auto map = Dataset::get(rows).map();
+    map->grab();
+    for (auto _ : state)
+    {
+        map->invalidateMap();
+        benchmark::DoNotOptimize(map->grab());
+    }
+}
+
+void selectNextMatching(benchmark::State& state, int rows)
+{
+    auto& dataset = Dataset::get(rows);
+    auto view = dataset.view();
+    auto first = dataset.filter()->index(0, 0);
+    for (auto _ : state)
+    {
+        view->selectionModel()->setCurrentIndex(first, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+        view->selectNextMatching(Dataset::NEEDLE);
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void saveModel(benchmark::State& state, int rows)
+{
+    auto model = Dataset::get(rows).model();
+    QTemporaryDir directory;
+    auto path = directory.filePath("save.lsw");
+    for (auto _ : state)
+    {
+        if (!LogMonitorFileModel::saveModel(model, path))
+        {
+            state.SkipWithError("save failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void loadModel(benchmark::State& state, int rows)
+{
+    auto path = Dataset::get(rows).lswPath();
+    if (path.isEmpty())
+    {
+        state.SkipWithError("could not create the dataset file");
+        return;
+    }
+    for (auto _ : state)
+    {
+        LogMonitorFileModel model(path);
+        benchmark::DoNotOptimize(model.rowCount());
+    }
+    state.SetItemsProcessed(state.iterations() * rows);
+}
+
+void registerBenchmarks(int rows)
+{
+    auto name = [rows](const char* benchmark)
+    {
+        return std::string(benchmark) + "/" + std::to_string(rows);
+    };
+    benchmark::RegisterBenchmark(name("AddMessage"), addMessage, rows)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("AddMessage/Folded"), addMessageFolded, rows)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("TemplateMiner/Add"), mineTemplates, rows)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("ReorderBuffer/Merge"), reorderMessages, rows)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("Data/Display"), dataRole, rows, int(Qt::DisplayRole))->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("Data/Background"), dataRole, rows, int(Qt::BackgroundRole))->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("HeaderData/Decoration"), headerDecoration, rows)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("FilterAcceptsRow/Severity"), filterAcceptsRow, rows, Filter::EQUALS, QString())->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("FilterAcceptsRow/Contains"), filterAcceptsRow, rows, Filter::CONTAINS, QString("timeout"))->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("FilterAcceptsRow/Matches"), filterAcceptsRow, rows, Filter::MATCHES, QString("time(out|r)"))->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("HighlightSet/Background"), highlightBackground, rows)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("LogMap/Paint"), paintMap, rows)->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark(name("LogView/SelectNextMatching"), selectNextMatching, rows)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("LogMonitorFileModel/Save"), saveModel, rows)->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(name("LogMonitorFileModel/Load"), loadModel, rows)->Unit(benchmark::kMillisecond);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    std::vector<int> sizes = {100000, 1000000, 10000000};
+    const char* rowsFlag = "--loglite_rows=";
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], rowsFlag, strlen(rowsFlag)) == 0)
+        {
+            sizes.clear();
+            auto values = QByteArray(argv[i] + strlen(rowsFlag)).split(',');
+            for (auto it = values.begin(); it != values.end(); ++it)
+            {
+                sizes.push_back(it->toInt());
+            }
+            std::copy(argv + i + 1, argv + argc, argv + i);
+            --argc;
+            --i;
+        }
+    }
+
+    QApplication a(argc, argv);
+    for (auto it = sizes.begin(); it != sizes.end(); ++it)
+    {
+        if (*it > 0)
+        {
+            registerBenchmarks(*it);
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
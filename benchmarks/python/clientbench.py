@@ -0,0 +1,62 @@
+"""Records per second through the Python client against a running LogLite or loglite-collector."""
+import argparse
+import json
+import logging
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'clients'))
+import python as loglite  # noqa: E402
+
+
+def run(name, client, records, log):
+    start = time.perf_counter()
+    for i in range(records):
+        log(i)
+    logged = time.perf_counter() - start
+    flushed = client.flush(120)
+    total = time.perf_counter() - start
+    return {'benchmark': name, 'records': records, 'flushed': flushed, 'dropped': client.dropped,
+            'loggedPerSecond': records / logged, 'sentPerSecond': records / total}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--server', default='127.0.0.1')
+    parser.add_argument('-p', '--port', type=int, default=loglite.PORT)
+    parser.add_argument('-n', '--records', type=int, default=200000)
+    parser.add_argument('-s', '--size', type=int, default=80, help='message size in bytes')
+    parser.add_argument('--capacity', type=int, default=1 << 20, help='client queue capacity')
+    parser.add_argument('--json', help='write the results as JSON to a file')
+    args = parser.parse_args()
+
+    messages = ['%d ' % i + 'x' * max(0, args.size - 8) for i in range(1024)]
+    results = []
+
+    client = loglite.LogLiteClient(args.server, port=args.port, capacity=args.capacity)
+    if not client.flush(10):
+        print('Could not connect to %s:%d' % (args.server, args.port), file=sys.stderr)
+        return 1
+    results.append(run('client', client, args.records,
+                       lambda i: client.log(loglite.Severity.INFO, messages[i % 1024], module='bench', channel='py')))
+
+    logger = logging.getLogger('bench.handler')
+    logger.propagate = False
+    logger.setLevel(logging.INFO)
+    logger.addHandler(loglite.LogLiteHandler(client))
+    results.append(run('handler', client, args.records, lambda i: logger.info(messages[i % 1024])))
+    client.close()
+
+    for result in results:
+        print('%s: %d records, %d logged/s, %d sent/s, %d dropped%s' % (
+            result['benchmark'], result['records'], result['loggedPerSecond'], result['sentPerSecond'],
+            result['dropped'], '' if result['flushed'] else ', flush timed out'))
+    if args.json:
+        with open(args.json, 'w') as file:
+            json.dump(results, file, indent=4)
+    return 0 if all(result['flushed'] for result in results) else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
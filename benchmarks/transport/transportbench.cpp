@@ -0,0 +1,175 @@
+#include "loadgenerator.h"
+#include "logserver.h"
+#include "sharedring.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+
+namespace
+{
+
+struct Result
+{
+    QString transport;
+    qint64 received;
+    double seconds;
+    double latencyP50;
+    double latencyP99;
+};
+
+double percentile(const QVector<qint64>& sorted, double fraction)
+{
+    if (sorted.isEmpty())
+    {
+        return 0;
+    }
+    auto index = std::min<qsizetype>(sorted.size() - 1, qsizetype(fraction * sorted.size()));
+    return sorted[index] / 1000.0;
+}
+
+Result run(const QString& transport, LoadGenerator::Settings settings, qint64 timeout)
+{
+    Result result = {transport, 0, 0, 0, 0};
+    LogServer server;
+    if (!server.listen(settings.port))
+    {
+        return result;
+    }
+    qint64 expected = settings.connections * settings.messagesPerConnection;
+    QVector<qint64> latencies;
+    latencies.reserve(expected);
+    QElapsedTimer clock;
+    QEventLoop loop;
+    QObject::connect(&server, &LogServer::messagesReceived, [&](const QVector<LogMessage*>& messages)
+    {
+        auto now = LoadGenerator::steadyNanoseconds();
+        for (auto it = messages.begin(); it != messages.end(); ++it)
+        {
+            qint64 stamp;
+            if (LoadGenerator::parseLatencyStamp((*it)->originalMessage, stamp))
+            {
+                latencies.append(now - stamp);
+            }
+            delete *it;
+        }
+        result.received += messages.size();
+        if (result.received >= expected)
+        {
+            result.seconds = clock.nsecsElapsed() / 1e9;
+            loop.quit();
+        }
+    });
+
+    QThread thread;
+    auto generator = new LoadGenerator(settings);
+    generator->moveToThread(&thread);
+    QObject::connect(&thread, &QThread::started, generator, &LoadGenerator::start);
+    QObject::connect(&thread, &QThread::finished, generator, &QObject::deleteLater);
+    QTimer::singleShot(timeout, &loop, &QEventLoop::quit);
+    clock.start();
+    thread.start();
+    loop.exec();
+    if (!result.seconds)
+    {
+        result.seconds = clock.nsecsElapsed() / 1e9;
+    }
+
+    QMetaObject::invokeMethod(generator, &LoadGenerator::stop, Qt::BlockingQueuedConnection);
+    thread.quit();
+    thread.wait();
+
+    std::sort(latencies.begin(), latencies.end());
+    result.latencyP50 = percentile(latencies, 0.5);
+    result.latencyP99 = percentile(latencies, 0.99);
+    return result;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    a.setApplicationName("loglite-transport-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compares loopback TCP with the local socket and shared memory transports at high message rates");
+    parser.addHelpOption();
+    QCommandLineOption portOption(QStringList() << "p" << "port", "Port used for the benchmark server.", "port", QString::number(LogProtocol::DEFAULT_PORT + 1));
+    QCommandLineOption connectionsOption(QStringList() << "c" << "connections", "Number of concurrent connections.", "count", "4");
+    QCommandLineOption messagesOption(QStringList() << "n" << "messages", "Messages per connection.", "count", "500000");
+    QCommandLineOption sizeOption(QStringList() << "s" << "size", "Message size in bytes as min[:max].", "size", "32:128");
+    QCommandLineOption ringOption("ring", "Shared memory ring capacity in frames.", "frames", QString::number(SharedRing::DEFAULT_CAPACITY));
+    QCommandLineOption timeoutOption("timeout", "Seconds to wait for each transport.", "seconds", "120");
+    QCommandLineOption jsonOption("json", "Write the results as JSON to a file.", "file");
+    parser.addOptions({portOption, connectionsOption, messagesOption, sizeOption, ringOption, timeoutOption, jsonOption});
+    parser.process(a);
+
+    LoadGenerator::Settings settings;
+    settings.port = parser.value(portOption).toUShort();
+    settings.connections = std::max(1, parser.value(connectionsOption).toInt());
+    settings.messagesPerConnection = std::max<qint64>(1, parser.value(messagesOption).toLongLong());
+    auto sizes = parser.value(sizeOption).split(':');
+    settings.minSize = sizes.value(0).toInt();
+    settings.maxSize = std::max(settings.minSize, sizes.value(1, sizes.value(0)).toInt());
+    settings.multilineRatio = 0;
+    settings.stampLatency = true;
+    auto ringCapacity = std::min<quint32>(SharedRing::MAX_CAPACITY, std::max<quint32>(1, parser.value(ringOption).toUInt()));
+    auto timeout = parser.value(timeoutOption).toLongLong() * 1000;
+    qint64 expected = settings.connections * settings.messagesPerConnection;
+
+    QVector<Result> results;
+    results.append(run("tcp", settings, timeout));
+    settings.localName = LogServer::localName(settings.port);
+    results.append(run("local-socket", settings, timeout));
+    settings.localName.clear();
+    settings.ringCapacity = ringCapacity;
+    results.append(run("shared-memory", settings, timeout));
+
+    QTextStream out(stdout);
+    QJsonArray transports;
+    bool complete = true;
+    for (auto it = results.begin(); it != results.end(); ++it)
+    {
+        double rate = it->seconds > 0 ? it->received / it->seconds : 0;
+        double speedup = it->seconds > 0 ? results[0].seconds / it->seconds : 0;
+        out << it->transport << ": " << it->received << "/" << expected << " messages in " << it->seconds << " s, "
+            << qint64(rate) << " messages/s (" << speedup << "x tcp), latency p50 " << it->latencyP50
+            << " us, p99 " << it->latencyP99 << " us\n";
+        complete = complete && it->received >= expected;
+
+        QJsonObject object;
+        object["transport"] = it->transport;
+        object["received"] = it->received;
+        object["seconds"] = it->seconds;
+        object["messagesPerSecond"] = rate;
+        object["latencyP50Us"] = it->latencyP50;
+        object["latencyP99Us"] = it->latencyP99;
+        object["speedup"] = speedup;
+        transports.append(object);
+    }
+
+    if (parser.isSet(jsonOption))
+    {
+        QJsonObject result;
+        result["expected"] = expected;
+        result["transports"] = transports;
+        QFile file(parser.value(jsonOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qCritical() << "Could not write" << file.fileName();
+            return 1;
+        }
+        file.write(QJsonDocument(result).toJson());
+    }
+    return complete ? 0 : 1;
+}
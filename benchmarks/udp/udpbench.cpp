@@ -0,0 +1,259 @@
+#include "logprotocol.h"
+#include "logserver.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QUdpSocket>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace LogProtocol;
+
+namespace
+{
+
+const QByteArray MODULE = "Bench";
+const QByteArray CHANNEL = "udp";
+// Room for the machine name and executable path.
+const size_t MAX_IDENTITY_SIZE = 64;
+
+struct Settings
+{
+    quint16 port;
+    int senders;
+    qint64 messagesPerSender;
+    int recordsPerDatagram;
+    int size;
+    qint64 rate;
+};
+
+struct SenderResult
+{
+    qint64 sent;
+    qint64 failed;
+    quint32 datagrams;
+};
+
+void append(QByteArray& datagram, const void* data, size_t size)
+{
+    datagram.append(static_cast<const char*>(data), qsizetype(size));
+}
+
+// Writes datagrams the way a fire-and-forget client would: no connection,
+// the identity repeated in every datagram, a failed write simply lost.
+SenderResult send(const Settings& settings, quint64 pid, const std::atomic<bool>& stop)
+{
+    SenderResult result = {0, 0, 0};
+    QUdpSocket socket;
+    QByteArray machineName = "udpbench";
+    QByteArray executablePath = QString("udpbench-%1").arg(pid).toUtf8();
+    QByteArray text(settings.size, 'x');
+
+    DatagramHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DatagramHeader::MAGIC;
+    header.machineNameSize = quint8(machineName.size());
+    header.executablePathSize = quint16(executablePath.size());
+    header.pid = pid;
+    DatagramRecord record;
+    record.severity = 0;
+    record.moduleSize = quint8(MODULE.size());
+    record.channelSize = quint8(CHANNEL.size());
+    record.messageSize = quint16(text.size());
+
+    QElapsedTimer clock;
+    clock.start();
+    QByteArray datagram;
+    qint64 remaining = settings.messagesPerSender;
+    while (remaining > 0 && !stop.load(std::memory_order_relaxed))
+    {
+        auto records = int(std::min<qint64>(remaining, settings.recordsPerDatagram));
+        header.sequence = result.datagrams++;
+        header.recordCount = quint32(records);
+        record.timestamp = quint64(QDateTime::currentMSecsSinceEpoch());
+        datagram.clear();
+        append(datagram, &header, sizeof(header));
+        datagram.append(machineName);
+        datagram.append(executablePath);
+        for (int i = 0; i < records; ++i)
+        {
+            append(datagram, &record, sizeof(record));
+            datagram.append(MODULE);
+            datagram.append(CHANNEL);
+            datagram.append(text);
+        }
+        if (socket.writeDatagram(datagram, QHostAddress::LocalHost, settings.port) == datagram.size())
+        {
+            result.sent += records;
+        }
+        else
+        {
+            result.failed += records;
+        }
+        remaining -= records;
+
+        if (settings.rate > 0)
+        {
+            auto due = (settings.messagesPerSender - remaining) * 1000000000 / settings.rate;
+            auto ahead = due - clock.nsecsElapsed();
+            if (ahead > 0)
+            {
+                QThread::usleep(quint64(ahead / 1000));
+            }
+        }
+    }
+    return result;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    a.setApplicationName("loglite-udp-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures throughput and loss of datagram ingestion on loopback");
+    parser.addHelpOption();
+    QCommandLineOption portOption(QStringList() << "p" << "port", "Port used for the benchmark server.", "port", QString::number(LogProtocol::DEFAULT_PORT + 2));
+    QCommandLineOption sendersOption(QStringList() << "c" << "senders", "Number of concurrent senders.", "count", "1");
+    QCommandLineOption messagesOption(QStringList() << "n" << "messages", "Messages per sender.", "count", "1000000");
+    QCommandLineOption recordsOption(QStringList() << "r" << "records", "Messages per datagram.", "count", "16");
+    QCommandLineOption sizeOption(QStringList() << "s" << "size", "Message size in bytes.", "size", "64");
+    QCommandLineOption rateOption("rate", "Messages per second per sender, 0 for as fast as possible.", "count", "0");
+    QCommandLineOption timeoutOption("timeout", "Seconds to wait for the run.", "seconds", "120");
+    QCommandLineOption jsonOption("json", "Write the results as JSON to a file.", "file");
+    parser.addOptions({portOption, sendersOption, messagesOption, recordsOption, sizeOption, rateOption, timeoutOption, jsonOption});
+    parser.process(a);
+
+    Settings settings;
+    settings.port = parser.value(portOption).toUShort();
+    settings.senders = std::max(1, parser.value(sendersOption).toInt());
+    settings.messagesPerSender = std::max<qint64>(1, parser.value(messagesOption).toLongLong());
+    settings.size = std::max(0, std::min(parser.value(sizeOption).toInt(), 0xFFFF));
+    auto recordSize = sizeof(DatagramRecord) + size_t(MODULE.size() + CHANNEL.size() + settings.size);
+    auto maxRecords = int((MAX_DATAGRAM_SIZE - sizeof(DatagramHeader) - MAX_IDENTITY_SIZE) / recordSize);
+    settings.recordsPerDatagram = std::max(1, std::min(parser.value(recordsOption).toInt(), maxRecords));
+    settings.rate = std::max<qint64>(0, parser.value(rateOption).toLongLong());
+    auto timeout = parser.value(timeoutOption).toLongLong() * 1000;
+    qint64 expected = settings.senders * settings.messagesPerSender;
+
+    LogServer server;
+    server.setDatagramsEnabled(true);
+    if (!server.listen(settings.port) || !server.isListeningForDatagrams())
+    {
+        qCritical() << "Could not listen on port" << settings.port;
+        return 1;
+    }
+
+    qint64 received = 0;
+    double seconds = 0;
+    QElapsedTimer clock;
+    QElapsedTimer quiet;
+    quiet.start();
+    QObject::connect(&server, &LogServer::messagesReceived, [&](const QVector<LogMessage*>& messages)
+    {
+        received += messages.size();
+        seconds = clock.nsecsElapsed() / 1e9;
+        quiet.restart();
+        qDeleteAll(messages);
+    });
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> running(settings.senders);
+    QVector<SenderResult> senderResults(settings.senders);
+    std::vector<std::unique_ptr<QThread>> threads;
+    clock.start();
+    for (int i = 0; i < settings.senders; ++i)
+    {
+        threads.emplace_back(QThread::create([&, i]()
+        {
+            senderResults[i] = send(settings, quint64(i + 1), stop);
+            running.fetch_sub(1);
+        }));
+        threads.back()->start();
+    }
+
+    // Loss only shows as silence, so the run ends once the senders are done
+    // and nothing has arrived for a while.
+    QEventLoop loop;
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, [&]()
+    {
+        if ((!running.load() && quiet.hasExpired(500)) || received >= expected || clock.hasExpired(timeout))
+        {
+            loop.quit();
+        }
+    });
+    poll.start(50);
+    loop.exec();
+    stop.store(true);
+    for (auto it = threads.begin(); it != threads.end(); ++it)
+    {
+        (*it)->wait();
+    }
+
+    qint64 sent = 0;
+    qint64 failed = 0;
+    quint64 lostDatagrams = 0;
+    quint64 datagrams = 0;
+    for (auto it = senderResults.begin(); it != senderResults.end(); ++it)
+    {
+        sent += it->sent;
+        failed += it->failed;
+        datagrams += it->datagrams;
+    }
+    auto& clients = server.clients();
+    for (auto it = clients.begin(); it != clients.end(); ++it)
+    {
+        lostDatagrams += server.metrics(*it).lostDatagrams;
+    }
+
+    double rate = seconds > 0 ? received / seconds : 0;
+    double loss = expected ? 1.0 - double(received) / expected : 0;
+    QTextStream out(stdout);
+    out << settings.senders << " senders, " << settings.recordsPerDatagram << " messages of " << settings.size
+        << " bytes per datagram\n"
+        << "sent " << sent << "/" << expected << " messages (" << failed << " failed writes), received " << received
+        << " in " << seconds << " s, " << qint64(rate) << " messages/s\n"
+        << "loss " << loss * 100 << "%, " << lostDatagrams << "/" << datagrams << " datagrams missing by sequence, "
+        << clients.size() << " datagram clients\n";
+
+    if (parser.isSet(jsonOption))
+    {
+        QJsonObject result;
+        result["senders"] = settings.senders;
+        result["recordsPerDatagram"] = settings.recordsPerDatagram;
+        result["size"] = settings.size;
+        result["rate"] = settings.rate;
+        result["expected"] = expected;
+        result["sent"] = sent;
+        result["failedWrites"] = failed;
+        result["received"] = received;
+        result["seconds"] = seconds;
+        result["messagesPerSecond"] = rate;
+        result["loss"] = loss;
+        result["datagrams"] = qint64(datagrams);
+        result["lostDatagrams"] = qint64(lostDatagrams);
+        QFile file(parser.value(jsonOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qCritical() << "Could not write" << file.fileName();
+            return 1;
+        }
+        file.write(QJsonDocument(result).toJson());
+    }
+    return 0;
+}
@@ -0,0 +1,646 @@
+#ifndef LOGLITE_H
+#define LOGLITE_H
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// LogLite client without Qt: C++17 and POSIX sockets, header only.
+//
+// log() encodes the message straight into a preallocated ring of protocol
+// frames and returns; a background thread connects, writes whatever has
+// queued up and reconnects with backoff when the connection drops. While it
+// is away the ring fills up, then messages are dropped, counted in dropped()
+// and reported to LogLite once there is room again. Nothing on the logging
+// path allocates.
+//
+//     loglite::Logger logger;
+//     logger.logf(loglite::SEVERITY_INFO, "engine", "render", "frame %d took %.1f ms", frame, ms);
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LOGLITE_PRINTF(formatIndex, firstArgument) __attribute__((format(printf, formatIndex, firstArgument)))
+#else
+#define LOGLITE_PRINTF(formatIndex, firstArgument)
+#endif
+
+namespace loglite
+{
+
+const uint16_t DEFAULT_PORT = 0xCC9;
+
+enum Severity : uint32_t
+{
+    SEVERITY_INFO,
+    SEVERITY_NOTICE,
+    SEVERITY_WARN,
+    SEVERITY_ERR,
+};
+
+namespace detail
+{
+
+// Same frames as include/logprotocol.h, which this header must not depend on.
+enum MessageType : uint32_t
+{
+    CONNECTION_MESSAGE,
+    SIMPLE_MESSAGE,
+    LARGE_MESSAGE,
+    CONTINUATION_MESSAGE,
+    CONTINUATION_END_MESSAGE,
+};
+
+// Version 2 is the plain socket protocol every server understands.
+const uint32_t PROTOCOL_VERSION = 2;
+
+struct ConnectionMessage
+{
+    static const size_t MESSAGE_MAX_PATH = 260;
+
+    uint32_t version;
+    uint64_t pid;
+    char machineName[32];
+    char executablePath[MESSAGE_MAX_PATH];
+};
+
+struct TextMessage
+{
+    static const size_t TEXT_SIZE = 256;
+
+    uint64_t timestamp;
+    uint32_t severity;
+    char module[32];
+    char channel[32];
+    char message[TEXT_SIZE];
+};
+
+struct RawLogMessage
+{
+    uint32_t type;
+    union
+    {
+        ConnectionMessage connection;
+        TextMessage text;
+    };
+};
+
+static_assert(sizeof(RawLogMessage) == 344, "RawLogMessage must match the server's frame layout");
+
+// Text carried by one frame, the rest of it is the terminating zero.
+const size_t FRAME_TEXT = TextMessage::TEXT_SIZE - 1;
+
+template <size_t size>
+void fillString(char (&destination)[size], std::string_view source)
+{
+    auto length = std::min(source.size(), size - 1);
+    memcpy(destination, source.data(), length);
+    destination[length] = 0;
+}
+
+inline size_t frameCount(size_t length)
+{
+    return std::max<size_t>(1, (length + FRAME_TEXT - 1) / FRAME_TEXT);
+}
+
+inline bool isContinuation(uint32_t type)
+{
+    return type == CONTINUATION_MESSAGE || type == CONTINUATION_END_MESSAGE;
+}
+
+}
+
+struct Options
+{
+    // Connect over TCP to host:port, or, if localName is set, to the local
+    // socket of that name (relative names live in $TMPDIR, like Qt's).
+    std::string host = "127.0.0.1";
+    uint16_t port = DEFAULT_PORT;
+    std::string localName;
+
+    // Shown in LogLite's client list; filled in from the process if empty.
+    uint64_t pid = 0;
+    std::string machineName;
+    std::string executablePath;
+
+    // Frames buffered while the sender is busy or disconnected. A frame
+    // carries up to 255 bytes of message text.
+    size_t capacity = 16384;
+    std::chrono::milliseconds flushInterval = std::chrono::milliseconds(5);
+    std::chrono::milliseconds maxReconnectDelay = std::chrono::milliseconds(5000);
+};
+
+class Logger
+{
+public:
+    // Longest message logf() formats, the rest is cut off.
+    static const size_t MAX_FORMATTED = 4096;
+
+    explicit Logger(Options options = Options());
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Only read by info() and friends, set them before logging from other
+    // threads.
+    void setDefaultModule(std::string_view module);
+    void setDefaultChannel(std::string_view channel);
+
+    // Thread-safe. Returns false if the message was dropped because the
+    // buffer is full.
+    bool log(Severity severity, uint64_t timestamp, std::string_view module, std::string_view channel, std::string_view message);
+    bool log(Severity severity, std::string_view module, std::string_view channel, std::string_view message);
+    bool logf(Severity severity, std::string_view module, std::string_view channel, const char* format, ...) LOGLITE_PRINTF(5, 6);
+
+    bool info(std::string_view message);
+    bool notice(std::string_view message);
+    bool warn(std::string_view message);
+    bool error(std::string_view message);
+
+    // Waits until everything logged so far has been written to the socket.
+    bool flush(std::chrono::milliseconds timeout = std::chrono::milliseconds(30000));
+
+    bool isConnected() const;
+    uint64_t dropped() const;
+private:
+    static uint64_t now();
+
+    bool append(Severity severity, uint64_t timestamp, std::string_view module, std::string_view channel, std::string_view message);
+    void reportDrops();
+    void run();
+    bool connect();
+    void disconnect();
+    size_t write(const detail::RawLogMessage* frames, size_t count);
+
+    Options m_options;
+    std::unique_ptr<detail::RawLogMessage[]> m_frames;
+    std::string m_module;
+    std::string m_channel;
+
+    // m_head counts the frames ever logged and m_tail the ones written, both
+    // under m_mutex. Frames in between belong to the sender, which writes
+    // them without holding the lock.
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_written;
+    uint64_t m_head;
+    uint64_t m_tail;
+    int m_flushRequests;
+    bool m_stop;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<bool> m_connected;
+
+    // Only touched by the sender thread.
+    uint64_t m_reportedDrops;
+    int m_socket;
+    size_t m_partialBytes;
+    std::thread m_thread;
+};
+
+inline Logger::Logger(Options options)
+    :m_options(std::move(options)),
+    m_head(0),
+    m_tail(0),
+    m_flushRequests(0),
+    m_stop(false),
+    m_dropped(0),
+    m_connected(false),
+    m_reportedDrops(0),
+    m_socket(-1),
+    m_partialBytes(0)
+{
+    m_options.capacity = std::max<size_t>(m_options.capacity, 1);
+    m_frames.reset(new detail::RawLogMessage[m_options.capacity]());
+    if (!m_options.pid)
+    {
+        m_options.pid = uint64_t(getpid());
+    }
+    if (m_options.machineName.empty())
+    {
+        char name[256] = {};
+        gethostname(name, sizeof(name) - 1);
+        m_options.machineName = name;
+    }
+#ifdef __linux__
+    if (m_options.executablePath.empty())
+    {
+        char path[4096];
+        auto length = readlink("/proc/self/exe", path, sizeof(path));
+        if (length > 0)
+        {
+            m_options.executablePath.assign(path, size_t(length));
+        }
+    }
+#endif
+    m_thread = std::thread(&Logger::run, this);
+}
+
+inline Logger::~Logger()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+inline void Logger::setDefaultModule(std::string_view module)
+{
+    m_module = module;
+}
+
+inline void Logger::setDefaultChannel(std::string_view channel)
+{
+    m_channel = channel;
+}
+
+inline bool Logger::log(Severity severity, uint64_t timestamp, std::string_view module, std::string_view channel, std::string_view message)
+{
+    auto threshold = m_options.capacity / 4;
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto before = m_head - m_tail;
+        if (!append(severity, timestamp, module, channel, message))
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // Otherwise the sender picks it up on its next flush interval.
+        wake = before < threshold && m_head - m_tail >= threshold;
+    }
+    if (wake)
+    {
+        m_wake.notify_one();
+    }
+    return true;
+}
+
+inline bool Logger::log(Severity severity, std::string_view module, std::string_view channel, std::string_view message)
+{
+    return log(severity, now(), module, channel, message);
+}
+
+inline bool Logger::logf(Severity severity, std::string_view module, std::string_view channel, const char* format, ...)
+{
+    char buffer[MAX_FORMATTED];
+    va_list arguments;
+    va_start(arguments, format);
+    auto length = vsnprintf(buffer, sizeof(buffer), format, arguments);
+    va_end(arguments);
+    if (length < 0)
+    {
+        return false;
+    }
+    return log(severity, module, channel, std::string_view(buffer, std::min(size_t(length), sizeof(buffer) - 1)));
+}
+
+inline bool Logger::info(std::string_view message)
+{
+    return log(SEVERITY_INFO, m_module, m_channel, message);
+}
+
+inline bool Logger::notice(std::string_view message)
+{
+    return log(SEVERITY_NOTICE, m_module, m_channel, message);
+}
+
+inline bool Logger::warn(std::string_view message)
+{
+    return log(SEVERITY_WARN, m_module, m_channel, message);
+}
+
+inline bool Logger::error(std::string_view message)
+{
+    return log(SEVERITY_ERR, m_module, m_channel, message);
+}
+
+inline bool Logger::flush(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto target = m_head;
+    ++m_flushRequests;
+    m_wake.notify_one();
+    bool written = m_written.wait_for(lock, timeout, [&]()
+    {
+        return m_tail >= target || m_stop;
+    });
+    --m_flushRequests;
+    return written && m_tail >= target;
+}
+
+inline bool Logger::isConnected() const
+{
+    return m_connected.load(std::memory_order_relaxed);
+}
+
+inline uint64_t Logger::dropped() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+inline uint64_t Logger::now()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+inline bool Logger::append(Severity severity, uint64_t timestamp, std::string_view module, std::string_view channel, std::string_view message)
+{
+    // All frames of a message go in together, so the sender never sees half
+    // of one.
+    auto count = detail::frameCount(message.size());
+    if (m_options.capacity - (m_head - m_tail) < count)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto& frame = m_frames[(m_head + i) % m_options.capacity];
+        if (count == 1)
+        {
+            frame.type = detail::SIMPLE_MESSAGE;
+        }
+        else if (i == 0)
+        {
+            frame.type = detail::LARGE_MESSAGE;
+        }
+        else
+        {
+            frame.type = i + 1 < count ? detail::CONTINUATION_MESSAGE : detail::CONTINUATION_END_MESSAGE;
+        }
+        // The server takes everything but the text from the first frame.
+        if (i == 0)
+        {
+            frame.text.timestamp = timestamp;
+            frame.text.severity = severity;
+            detail::fillString(frame.text.module, module);
+            detail::fillString(frame.text.channel, channel);
+        }
+        auto text = message.substr(std::min(message.size(), i * detail::FRAME_TEXT), detail::FRAME_TEXT);
+        memcpy(frame.text.message, text.data(), text.size());
+        frame.text.message[text.size()] = 0;
+    }
+    m_head += count;
+    return true;
+}
+
+inline void Logger::reportDrops()
+{
+    auto dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped == m_reportedDrops)
+    {
+        return;
+    }
+    char message[96];
+    auto length = snprintf(message, sizeof(message), "%llu messages dropped, the client buffer was full",
+                           static_cast<unsigned long long>(dropped - m_reportedDrops));
+    if (append(SEVERITY_WARN, now(), "LogLite", "overload", std::string_view(message, size_t(length))))
+    {
+        m_reportedDrops = dropped;
+    }
+}
+
+inline void Logger::run()
+{
+    const auto minReconnectDelay = std::chrono::milliseconds(100);
+    auto reconnectDelay = minReconnectDelay;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        if (m_socket < 0)
+        {
+            if (m_stop)
+            {
+                break;
+            }
+            lock.unlock();
+            bool connected = connect();
+            lock.lock();
+            if (!connected)
+            {
+                m_wake.wait_for(lock, reconnectDelay, [this]()
+                {
+                    return m_stop;
+                });
+                reconnectDelay = std::min(reconnectDelay * 2, std::max(m_options.maxReconnectDelay, minReconnectDelay));
+                continue;
+            }
+            reconnectDelay = minReconnectDelay;
+        }
+
+        reportDrops();
+        auto tail = m_tail;
+        auto head = m_head;
+        lock.unlock();
+        size_t written = 0;
+        // At most two contiguous runs, the ring may wrap around.
+        while (tail + written < head && m_socket >= 0)
+        {
+            auto offset = (tail + written) % m_options.capacity;
+            auto count = std::min<uint64_t>(head - tail - written, m_options.capacity - offset);
+            auto sent = write(&m_frames[offset], size_t(count));
+            written += sent;
+            if (sent < count)
+            {
+                break;
+            }
+        }
+        if (m_socket < 0)
+        {
+            // The server drops the frames of a message cut off by a lost
+            // connection, so it goes again whole on the next one. One whose
+            // first frame went out before this run can only be skipped.
+            auto isContinuation = [&](uint64_t position)
+            {
+                return position < head && detail::isContinuation(m_frames[position % m_options.capacity].type);
+            };
+            while (written && isContinuation(tail + written))
+            {
+                --written;
+            }
+            if (isContinuation(tail + written))
+            {
+                while (isContinuation(tail + written))
+                {
+                    ++written;
+                }
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        lock.lock();
+        m_tail += written;
+        if (m_tail == m_head)
+        {
+            m_written.notify_all();
+        }
+
+        if (m_stop && (m_tail == m_head || m_socket < 0 || !written))
+        {
+            break;
+        }
+        if (m_socket >= 0 && m_tail == head)
+        {
+            auto threshold = m_options.capacity / 4;
+            m_wake.wait_for(lock, m_options.flushInterval, [&]()
+            {
+                return m_stop || m_flushRequests || m_head - m_tail >= threshold;
+            });
+        }
+    }
+    lock.unlock();
+    disconnect();
+    m_written.notify_all();
+}
+
+inline bool Logger::connect()
+{
+    int fd = -1;
+    if (!m_options.localName.empty())
+    {
+        std::string path = m_options.localName;
+        if (path[0] != '/')
+        {
+            auto directory = getenv("TMPDIR");
+            path = std::string(directory && *directory ? directory : "/tmp") + "/" + path;
+        }
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            return false;
+        }
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    else
+    {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(m_options.host.c_str(), std::to_string(m_options.port).c_str(), &hints, &addresses) != 0)
+        {
+            return false;
+        }
+        for (auto address = addresses; address && fd < 0; address = address->ai_next)
+        {
+            fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd >= 0 && ::connect(fd, address->ai_addr, address->ai_addrlen) != 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+        if (fd >= 0)
+        {
+            int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        }
+    }
+    if (fd < 0)
+    {
+        return false;
+    }
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+    // A server that stops reading must not hold the sender, or the
+    // destructor, forever.
+    timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    m_socket = fd;
+    m_partialBytes = 0;
+    detail::RawLogMessage message = {};
+    message.type = detail::CONNECTION_MESSAGE;
+    message.connection.version = detail::PROTOCOL_VERSION;
+    message.connection.pid = m_options.pid;
+    detail::fillString(message.connection.machineName, m_options.machineName);
+    detail::fillString(message.connection.executablePath, m_options.executablePath);
+    if (write(&message, 1) != 1)
+    {
+        disconnect();
+        return false;
+    }
+    m_connected.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+inline void Logger::disconnect()
+{
+    if (m_socket >= 0)
+    {
+        close(m_socket);
+        m_socket = -1;
+    }
+    m_connected.store(false, std::memory_order_relaxed);
+}
+
+inline size_t Logger::write(const detail::RawLogMessage* frames, size_t count)
+{
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    // m_partialBytes of the first frame went out on an earlier call.
+    auto data = reinterpret_cast<const char*>(frames);
+    size_t total = count * sizeof(detail::RawLogMessage);
+    while (m_partialBytes < total)
+    {
+        auto sent = send(m_socket, data + m_partialBytes, total - m_partialBytes, flags);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                // The frame in flight is sent again, whole, on the next
+                // connection.
+                auto complete = m_partialBytes / sizeof(detail::RawLogMessage);
+                disconnect();
+                m_partialBytes = 0;
+                return complete;
+            }
+            break;
+        }
+        m_partialBytes += size_t(sent);
+    }
+    auto frameCount = m_partialBytes / sizeof(detail::RawLogMessage);
+    m_partialBytes %= sizeof(detail::RawLogMessage);
+    return frameCount;
+}
+
+}
+
+#undef LOGLITE_PRINTF
+
+#endif // LOGLITE_H
@@ -1,30 +1,26 @@
-import ctypes
+import atexit
+import collections
 import logging
 import os
 import socket
+import struct
 import sys
+import threading
 import time
 
 VERSION = 2
 PORT = 0xcc9
 
+# Frames are the C structs of include/logprotocol.h: a type followed by a
+# union of the connection and text messages, 344 bytes in all.
+_CONNECTION_FRAME = struct.Struct('<I4xI4xQ32s260s28x')
+_TEXT_FRAME = struct.Struct('<I4xQI32s32s256s4x')
+_FRAME_SIZE = _TEXT_FRAME.size
+_FRAME_TEXT = 255
 
-class _ConnectionMessage(ctypes.Structure):
-    _fields_ = [('version', ctypes.c_uint32), ('pid', ctypes.c_int64), ('machine_name', ctypes.c_char * 32),
-                ('executable_path', ctypes.c_char * 260)]
-
-
-class _TextMessage(ctypes.Structure):
-    _fields_ = [('timestamp', ctypes.c_uint64), ('severity', ctypes.c_uint32), ('module', ctypes.c_char * 32),
-                ('channel', ctypes.c_char * 32), ('message', ctypes.c_char * 256)]
-
-
-class _TextOrConnection(ctypes.Union):
-    _fields_ = [('connection', _ConnectionMessage), ('text', _TextMessage)]
-
-
-class _Message(ctypes.Structure):
-    _fields_ = [('type', ctypes.c_uint32), ('body', _TextOrConnection)]
+_BATCH_FRAMES = 256
+_MIN_RECONNECT_DELAY = 0.1
+_MAX_RECONNECT_DELAY = 5.0
 
 
 class _MessageType(object):
@@ -42,8 +38,23 @@ class Severity(object):
     ERROR = 3
 
 
+class _Flush(object):
+    def __init__(self):
+        self.done = threading.Event()
+
+
 class LogLiteClient(object):
-    def __init__(self, server='127.0.0.1', pid=None, machine_name=None, executable_path=None):
+    """Sends log messages to LogLite from a background thread.
+
+    log() only appends the message to a bounded queue; the sender thread packs
+    whatever has queued up into one buffer of frames and writes it with a
+    single call. It reconnects with backoff if the connection drops. When the
+    queue is full, messages are dropped, counted in dropped and reported to
+    LogLite. Everything queued is flushed when the interpreter exits.
+    """
+
+    def __init__(self, server='127.0.0.1', pid=None, machine_name=None, executable_path=None, port=PORT,
+                 capacity=65536, flush_interval=0.05, flush_timeout=5.0):
         if pid is None:
             pid = os.getpid()
         if machine_name is None:
@@ -51,37 +62,149 @@ class LogLiteClient(object):
         if executable_path is None:
             executable_path = sys.argv[0]
 
-        self.socket = socket.create_connection((server, 0xcc9))
-
-        msg = _Message()
-        msg.type = _MessageType.CONNECTION_MESSAGE
-        msg.body.connection.version = VERSION
-        msg.body.connection.pid = pid
-        msg.body.connection.machine_name = machine_name
-        msg.body.connection.executable_path = executable_path
-        self.socket.sendall(buffer(msg)[:])
+        self.server = server
+        self.port = port
+        self.capacity = capacity
+        self.flush_interval = flush_interval
+        self.flush_timeout = flush_timeout
+        self.dropped = 0
+        self._connection = _CONNECTION_FRAME.pack(_MessageType.CONNECTION_MESSAGE, VERSION, pid,
+                                                  _encode(machine_name, 31), _encode(executable_path, 259))
+        self._socket = None
+        self._queue = collections.deque()
+        self._wake = threading.Event()
+        self._stop = False
+        self._reported_drops = 0
+        self._buffer = bytearray(_BATCH_FRAMES * _FRAME_SIZE)
+        self._thread = threading.Thread(target=self._run, name='LogLiteClient', daemon=True)
+        self._thread.start()
+        atexit.register(self.close)
 
     def log(self, severity, message, timestamp=None, module='', channel=''):
-        msg = _Message()
-        msg.body.text.timestamp = timestamp or int(time.time() * 1000)
-        msg.body.text.severity = severity
-        msg.body.text.module = module
-        msg.body.text.channel = channel
-        if len(message) < 255:
-            msg.type = _MessageType.SIMPLE_MESSAGE
-            msg.body.text.message = message
-            self.socket.sendall(buffer(msg)[:])
-        else:
-            offset = 0
-            msg.type = _MessageType.LARGE_MESSAGE
-            while offset < len(message):
-                msg.body.text.message = message[offset:offset + 255]
-                self.socket.sendall(buffer(msg)[:])
-                offset += 255
-                if offset + 255 >= len(message):
-                    msg.type = _MessageType.CONTINUATION_END_MESSAGE
+        """Queues a message, returns False if it was dropped."""
+        size = len(self._queue)
+        if size >= self.capacity:
+            self.dropped += 1
+            return False
+        self._queue.append((timestamp or int(time.time() * 1000), severity, module, channel, message))
+        # Otherwise the sender picks it up on its next flush interval.
+        if size == self.capacity // 4:
+            self._wake.set()
+        return True
+
+    def flush(self, timeout=None):
+        """Waits until everything logged so far has been written to the socket."""
+        marker = _Flush()
+        self._queue.append(marker)
+        self._wake.set()
+        return marker.done.wait(timeout)
+
+    def close(self):
+        if self._stop:
+            return
+        self.flush(self.flush_timeout)
+        self._stop = True
+        self._wake.set()
+        self._thread.join(self.flush_timeout)
+        atexit.unregister(self.close)
+
+    def _run(self):
+        delay = _MIN_RECONNECT_DELAY
+        pending = None
+        while not self._stop:
+            if self._socket is None:
+                try:
+                    self._socket = socket.create_connection((self.server, self.port))
+                    self._socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                    self._socket.sendall(self._connection)
+                    delay = _MIN_RECONNECT_DELAY
+                except OSError:
+                    self._disconnect()
+                    self._wake.wait(delay)
+                    self._wake.clear()
+                    delay = min(delay * 2, _MAX_RECONNECT_DELAY)
+                    continue
+            batch = None
+            try:
+                # A batch cut short by a lost connection goes out again, as a
+                # whole, on the next one.
+                if pending is not None:
+                    self._socket.sendall(pending)
+                    pending = None
+                self._wake.clear()
+                if not self._queue:
+                    self._wake.wait(self.flush_interval)
+                while self._queue:
+                    batch = self._pack()
+                    self._socket.sendall(batch)
+                    batch = None
+                    self._release_flushes()
+            except OSError:
+                if batch is not None:
+                    pending = bytes(batch)
+                self._disconnect()
+        self._disconnect()
+
+    def _pack(self):
+        buffer = self._buffer
+        offset = 0
+        end = len(buffer)
+        if self.dropped != self._reported_drops:
+            dropped = self.dropped - self._reported_drops
+            self._reported_drops += dropped
+            self._queue.appendleft((int(time.time() * 1000), Severity.WARNING, 'LogLite', 'overload',
+                                    '%d messages dropped, the client queue was full' % dropped))
+        while self._queue and offset < end:
+            record = self._queue[0]
+            if record.__class__ is _Flush:
+                break
+            timestamp, severity, module, channel, message = record
+            text = _encode(message, None)
+            frames = max(1, (len(text) + _FRAME_TEXT - 1) // _FRAME_TEXT)
+            if offset + frames * _FRAME_SIZE > end:
+                if offset:
+                    break
+                # Longer than a whole batch, it gets a buffer of its own.
+                buffer = bytearray(frames * _FRAME_SIZE)
+                end = len(buffer)
+            self._queue.popleft()
+            module = _encode(module, 31)
+            channel = _encode(channel, 31)
+            if frames == 1:
+                _TEXT_FRAME.pack_into(buffer, offset, _MessageType.SIMPLE_MESSAGE, timestamp, severity, module, channel,
+                                      text)
+                offset += _FRAME_SIZE
+                continue
+            for i in range(frames):
+                if i == 0:
+                    kind = _MessageType.LARGE_MESSAGE
+                elif i + 1 < frames:
+                    kind = _MessageType.CONTINUATION_MESSAGE
                 else:
-                    msg.type = _MessageType.CONTINUATION_MESSAGE
+                    kind = _MessageType.CONTINUATION_END_MESSAGE
+                _TEXT_FRAME.pack_into(buffer, offset, kind, timestamp, severity, module, channel,
+                                      text[i * _FRAME_TEXT:(i + 1) * _FRAME_TEXT])
+                offset += _FRAME_SIZE
+        return memoryview(buffer)[:offset]
+
+    def _release_flushes(self):
+        while self._queue and self._queue[0].__class__ is _Flush:
+            self._queue.popleft().done.set()
+
+    def _disconnect(self):
+        if self._socket is not None:
+            try:
+                self._socket.close()
+            except OSError:
+                pass
+            self._socket = None
+
+
+def _encode(text, size):
+    if not isinstance(text, bytes):
+        text = str(text).encode('utf-8', 'replace')
+    return text[:size]
+
 
 LEVEL_MAP = {
     logging.CRITICAL:   Severity.ERROR,
@@ -104,7 +227,10 @@ class LogLiteHandler(logging.Handler):
                 channel, module = record.name.split('.', 1)
             else:
                 channel, module = record.name, 'General'
-            self.client.log(LEVEL_MAP.get(record.levelno, Severity.INFO), self.format(record), module=module,
-                            channel=channel)
-        except:
+            self.client.log(LEVEL_MAP.get(record.levelno, Severity.INFO), self.format(record),
+                            timestamp=int(record.created * 1000), module=module, channel=channel)
+        except Exception:
             self.handleError(record)
+
+    def flush(self):
+        self.client.flush(self.client.flush_timeout)
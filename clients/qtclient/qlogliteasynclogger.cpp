@@ -0,0 +1,328 @@
+#include "qlogliteasynclogger.h"
+#include <QDateTime>
+#include <QTimer>
+#include <limits>
+
+namespace
+{
+
+const int MAX_BATCH = 4096;
+// Once this much is waiting for the socket, the sender stops taking
+// messages off the queue until it drains, so a slow server fills the queue
+// and the full policy applies instead of memory growing without bound.
+const qint64 MAX_UNSENT_BYTES = 4 * 1024 * 1024;
+
+}
+
+
+QLogLiteAsyncLogger::QLogLiteAsyncLogger(int capacity, FullPolicy policy)
+    :m_mask(1),
+    m_enqueuePosition(0),
+    m_dequeuePosition(0),
+    m_idle(true),
+    m_dropped(0),
+    m_fullPolicy(policy),
+    m_reportedDrops(0),
+    m_sender(nullptr),
+    m_logger(nullptr)
+{
+    while (m_mask + 1 < quint64(capacity))
+    {
+        m_mask = (m_mask << 1) | 1;
+    }
+    m_cells.reset(new Cell[m_mask + 1]);
+    for (quint64 i = 0; i <= m_mask; ++i)
+    {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    m_thread.setObjectName("QLogLiteAsyncLogger");
+    m_sender = new QObject;
+    m_sender->moveToThread(&m_thread);
+    m_thread.start();
+    runOnSender([this]()
+    {
+        m_logger = new QLogLiteLogger;
+    });
+}
+
+QLogLiteAsyncLogger::~QLogLiteAsyncLogger()
+{
+    flush();
+    runOnSender([this]()
+    {
+        m_logger->disconnnect();
+        delete m_logger;
+        m_logger = nullptr;
+    });
+    m_thread.quit();
+    m_thread.wait();
+    delete m_sender;
+}
+
+void QLogLiteAsyncLogger::connectToHost()
+{
+    runOnSender([this]()
+    {
+        m_logger->connectToHost();
+    });
+}
+
+void QLogLiteAsyncLogger::connectToHost(qint64 pid, QString machineName, QString executablePath)
+{
+    runOnSender([=]()
+    {
+        m_logger->connectToHost(pid, machineName, executablePath);
+    });
+}
+
+void QLogLiteAsyncLogger::connectToHost(QString server, qint64 pid, QString machineName, QString executablePath)
+{
+    runOnSender([=]()
+    {
+        m_logger->connectToHost(server, pid, machineName, executablePath);
+    });
+}
+
+void QLogLiteAsyncLogger::connectToLocal()
+{
+    runOnSender([this]()
+    {
+        m_logger->connectToLocal();
+    });
+}
+
+void QLogLiteAsyncLogger::connectToLocal(QString serverName, qint64 pid, QString machineName, QString executablePath)
+{
+    runOnSender([=]()
+    {
+        m_logger->connectToLocal(serverName, pid, machineName, executablePath);
+    });
+}
+
+void QLogLiteAsyncLogger::disconnnect()
+{
+    flush();
+    runOnSender([this]()
+    {
+        m_logger->disconnnect();
+    });
+}
+
+void QLogLiteAsyncLogger::setSharedMemory(bool enabled)
+{
+    runOnSender([=]()
+    {
+        m_logger->setSharedMemory(enabled);
+    });
+}
+
+void QLogLiteAsyncLogger::setFullPolicy(FullPolicy policy)
+{
+    m_fullPolicy.store(policy, std::memory_order_relaxed);
+}
+
+QLogLiteAsyncLogger::FullPolicy QLogLiteAsyncLogger::fullPolicy() const
+{
+    return FullPolicy(m_fullPolicy.load(std::memory_order_relaxed));
+}
+
+quint64 QLogLiteAsyncLogger::dropped() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+void QLogLiteAsyncLogger::setDefaultModule(QString module)
+{
+    m_module = module;
+}
+
+QString QLogLiteAsyncLogger::defaultModule() const
+{
+    return m_module;
+}
+
+void QLogLiteAsyncLogger::setDefaultChannel(QString channel)
+{
+    m_channel = channel;
+}
+
+QString QLogLiteAsyncLogger::defaultChannel() const
+{
+    return m_channel;
+}
+
+bool QLogLiteAsyncLogger::log(LogSeverity severity, qint64 timestamp, QString module, QString channel, QString message)
+{
+    Entry entry = {severity, timestamp, std::move(module), std::move(channel), std::move(message)};
+    return push(entry);
+}
+
+bool QLogLiteAsyncLogger::log(LogSeverity severity, QDateTime timestamp, QString module, QString channel, QString message)
+{
+    return log(severity, timestamp.toMSecsSinceEpoch(), std::move(module), std::move(channel), std::move(message));
+}
+
+bool QLogLiteAsyncLogger::log(LogSeverity severity, QString module, QString channel, QString message)
+{
+    return log(severity, QDateTime::currentMSecsSinceEpoch(), std::move(module), std::move(channel), std::move(message));
+}
+
+bool QLogLiteAsyncLogger::info(QString message)
+{
+    return log(QLogLiteLogger::SEVERITY_INFO, m_module, m_channel, std::move(message));
+}
+
+bool QLogLiteAsyncLogger::notice(QString message)
+{
+    return log(QLogLiteLogger::SEVERITY_NOTICE, m_module, m_channel, std::move(message));
+}
+
+bool QLogLiteAsyncLogger::warn(QString message)
+{
+    return log(QLogLiteLogger::SEVERITY_WARN, m_module, m_channel, std::move(message));
+}
+
+bool QLogLiteAsyncLogger::error(QString message)
+{
+    return log(QLogLiteLogger::SEVERITY_ERR, m_module, m_channel, std::move(message));
+}
+
+void QLogLiteAsyncLogger::flush()
+{
+    runOnSender([this]()
+    {
+        send(std::numeric_limits<int>::max());
+        m_logger->flush();
+    });
+}
+
+bool QLogLiteAsyncLogger::push(Entry& entry)
+{
+    auto position = m_enqueuePosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        auto& cell = m_cells[position & m_mask];
+        auto difference = qint64(cell.sequence.load(std::memory_order_acquire) - position);
+        if (difference == 0)
+        {
+            if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                cell.entry = std::move(entry);
+                cell.sequence.store(position + 1, std::memory_order_seq_cst);
+                wake();
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            // Full. Blocking on the sender's own thread would never end.
+            if (m_fullPolicy.load(std::memory_order_relaxed) == DropWhenFull || QThread::currentThread() == &m_thread)
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            wake();
+            QThread::yieldCurrentThread();
+            position = m_enqueuePosition.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            position = m_enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool QLogLiteAsyncLogger::pop(Entry& entry)
+{
+    auto& cell = m_cells[m_dequeuePosition & m_mask];
+    if (cell.sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1)
+    {
+        return false;
+    }
+    entry = std::move(cell.entry);
+    cell.sequence.store(m_dequeuePosition + m_mask + 1, std::memory_order_release);
+    ++m_dequeuePosition;
+    return true;
+}
+
+bool QLogLiteAsyncLogger::isEmpty() const
+{
+    return m_cells[m_dequeuePosition & m_mask].sequence.load(std::memory_order_seq_cst) != m_dequeuePosition + 1;
+}
+
+void QLogLiteAsyncLogger::wake()
+{
+    // The sender sleeps in its event loop once the queue is empty, and only
+    // the first producer after that pays for waking it up.
+    if (m_idle.load(std::memory_order_seq_cst) && m_idle.exchange(false))
+    {
+        QMetaObject::invokeMethod(m_sender, [this]()
+        {
+            drain();
+        }, Qt::QueuedConnection);
+    }
+}
+
+void QLogLiteAsyncLogger::drain()
+{
+    if (!m_logger)
+    {
+        return;
+    }
+    if (m_logger->bytesToWrite() > MAX_UNSENT_BYTES)
+    {
+        QTimer::singleShot(1, m_sender, [this]()
+        {
+            drain();
+        });
+        return;
+    }
+    // A full batch goes back through the event loop, so the socket gets to
+    // write in between.
+    if (send(MAX_BATCH) < MAX_BATCH)
+    {
+        m_idle.store(true);
+        if (isEmpty() || !m_idle.exchange(false))
+        {
+            return;
+        }
+    }
+    QMetaObject::invokeMethod(m_sender, [this]()
+    {
+        drain();
+    }, Qt::QueuedConnection);
+}
+
+int QLogLiteAsyncLogger::send(int maxEntries)
+{
+    Entry entry;
+    int count = 0;
+    m_logger->beginBatch();
+    while (count < maxEntries && pop(entry))
+    {
+        m_logger->log(entry.severity, entry.timestamp, entry.module, entry.channel, entry.message);
+        ++count;
+    }
+    auto dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped != m_reportedDrops)
+    {
+        m_logger->log(QLogLiteLogger::SEVERITY_WARN, QDateTime::currentDateTime(), "LogLite", "overload",
+                      QString("%1 messages dropped, the client queue was full").arg(dropped - m_reportedDrops));
+        m_reportedDrops = dropped;
+    }
+    m_logger->endBatch();
+    return count;
+}
+
+void QLogLiteAsyncLogger::runOnSender(std::function<void()> function)
+{
+    if (QThread::currentThread() == &m_thread)
+    {
+        function();
+    }
+    else
+    {
+        QMetaObject::invokeMethod(m_sender, function, Qt::BlockingQueuedConnection);
+    }
+}
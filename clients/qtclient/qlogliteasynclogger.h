@@ -0,0 +1,103 @@
+#ifndef QLOGLITEASYNCLOGGER
+#define QLOGLITEASYNCLOGGER
+
+#include "qloglitelogger.h"
+#include <QThread>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Thread-safe QLogLiteLogger. Logging from any thread only puts the message
+// in a bounded lock-free queue; a sender thread owns the connection, takes
+// messages off the queue in batches and writes each batch in one go.
+class QLogLiteAsyncLogger
+{
+public:
+    typedef QLogLiteLogger::LogSeverity LogSeverity;
+
+    // What log() does when the queue is full: drop the message (counted in
+    // dropped() and reported to LogLite), or wait for room.
+    enum FullPolicy
+    {
+        DropWhenFull,
+        BlockWhenFull,
+    };
+
+    explicit QLogLiteAsyncLogger(int capacity = 65536, FullPolicy policy = DropWhenFull);
+    ~QLogLiteAsyncLogger();
+
+    void connectToHost();
+    void connectToHost(qint64 pid, QString machineName, QString executablePath);
+    void connectToHost(QString server, qint64 pid, QString machineName, QString executablePath);
+    void connectToLocal();
+    void connectToLocal(QString serverName, qint64 pid, QString machineName, QString executablePath);
+    void disconnnect();
+    void setSharedMemory(bool enabled);
+
+    void setFullPolicy(FullPolicy policy);
+    FullPolicy fullPolicy() const;
+    quint64 dropped() const;
+
+    // Only read by the calling thread's log() overloads, set them before
+    // logging from other threads.
+    void setDefaultModule(QString module);
+    QString defaultModule() const;
+    void setDefaultChannel(QString channel);
+    QString defaultChannel() const;
+
+    bool log(LogSeverity severity, qint64 timestamp, QString module, QString channel, QString message);
+    bool log(LogSeverity severity, QDateTime timestamp, QString module, QString channel, QString message);
+    bool log(LogSeverity severity, QString module, QString channel, QString message);
+
+    bool info(QString message);
+    bool notice(QString message);
+    bool warn(QString message);
+    bool error(QString message);
+
+    // Blocks until everything logged so far has been handed to the socket.
+    void flush();
+private:
+    Q_DISABLE_COPY(QLogLiteAsyncLogger)
+
+    struct Entry
+    {
+        LogSeverity severity;
+        qint64 timestamp;
+        QString module;
+        QString channel;
+        QString message;
+    };
+
+    // Slot of a bounded multi-producer queue: a producer claims a position
+    // with a compare-and-swap on the enqueue position, fills the slot and
+    // publishes it through sequence.
+    struct Cell
+    {
+        std::atomic<quint64> sequence;
+        Entry entry;
+    };
+
+    bool push(Entry& entry);
+    bool pop(Entry& entry);
+    bool isEmpty() const;
+    void wake();
+    void drain();
+    int send(int maxEntries);
+    void runOnSender(std::function<void()> function);
+
+    std::unique_ptr<Cell[]> m_cells;
+    quint64 m_mask;
+    alignas(64) std::atomic<quint64> m_enqueuePosition;
+    alignas(64) quint64 m_dequeuePosition;
+    std::atomic<bool> m_idle;
+    std::atomic<quint64> m_dropped;
+    std::atomic<int> m_fullPolicy;
+    quint64 m_reportedDrops;
+    QString m_module;
+    QString m_channel;
+    QThread m_thread;
+    QObject* m_sender;
+    QLogLiteLogger* m_logger;
+};
+
+#endif // QLOGLITEASYNCLOGGER
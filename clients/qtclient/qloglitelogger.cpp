@@ -1,7 +1,14 @@
 #include "qloglitelogger.h"
 #include <QCoreApplication>
+#include <QtNetwork/QLocalSocket>
 #include <QtNetwork/QHostInfo>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <QTimer>
+#include <cstring>
+#include <new>
 
 namespace
 {
@@ -13,23 +20,192 @@ enum MessageType
     LARGE_MESSAGE,
     CONTINUATION_MESSAGE,
     CONTINUATION_END_MESSAGE,
+    SHARED_MEMORY_MESSAGE,
+    RELAY_MESSAGE,
+    CLOCK_MESSAGE,
 };
 
+const char SHARED_MEMORY_ACCEPTED = 1;
+const quint32 RING_CAPACITY = 16384;
+const quint32 DEFAULT_SPOOL_CAPACITY = 16384;
+const int FLUSH_TIMEOUT = 30000;
+const int MIN_RECONNECT_DELAY = 100;
+const int MAX_RECONNECT_DELAY = 5000;
+const int CLOCK_SYNC_INTERVAL = 30000;
+// How soon frames that found the ring full are tried again when nothing new
+// is logged.
+const int RING_DRAIN_INTERVAL = 5;
+
+bool isContinuation(quint32 type)
+{
+    return type == CONTINUATION_MESSAGE || type == CONTINUATION_END_MESSAGE;
+}
+
 template <size_t size>
-void fillString(char (&destination)[size], QString source)
+void fillBytes(char (&destination)[size], QByteArrayView source)
 {
-    QByteArray src = source.toLocal8Bit();
+    auto length = qMin<qsizetype>(source.size(), size - 1);
+    memcpy(destination, source.data(), length);
+    destination[length] = 0;
+}
 
-    strncpy(destination, src.data(), src.size());
-    if (src.size() < size)
+template <size_t size>
+void fillString(char (&destination)[size], QStringView source)
+{
+    // Names are nearly always ASCII, which reads the same in any local 8-bit
+    // encoding, so only anything else pays for the conversion.
+    auto length = qMin<qsizetype>(source.size(), size - 1);
+    for (qsizetype i = 0; i < length; ++i)
     {
-        destination[src.size()] = 0;
+        auto c = source[i].unicode();
+        if (c >= 0x80)
+        {
+            fillBytes(destination, source.toLocal8Bit());
+            return;
+        }
+        destination[i] = char(c);
     }
-    else
+    destination[length] = 0;
+}
+
+// Message text as the frames see it: a UTF-8 byte count up front, then read
+// a frame's worth at a time straight into the frame.
+class Utf8Text
+{
+public:
+    explicit Utf8Text(QUtf8StringView text)
+        :m_text(text),
+        m_position(0)
     {
-        destination[size - 1] = 0;
     }
-}
+
+    qsizetype size() const
+    {
+        return m_text.size();
+    }
+
+    int read(char* destination, int maxSize)
+    {
+        auto length = int(qMin<qsizetype>(maxSize, m_text.size() - m_position));
+        memcpy(destination, m_text.data() + m_position, length);
+        m_position += length;
+        return length;
+    }
+private:
+    QUtf8StringView m_text;
+    qsizetype m_position;
+};
+
+// Encodes UTF-16 to UTF-8 while reading, so no intermediate QByteArray is
+// needed. A character may straddle two frames; the server joins the frames'
+// bytes before decoding them.
+class Utf16Text
+{
+public:
+    explicit Utf16Text(QStringView text)
+        :m_text(text),
+        m_position(0),
+        m_size(0),
+        m_carry(0),
+        m_carrySize(0)
+    {
+        for (qsizetype i = 0; i < m_text.size(); ++i)
+        {
+            m_size += encode(i, nullptr);
+        }
+    }
+
+    qsizetype size() const
+    {
+        return m_size;
+    }
+
+    int read(char* destination, int maxSize)
+    {
+        int length = 0;
+        while (length < maxSize && m_carry < m_carrySize)
+        {
+            destination[length++] = m_carryBytes[m_carry++];
+        }
+        while (length < maxSize && m_position < m_text.size())
+        {
+            auto c = m_text[m_position].unicode();
+            if (c < 0x80)
+            {
+                destination[length++] = char(c);
+                ++m_position;
+                continue;
+            }
+            m_carrySize = encode(m_position, m_carryBytes);
+            m_position += (m_carrySize == 4) ? 2 : 1;
+            m_carry = 0;
+            while (length < maxSize && m_carry < m_carrySize)
+            {
+                destination[length++] = m_carryBytes[m_carry++];
+            }
+        }
+        return length;
+    }
+private:
+    // UTF-8 bytes of the character at index, written to bytes unless null.
+    // Lone surrogates become U+FFFD, and the low half of a pair counts as
+    // nothing.
+    int encode(qsizetype index, char* bytes) const
+    {
+        uint c = m_text[index].unicode();
+        if (c < 0x80)
+        {
+            if (bytes)
+            {
+                bytes[0] = char(c);
+            }
+            return 1;
+        }
+        if (c < 0x800)
+        {
+            if (bytes)
+            {
+                bytes[0] = char(0xC0 | (c >> 6));
+                bytes[1] = char(0x80 | (c & 0x3F));
+            }
+            return 2;
+        }
+        if (QChar::isHighSurrogate(c) && index + 1 < m_text.size() && m_text[index + 1].isLowSurrogate())
+        {
+            if (bytes)
+            {
+                uint code = QChar::surrogateToUcs4(char16_t(c), m_text[index + 1].unicode());
+                bytes[0] = char(0xF0 | (code >> 18));
+                bytes[1] = char(0x80 | ((code >> 12) & 0x3F));
+                bytes[2] = char(0x80 | ((code >> 6) & 0x3F));
+                bytes[3] = char(0x80 | (code & 0x3F));
+            }
+            return 4;
+        }
+        if (QChar::isLowSurrogate(c) && index > 0 && m_text[index - 1].isHighSurrogate())
+        {
+            return 0;
+        }
+        if (QChar::isSurrogate(c))
+        {
+            c = QChar::ReplacementCharacter;
+        }
+        if (bytes)
+        {
+            bytes[0] = char(0xE0 | (c >> 12));
+            bytes[1] = char(0x80 | ((c >> 6) & 0x3F));
+            bytes[2] = char(0x80 | (c & 0x3F));
+        }
+        return 3;
+    }
+
+    QStringView m_text;
+    qsizetype m_position;
+    qsizetype m_size;
+    int m_carry;
+    int m_carrySize;
+    char m_carryBytes[4];
+};
 
 }
 
@@ -37,10 +213,43 @@ void fillString(char (&destination)[size], QString source)
 
 QLogLiteLogger::QLogLiteLogger()
     :m_pid(0),
+    m_useSharedMemory(false),
+    m_ring(nullptr),
+    m_batching(false),
+    m_reconnect(true),
+    m_reconnectDelay(MIN_RECONNECT_DELAY),
+    m_clockSync(false),
+    m_spoolCapacity(DEFAULT_SPOOL_CAPACITY),
+    m_spoolOverflow(DropOldest),
+    m_spoolFile(nullptr),
+    m_spoolHeader(nullptr),
+    m_spoolFrames(nullptr),
+    m_droppedMessages(0),
+    m_reportedDrops(0),
     m_state(Disconnected)
 {
+    m_memorySpoolHeader = {SpoolHeader::MAGIC, m_spoolCapacity, 0, 0};
+    m_spoolHeader = &m_memorySpoolHeader;
+    m_clockBase = QDateTime::currentMSecsSinceEpoch();
+    m_clock.start();
     m_socket = new QTcpSocket(this);
     connect(m_socket, &QTcpSocket::connected, this, &QLogLiteLogger::connected);
+    connect(m_socket, &QTcpSocket::readyRead, this, &QLogLiteLogger::readReply);
+    connect(m_socket, &QTcpSocket::disconnected, this, &QLogLiteLogger::socketDisconnected);
+    connect(m_socket, &QTcpSocket::errorOccurred, this, &QLogLiteLogger::socketError);
+    m_localSocket = new QLocalSocket(this);
+    connect(m_localSocket, &QLocalSocket::connected, this, &QLogLiteLogger::connected);
+    connect(m_localSocket, &QLocalSocket::readyRead, this, &QLogLiteLogger::readReply);
+    connect(m_localSocket, &QLocalSocket::disconnected, this, &QLogLiteLogger::socketDisconnected);
+    connect(m_localSocket, &QLocalSocket::errorOccurred, this, &QLogLiteLogger::socketError);
+    m_device = m_socket;
+    m_reconnectTimer = new QTimer(this);
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &QLogLiteLogger::reconnectNow);
+    m_clockSyncTimer = new QTimer(this);
+    connect(m_clockSyncTimer, &QTimer::timeout, this, &QLogLiteLogger::synchronizeClock);
+    m_drainTimer = new QTimer(this);
+    connect(m_drainTimer, &QTimer::timeout, this, &QLogLiteLogger::drainRing);
 }
 
 void QLogLiteLogger::connectToHost()
@@ -58,24 +267,136 @@ void QLogLiteLogger::connectToHost(QString server, qint64 pid, QString machineNa
     m_pid = pid;
     m_machineName = machineName;
     m_executablePath = executablePath;
+    m_server = server;
     m_state = Connecting;
+    m_device = m_socket;
+    m_reconnectTimer->stop();
+    m_reconnectDelay = MIN_RECONNECT_DELAY;
     m_socket->connectToHost(server, 0xCC9);
 }
 
+void QLogLiteLogger::connectToLocal()
+{
+    connectToLocal(QCoreApplication::applicationPid(), QHostInfo::localHostName(), QCoreApplication::applicationFilePath());
+}
+
+void QLogLiteLogger::connectToLocal(qint64 pid, QString machineName, QString executablePath)
+{
+    connectToLocal("loglite", pid, machineName, executablePath);
+}
+
+void QLogLiteLogger::connectToLocal(QString serverName, qint64 pid, QString machineName, QString executablePath)
+{
+    m_pid = pid;
+    m_machineName = machineName;
+    m_executablePath = executablePath;
+    m_server = serverName;
+    m_state = Connecting;
+    m_device = m_localSocket;
+    m_reconnectTimer->stop();
+    m_reconnectDelay = MIN_RECONNECT_DELAY;
+    m_localSocket->connectToServer(serverName);
+}
+
 void QLogLiteLogger::disconnnect()
 {
+    if (m_ring)
+    {
+        // Let the server empty the ring before it sees us go.
+        flush();
+        closeRing();
+    }
     m_state = Disconnected;
-    m_socket->disconnectFromHost();
+    m_reconnectTimer->stop();
+    m_clockSyncTimer->stop();
+    if (m_device == m_localSocket)
+    {
+        m_localSocket->disconnectFromServer();
+    }
+    else
+    {
+        m_socket->disconnectFromHost();
+    }
 }
 
 bool QLogLiteLogger::isConnected() const
 {
+    if (m_device == m_localSocket)
+    {
+        return m_localSocket->state() == QLocalSocket::ConnectedState;
+    }
     return m_socket->state() == QTcpSocket::ConnectedState;
 }
 
+void QLogLiteLogger::setSharedMemory(bool enabled)
+{
+    m_useSharedMemory = enabled;
+}
+
+bool QLogLiteLogger::sharedMemory() const
+{
+    return m_useSharedMemory;
+}
+
+void QLogLiteLogger::setReconnect(bool enabled)
+{
+    m_reconnect = enabled;
+}
+
+bool QLogLiteLogger::reconnect() const
+{
+    return m_reconnect;
+}
+
+void QLogLiteLogger::setClockSync(bool enabled)
+{
+    m_clockSync = enabled;
+}
+
+bool QLogLiteLogger::clockSync() const
+{
+    return m_clockSync;
+}
+
+void QLogLiteLogger::setSpoolCapacity(int frames)
+{
+    openSpool(m_spoolFileName, quint32(qMax(1, frames)));
+}
+
+int QLogLiteLogger::spoolCapacity() const
+{
+    return int(m_spoolCapacity);
+}
+
+bool QLogLiteLogger::setSpoolFile(QString fileName)
+{
+    return openSpool(fileName, m_spoolCapacity);
+}
+
+QString QLogLiteLogger::spoolFile() const
+{
+    return m_spoolFileName;
+}
+
+void QLogLiteLogger::setSpoolOverflow(SpoolOverflow policy)
+{
+    m_spoolOverflow = policy;
+}
+
+QLogLiteLogger::SpoolOverflow QLogLiteLogger::spoolOverflow() const
+{
+    return m_spoolOverflow;
+}
+
+quint64 QLogLiteLogger::droppedMessages() const
+{
+    return m_droppedMessages;
+}
+
 void QLogLiteLogger::setDefaultModule(QString module)
 {
     m_module = module;
+    m_moduleBytes = module.toLocal8Bit();
 }
 
 QString QLogLiteLogger::defaultModule() const
@@ -86,6 +407,7 @@ QString QLogLiteLogger::defaultModule() const
 void QLogLiteLogger::setDefaultChannel(QString channel)
 {
     m_channel = channel;
+    m_channelBytes = channel.toLocal8Bit();
 }
 
 QString QLogLiteLogger::defaultChannel() const
@@ -94,6 +416,11 @@ QString QLogLiteLogger::defaultChannel() const
 }
 
 void QLogLiteLogger::log(LogSeverity severity, QDateTime timestamp, QString module, QString channel, QString message)
+{
+    log(severity, timestamp.toMSecsSinceEpoch(), module, channel, message);
+}
+
+void QLogLiteLogger::log(LogSeverity severity, qint64 timestamp, QString module, QString channel, QString message)
 {
     if (m_state == Disconnected)
     {
@@ -101,100 +428,702 @@ void QLogLiteLogger::log(LogSeverity severity, QDateTime timestamp, QString modu
     }
 
     RawLogMessage msg;
-
-    msg.text.timestamp = timestamp.toMSecsSinceEpoch();
+    msg.text.timestamp = timestamp;
     msg.text.severity = severity;
-    fillString(msg.text.channel, channel);
     fillString(msg.text.module, module);
     fillString(msg.text.channel, channel);
+    Utf16Text text(message);
+    sendText(msg, text);
+}
 
-    QByteArray text = message.toLocal8Bit();
-    if (text.size() >= TextMessage::TEXT_SIZE)
+void QLogLiteLogger::log(LogSeverity severity, QString module, QString channel, QString message)
+{
+    log(severity, currentTimestamp(), module, channel, message);
+}
+
+void QLogLiteLogger::log(LogSeverity severity, qint64 timestamp, QUtf8StringView module, QUtf8StringView channel, QUtf8StringView message)
+{
+    if (m_state == Disconnected)
     {
-        msg.type = LARGE_MESSAGE;
+        return;
     }
-    else
+
+    RawLogMessage msg;
+    msg.text.timestamp = timestamp;
+    msg.text.severity = severity;
+    fillBytes(msg.text.module, QByteArrayView(module.data(), module.size()));
+    fillBytes(msg.text.channel, QByteArrayView(channel.data(), channel.size()));
+    Utf8Text text(message);
+    sendText(msg, text);
+}
+
+void QLogLiteLogger::log(LogSeverity severity, QUtf8StringView module, QUtf8StringView channel, QUtf8StringView message)
+{
+    log(severity, currentTimestamp(), module, channel, message);
+}
+
+void QLogLiteLogger::log(LogSeverity severity, const char* module, const char* channel, const char* message)
+{
+    log(severity, currentTimestamp(), QUtf8StringView(module), QUtf8StringView(channel), QUtf8StringView(message));
+}
+
+void QLogLiteLogger::log(LogSeverity severity, const QByteArray& module, const QByteArray& channel, const QByteArray& message)
+{
+    log(severity, currentTimestamp(), QUtf8StringView(module), QUtf8StringView(channel), QUtf8StringView(message));
+}
+
+void QLogLiteLogger::info(QString message)
+{
+    logDefault(SEVERITY_INFO, QStringView(message));
+}
+
+void QLogLiteLogger::info(QUtf8StringView message)
+{
+    logDefault(SEVERITY_INFO, message);
+}
+
+void QLogLiteLogger::info(const char* message)
+{
+    logDefault(SEVERITY_INFO, QUtf8StringView(message));
+}
+
+void QLogLiteLogger::info(const QByteArray& message)
+{
+    logDefault(SEVERITY_INFO, QUtf8StringView(message));
+}
+
+void QLogLiteLogger::notice(QString message)
+{
+    logDefault(SEVERITY_NOTICE, QStringView(message));
+}
+
+void QLogLiteLogger::notice(QUtf8StringView message)
+{
+    logDefault(SEVERITY_NOTICE, message);
+}
+
+void QLogLiteLogger::notice(const char* message)
+{
+    logDefault(SEVERITY_NOTICE, QUtf8StringView(message));
+}
+
+void QLogLiteLogger::notice(const QByteArray& message)
+{
+    logDefault(SEVERITY_NOTICE, QUtf8StringView(message));
+}
+
+void QLogLiteLogger::warn(QString message)
+{
+    logDefault(SEVERITY_WARN, QStringView(message));
+}
+
+void QLogLiteLogger::warn(QUtf8StringView message)
+{
+    logDefault(SEVERITY_WARN, message);
+}
+
+void QLogLiteLogger::warn(const char* message)
+{
+    logDefault(SEVERITY_WARN, QUtf8StringView(message));
+}
+
+void QLogLiteLogger::warn(const QByteArray& message)
+{
+    logDefault(SEVERITY_WARN, QUtf8StringView(message));
+}
+
+void QLogLiteLogger::error(QString message)
+{
+    logDefault(SEVERITY_ERR, QStringView(message));
+}
+
+void QLogLiteLogger::error(QUtf8StringView message)
+{
+    logDefault(SEVERITY_ERR, message);
+}
+
+void QLogLiteLogger::error(const char* message)
+{
+    logDefault(SEVERITY_ERR, QUtf8StringView(message));
+}
+
+void QLogLiteLogger::error(const QByteArray& message)
+{
+    logDefault(SEVERITY_ERR, QUtf8StringView(message));
+}
+
+qint64 QLogLiteLogger::currentTimestamp() const
+{
+    return m_clockBase + m_clock.elapsed();
+}
+
+void QLogLiteLogger::logDefault(LogSeverity severity, QStringView message)
+{
+    if (m_state == Disconnected)
     {
-        msg.type = SIMPLE_MESSAGE;
+        return;
     }
-    int offset = 0;
-    do
+
+    RawLogMessage msg;
+    msg.text.timestamp = currentTimestamp();
+    msg.text.severity = severity;
+    fillBytes(msg.text.module, m_moduleBytes);
+    fillBytes(msg.text.channel, m_channelBytes);
+    Utf16Text text(message);
+    sendText(msg, text);
+}
+
+void QLogLiteLogger::logDefault(LogSeverity severity, QUtf8StringView message)
+{
+    if (m_state == Disconnected)
     {
-        strncpy(msg.text.message, text.data() + offset, TextMessage::TEXT_SIZE - 1);
-        msg.text.message[TextMessage::TEXT_SIZE - 1] = 0;
-        offset += TextMessage::TEXT_SIZE - 1;
+        return;
+    }
 
-        if (m_state == Connected)
+    RawLogMessage msg;
+    msg.text.timestamp = currentTimestamp();
+    msg.text.severity = severity;
+    fillBytes(msg.text.module, m_moduleBytes);
+    fillBytes(msg.text.channel, m_channelBytes);
+    Utf8Text text(message);
+    sendText(msg, text);
+}
+
+template <typename Text>
+void QLogLiteLogger::sendText(RawLogMessage& msg, Text& text)
+{
+    // Each frame carries TEXT_SIZE - 1 bytes of text and a terminating zero.
+    const int chunk = TextMessage::TEXT_SIZE - 1;
+    int frames = qMax(1, int((text.size() + chunk - 1) / chunk));
+    if (m_ring && m_state == Connected)
+    {
+        drainPending();
+    }
+    // A message goes into the ring or the spool whole, so the spool never
+    // holds the rest of one the server has started reading, and into the
+    // spool whole or not at all.
+    bool spooled = m_state != Connected || (m_ring && (spoolSize() || ringRoom() < quint64(frames)));
+    if (spooled && !makeSpoolRoom(frames))
+    {
+        ++m_droppedMessages;
+        return;
+    }
+    for (int i = 0; i < frames; ++i)
+    {
+        if (frames == 1)
+        {
+            msg.type = SIMPLE_MESSAGE;
+        }
+        else if (i == 0)
         {
-            m_socket->write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+            msg.type = LARGE_MESSAGE;
         }
         else
         {
-            m_pendingMessages.append(msg);
+            msg.type = i + 1 < frames ? CONTINUATION_MESSAGE : CONTINUATION_END_MESSAGE;
         }
-        if (offset + TextMessage::TEXT_SIZE < text.size())
+        msg.text.message[text.read(msg.text.message, chunk)] = 0;
+        if (spooled)
         {
-            msg.type = CONTINUATION_MESSAGE;
+            spool(msg);
         }
         else
         {
-            msg.type = CONTINUATION_END_MESSAGE;
+            send(msg);
         }
     }
-    while (offset < text.size());
+    if (spooled && m_ring && !m_drainTimer->isActive())
+    {
+        m_drainTimer->start(RING_DRAIN_INTERVAL);
+    }
 }
 
-void QLogLiteLogger::log(LogSeverity severity, QString module, QString channel, QString message)
+void QLogLiteLogger::beginBatch()
 {
-    log(severity, QDateTime::currentDateTime(), module, channel, message);
+    m_batching = true;
 }
 
-void QLogLiteLogger::info(QString message)
+void QLogLiteLogger::endBatch()
 {
-    log(SEVERITY_INFO, m_module, m_channel, message);
+    m_batching = false;
+    if (!m_batch.isEmpty())
+    {
+        m_device->write(m_batch);
+        m_batch.clear();
+    }
 }
 
-void QLogLiteLogger::notice(QString message)
+qint64 QLogLiteLogger::bytesToWrite() const
 {
-    log(SEVERITY_NOTICE, m_module, m_channel, message);
+    return m_device->bytesToWrite() + m_batch.size() + qint64(spoolSize()) * qint64(sizeof(RawLogMessage));
 }
 
-void QLogLiteLogger::warn(QString message)
+void QLogLiteLogger::flush()
 {
-    log(SEVERITY_WARN, m_module, m_channel, message);
+    if (!m_batch.isEmpty())
+    {
+        m_device->write(m_batch);
+        m_batch.clear();
+    }
+    if (m_device == m_localSocket)
+    {
+        if (m_localSocket->state() == QLocalSocket::ConnectingState)
+        {
+            m_localSocket->waitForConnected();
+        }
+    }
+    else
+    {
+        QAbstractSocket::SocketState state = m_socket->state();
+        if (state == QAbstractSocket::HostLookupState || state == QAbstractSocket::ConnectingState)
+        {
+            m_socket->waitForConnected();
+        }
+    }
+    while ((m_state == Synchronizing || m_state == Handshaking) && m_device->waitForReadyRead(FLUSH_TIMEOUT))
+    {
+    }
+    if (m_ring)
+    {
+        auto header = static_cast<SharedRingHeader*>(m_ring->data());
+        QElapsedTimer clock;
+        clock.start();
+        drainPending();
+        while (m_ring && clock.elapsed() < FLUSH_TIMEOUT &&
+               isConnected() &&
+               (spoolSize() || header->tail.load(std::memory_order_acquire) != header->head.load(std::memory_order_relaxed)))
+        {
+            QThread::msleep(1);
+            drainPending();
+        }
+    }
+    m_device->waitForBytesWritten(FLUSH_TIMEOUT);
 }
 
-void QLogLiteLogger::error(QString message)
+void QLogLiteLogger::send(const RawLogMessage& msg)
 {
-    log(SEVERITY_ERR, m_module, m_channel, message);
+    if (m_state != Connected)
+    {
+        spool(msg);
+    }
+    else if (m_ring)
+    {
+        // Messages that did not fit in the ring wait their turn, so order is
+        // kept when it has room again.
+        drainPending();
+        if (spoolSize() || !writeRing(msg))
+        {
+            spool(msg);
+            if (!m_drainTimer->isActive())
+            {
+                m_drainTimer->start(RING_DRAIN_INTERVAL);
+            }
+        }
+    }
+    else if (m_batching)
+    {
+        m_batch.append(reinterpret_cast<const char*>(&msg), sizeof(msg));
+    }
+    else
+    {
+        m_device->write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+    }
 }
 
-void QLogLiteLogger::flush()
+bool QLogLiteLogger::writeRing(const RawLogMessage& msg)
+{
+    auto header = static_cast<SharedRingHeader*>(m_ring->data());
+    auto frames = reinterpret_cast<RawLogMessage*>(static_cast<char*>(m_ring->data()) + sizeof(SharedRingHeader));
+    quint64 head = header->head.load(std::memory_order_relaxed);
+    if (head - header->tail.load(std::memory_order_acquire) >= RING_CAPACITY)
+    {
+        return false;
+    }
+    frames[head % RING_CAPACITY] = msg;
+    header->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+quint64 QLogLiteLogger::ringRoom() const
+{
+    auto header = static_cast<const SharedRingHeader*>(m_ring->constData());
+    return RING_CAPACITY - (header->head.load(std::memory_order_relaxed) - header->tail.load(std::memory_order_acquire));
+}
+
+void QLogLiteLogger::drainPending()
+{
+    if (m_ring)
+    {
+        while (auto size = spoolSize())
+        {
+            // Whole messages only, see sendText(). One longer than the ring
+            // goes once the ring is empty.
+            quint64 frames = 1;
+            while (frames < size && isContinuation(m_spoolFrames[(m_spoolHeader->tail + frames) % m_spoolCapacity].type))
+            {
+                ++frames;
+            }
+            if (ringRoom() < qMin<quint64>(frames, RING_CAPACITY))
+            {
+                break;
+            }
+            for (; frames && writeRing(m_spoolFrames[m_spoolHeader->tail % m_spoolCapacity]); --frames)
+            {
+                ++m_spoolHeader->tail;
+            }
+        }
+        if (spoolSize() && !m_drainTimer->isActive())
+        {
+            m_drainTimer->start(RING_DRAIN_INTERVAL);
+        }
+        return;
+    }
+    while (auto size = spoolSize())
+    {
+        // At most two runs, the spool may wrap around.
+        auto offset = m_spoolHeader->tail % m_spoolCapacity;
+        auto count = qMin<quint64>(size, m_spoolCapacity - offset);
+        m_device->write(reinterpret_cast<const char*>(m_spoolFrames + offset), qint64(count * sizeof(RawLogMessage)));
+        m_spoolHeader->tail += count;
+    }
+}
+
+void QLogLiteLogger::drainRing()
+{
+    drainPending();
+    if (!m_ring || !spoolSize())
+    {
+        m_drainTimer->stop();
+    }
+}
+
+void QLogLiteLogger::closeRing()
+{
+    m_drainTimer->stop();
+    delete m_ring;
+    m_ring = nullptr;
+    // The rest of a message that went out in part would reach the next
+    // connection without its first frame.
+    if (spoolSize() && isContinuation(m_spoolFrames[m_spoolHeader->tail % m_spoolCapacity].type))
+    {
+        do
+        {
+            ++m_spoolHeader->tail;
+        }
+        while (spoolSize() && isContinuation(m_spoolFrames[m_spoolHeader->tail % m_spoolCapacity].type));
+        ++m_droppedMessages;
+    }
+}
+
+void QLogLiteLogger::startReconnect()
+{
+    if (!m_reconnect)
+    {
+        m_state = Disconnected;
+        return;
+    }
+    // Messages logged until then go to the spool.
+    m_state = Connecting;
+    if (!m_reconnectTimer->isActive())
+    {
+        m_reconnectTimer->start(m_reconnectDelay);
+        m_reconnectDelay = qMin(m_reconnectDelay * 2, MAX_RECONNECT_DELAY);
+    }
+}
+
+void QLogLiteLogger::reportDrops()
+{
+    if (m_droppedMessages == m_reportedDrops)
+    {
+        return;
+    }
+    auto count = m_droppedMessages - m_reportedDrops;
+    m_reportedDrops = m_droppedMessages;
+    log(SEVERITY_WARN, currentTimestamp(), QString("LogLite"), QString("overload"), QString("%1 messages dropped, the spool was full").arg(count));
+}
+
+bool QLogLiteLogger::openSpool(QString fileName, quint32 capacity)
+{
+    // Whatever is spooled already moves to the new spool.
+    QVector<RawLogMessage> spooled;
+    spooled.reserve(int(spoolSize()));
+    for (auto i = m_spoolHeader->tail; i != m_spoolHeader->head; ++i)
+    {
+        spooled.append(m_spoolFrames[i % m_spoolCapacity]);
+    }
+    m_spoolHeader->tail = m_spoolHeader->head;
+    closeSpool();
+
+    m_spoolCapacity = capacity;
+    m_spoolFileName = fileName;
+    m_memorySpoolHeader = {SpoolHeader::MAGIC, capacity, 0, 0};
+    m_spoolHeader = &m_memorySpoolHeader;
+    bool opened = true;
+    if (!fileName.isEmpty())
+    {
+        qint64 size = sizeof(SpoolHeader) + qint64(capacity) * qint64(sizeof(RawLogMessage));
+        m_spoolFile = new QFile(fileName, this);
+        uchar* data = nullptr;
+        if (m_spoolFile->open(QIODevice::ReadWrite) && (m_spoolFile->size() == size || m_spoolFile->resize(size)))
+        {
+            data = m_spoolFile->map(0, size);
+        }
+        if (data)
+        {
+            auto header = reinterpret_cast<SpoolHeader*>(data);
+            // Anything left by an earlier run of this process is sent on the
+            // next connect, unless the file is not a spool of this size.
+            if (header->magic != SpoolHeader::MAGIC || header->capacity != capacity || header->head - header->tail > capacity)
+            {
+                *header = {SpoolHeader::MAGIC, capacity, 0, 0};
+            }
+            m_spoolHeader = header;
+            m_spoolFrames = reinterpret_cast<RawLogMessage*>(data + sizeof(SpoolHeader));
+        }
+        else
+        {
+            delete m_spoolFile;
+            m_spoolFile = nullptr;
+            m_spoolFileName.clear();
+            opened = false;
+        }
+    }
+
+    for (auto it = spooled.begin(); it != spooled.end(); ++it)
+    {
+        if (makeSpoolRoom(1))
+        {
+            spool(*it);
+        }
+    }
+    return opened;
+}
+
+void QLogLiteLogger::closeSpool()
+{
+    if (m_spoolFile)
+    {
+        m_spoolHeader = &m_memorySpoolHeader;
+        delete m_spoolFile;
+        m_spoolFile = nullptr;
+    }
+    m_spoolMemory.reset();
+    m_spoolFrames = nullptr;
+}
+
+quint64 QLogLiteLogger::spoolSize() const
+{
+    return m_spoolHeader->head - m_spoolHeader->tail;
+}
+
+bool QLogLiteLogger::makeSpoolRoom(int frames)
+{
+    if (quint32(frames) > m_spoolCapacity)
+    {
+        return false;
+    }
+    while (m_spoolCapacity - spoolSize() < quint32(frames))
+    {
+        // The rest of a message the server has started reading cannot go.
+        if (m_spoolOverflow == DropNewest || isContinuation(m_spoolFrames[m_spoolHeader->tail % m_spoolCapacity].type))
+        {
+            return false;
+        }
+        // Drop the oldest message with all its continuation frames. A clock
+        // message goes on its own and is no loss worth reporting.
+        auto type = m_spoolFrames[m_spoolHeader->tail % m_spoolCapacity].type;
+        do
+        {
+            ++m_spoolHeader->tail;
+        }
+        while (spoolSize() && isContinuation(m_spoolFrames[m_spoolHeader->tail % m_spoolCapacity].type));
+        if (type != CLOCK_MESSAGE)
+        {
+            ++m_droppedMessages;
+        }
+    }
+    return true;
+}
+
+void QLogLiteLogger::spool(const RawLogMessage& msg)
 {
-    QAbstractSocket::SocketState state = m_socket->state();
-    if (state == QAbstractSocket::HostLookupState || state == QAbstractSocket::ConnectingState)
+    if (!m_spoolFrames)
     {
-        m_socket->waitForConnected();
+        // Left uninitialised, so pages the spool never reaches cost nothing.
+        m_spoolMemory.reset(new RawLogMessage[m_spoolCapacity]);
+        m_spoolFrames = m_spoolMemory.get();
+    }
+    // Text messages have made room for all their frames already.
+    if (!makeSpoolRoom(1))
+    {
+        return;
     }
-    m_socket->waitForBytesWritten();
+    m_spoolFrames[m_spoolHeader->head % m_spoolCapacity] = msg;
+    ++m_spoolHeader->head;
 }
 
 void QLogLiteLogger::connected()
 {
+    m_reconnectDelay = MIN_RECONNECT_DELAY;
+    // Catch up with any change of the wall clock.
+    m_clockBase = QDateTime::currentMSecsSinceEpoch();
+    m_clock.start();
+    closeRing();
+    if (m_useSharedMemory)
+    {
+        m_ring = new QSharedMemory(QString("loglite-%1-%2").arg(QCoreApplication::applicationPid()).arg(quintptr(this), 0, 16), this);
+        if (m_ring->create(sizeof(SharedRingHeader) + RING_CAPACITY * sizeof(RawLogMessage)))
+        {
+            auto header = new (m_ring->data()) SharedRingHeader;
+            header->capacity = RING_CAPACITY;
+            header->head.store(0);
+            header->tail.store(0);
+            header->magic = SharedRingHeader::MAGIC;
+        }
+        else
+        {
+            closeRing();
+        }
+    }
+
     RawLogMessage msg;
     msg.type = CONNECTION_MESSAGE;
     msg.connection.pid = m_pid;
-    msg.connection.version = 2;
+    // Version 3 servers are the ones that understand shared memory, version
+    // 5 ones clock messages.
+    msg.connection.version = m_clockSync ? 5 : m_ring ? 3 : 2;
     fillString(msg.connection.machineName, m_machineName);
     fillString(msg.connection.executablePath, m_executablePath);
 
-    m_socket->write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+    m_device->write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+
+    if (m_clockSync)
+    {
+        // Spooled messages wait for the server's answer, so they already
+        // arrive with our clock offset known.
+        memset(&msg, 0, sizeof(msg));
+        msg.type = CLOCK_MESSAGE;
+        msg.clock.clientSent = quint64(currentTimestamp());
+        m_device->write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+        m_state = Synchronizing;
+        m_clockSyncTimer->start(CLOCK_SYNC_INTERVAL);
+        return;
+    }
+    startSession();
+}
 
-    for (QVector<RawLogMessage>::iterator it = m_pendingMessages.begin(); it != m_pendingMessages.end(); ++it)
+void QLogLiteLogger::startSession()
+{
+    if (m_ring)
     {
-        const RawLogMessage& m = *it;
-        m_socket->write(reinterpret_cast<const char*>(&m), sizeof(m));
+        RawLogMessage msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.type = SHARED_MEMORY_MESSAGE;
+        msg.sharedMemory.capacity = RING_CAPACITY;
+        fillString(msg.sharedMemory.key, m_ring->key());
+        m_device->write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+        m_state = Handshaking;
+        return;
     }
-    m_pendingMessages.clear();
+
+    drainPending();
     m_state = Connected;
+    reportDrops();
+}
+
+void QLogLiteLogger::readReply()
+{
+    if (m_state == Handshaking)
+    {
+        char reply;
+        if (m_device->read(&reply, 1) != 1)
+        {
+            return;
+        }
+        if (reply != SHARED_MEMORY_ACCEPTED)
+        {
+            closeRing();
+        }
+        m_state = Connected;
+        drainPending();
+        reportDrops();
+        return;
+    }
+    if (!m_clockSyncTimer->isActive())
+    {
+        m_device->readAll();
+        return;
+    }
+    // The server answers each clock message with its own time, which goes
+    // back with the time we read it.
+    RawLogMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = CLOCK_MESSAGE;
+    while ((m_state == Synchronizing || m_state == Connected) && m_device->bytesAvailable() >= qint64(sizeof(msg.clock)))
+    {
+        m_device->read(reinterpret_cast<char*>(&msg.clock), sizeof(msg.clock));
+        msg.clock.clientReceived = quint64(currentTimestamp());
+        if (m_state == Synchronizing)
+        {
+            m_device->write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+            startSession();
+        }
+        else
+        {
+            send(msg);
+        }
+    }
+}
+
+void QLogLiteLogger::synchronizeClock()
+{
+    if (m_state != Connected)
+    {
+        return;
+    }
+    RawLogMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = CLOCK_MESSAGE;
+    msg.clock.clientSent = quint64(currentTimestamp());
+    send(msg);
+}
+
+void QLogLiteLogger::socketDisconnected()
+{
+    closeRing();
+    m_clockSyncTimer->stop();
+    if (m_state != Disconnected)
+    {
+        startReconnect();
+    }
+}
+
+void QLogLiteLogger::socketError()
+{
+    // Failed connection attempts only report an error, lost connections
+    // also go through socketDisconnected().
+    if (m_state != Disconnected && !isConnected())
+    {
+        closeRing();
+        m_clockSyncTimer->stop();
+        startReconnect();
+    }
+}
+
+void QLogLiteLogger::reconnectNow()
+{
+    if (m_state != Connecting)
+    {
+        return;
+    }
+    if (m_device == m_localSocket)
+    {
+        m_localSocket->abort();
+        m_localSocket->connectToServer(m_server);
+    }
+    else
+    {
+        m_socket->abort();
+        m_socket->connectToHost(m_server, 0xCC9);
+    }
 }
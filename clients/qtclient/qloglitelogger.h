@@ -1,8 +1,17 @@
 #ifndef QLOGLITELOGGER
 #define QLOGLITELOGGER
 
+#include <QElapsedTimer>
 #include <QObject>
+#include <QSharedMemory>
+#include <QUtf8StringView>
 #include <QtNetwork/QTcpSocket>
+#include <atomic>
+#include <memory>
+
+class QFile;
+class QLocalSocket;
+class QTimer;
 
 class QLogLiteLogger: public QObject
 {
@@ -17,27 +26,98 @@ public:
         SEVERITY_COUNT,
     };
 
+    // What happens to a message that does not fit in the spool.
+    enum SpoolOverflow
+    {
+        DropNewest,
+        DropOldest,
+    };
+
     QLogLiteLogger();
 
     void connectToHost();
     void connectToHost(qint64 pid, QString machineName, QString executablePath);
     void connectToHost(QString server, qint64 pid, QString machineName, QString executablePath);
+    // Connects through the local socket (Unix domain socket or named pipe)
+    // LogLite listens on next to its TCP port, bypassing the TCP stack.
+    void connectToLocal();
+    void connectToLocal(qint64 pid, QString machineName, QString executablePath);
+    void connectToLocal(QString serverName, qint64 pid, QString machineName, QString executablePath);
     void disconnnect();
 
     bool isConnected() const;
 
+    // Hand messages to a LogLite on this machine through shared memory
+    // instead of the socket. Takes effect on the next connect, and falls back
+    // to the socket if the server does not accept it.
+    void setSharedMemory(bool enabled);
+    bool sharedMemory() const;
+
+    // After losing the connection, try again with a growing delay until
+    // disconnnect(). On by default.
+    void setReconnect(bool enabled);
+    bool reconnect() const;
+
+    // Exchange clock messages with LogLite on connecting and every half
+    // minute after, so it can move our timestamps to its clock more exactly
+    // than from arrival times alone. Needs a version 5 server. Takes effect
+    // on the next connect.
+    void setClockSync(bool enabled);
+    bool clockSync() const;
+
+    // Messages logged while not connected are spooled, up to this many
+    // frames of 255 bytes of text each, and sent with their original
+    // timestamps once connected.
+    void setSpoolCapacity(int frames);
+    int spoolCapacity() const;
+    // Keeps the spool in a memory mapped file instead, so it also survives
+    // restarting this process. An empty name goes back to memory.
+    bool setSpoolFile(QString fileName);
+    QString spoolFile() const;
+    void setSpoolOverflow(SpoolOverflow policy);
+    SpoolOverflow spoolOverflow() const;
+    // Messages lost to a full spool, reported to LogLite on the next connect.
+    quint64 droppedMessages() const;
+
     void setDefaultModule(QString module);
     QString defaultModule() const;
     void setDefaultChannel(QString channel);
     QString defaultChannel() const;
 
+    // Timestamps are in milliseconds since the epoch. Without one, the time
+    // comes from a monotonic clock set from the wall clock on each connect.
     void log(LogSeverity severity, QDateTime timestamp, QString module, QString channel, QString message);
+    void log(LogSeverity severity, qint64 timestamp, QString module, QString channel, QString message);
     void log(LogSeverity severity, QString module, QString channel, QString message);
+    // UTF-8 text is copied into the frames as is.
+    void log(LogSeverity severity, qint64 timestamp, QUtf8StringView module, QUtf8StringView channel, QUtf8StringView message);
+    void log(LogSeverity severity, QUtf8StringView module, QUtf8StringView channel, QUtf8StringView message);
+    void log(LogSeverity severity, const char* module, const char* channel, const char* message);
+    void log(LogSeverity severity, const QByteArray& module, const QByteArray& channel, const QByteArray& message);
 
     void info(QString message);
+    void info(QUtf8StringView message);
+    void info(const char* message);
+    void info(const QByteArray& message);
     void notice(QString message);
+    void notice(QUtf8StringView message);
+    void notice(const char* message);
+    void notice(const QByteArray& message);
     void warn(QString message);
+    void warn(QUtf8StringView message);
+    void warn(const char* message);
+    void warn(const QByteArray& message);
     void error(QString message);
+    void error(QUtf8StringView message);
+    void error(const char* message);
+    void error(const QByteArray& message);
+
+    // Frames logged between beginBatch() and endBatch() go to the socket in
+    // a single write.
+    void beginBatch();
+    void endBatch();
+    // Bytes logged but not yet handed to the operating system or the ring.
+    qint64 bytesToWrite() const;
 
     void flush();
 private:
@@ -63,6 +143,21 @@ private:
         char message[TEXT_SIZE];
     };
 
+    struct SharedMemoryMessage
+    {
+        static const int KEY_SIZE = 64;
+
+        quint32 capacity;
+        char key[KEY_SIZE];
+    };
+
+    struct ClockMessage
+    {
+        quint64 clientSent;
+        quint64 serverTime;
+        quint64 clientReceived;
+    };
+
     struct RawLogMessage
     {
         quint32 type;
@@ -70,28 +165,107 @@ private:
         {
             ConnectionMessage connection;
             TextMessage text;
+            SharedMemoryMessage sharedMemory;
+            ClockMessage clock;
         };
     };
 
+    struct SharedRingHeader
+    {
+        static const quint32 MAGIC = 0x4C4C5352;
+
+        quint32 magic;
+        quint32 capacity;
+        alignas(64) std::atomic<quint64> head;
+        alignas(64) std::atomic<quint64> tail;
+    };
+
+    // Start of a spool file, followed by capacity frames. head and tail
+    // count the frames ever spooled and sent.
+    struct SpoolHeader
+    {
+        static const quint32 MAGIC = 0x4C4C5350;
+
+        quint32 magic;
+        quint32 capacity;
+        quint64 head;
+        quint64 tail;
+    };
+
+    qint64 currentTimestamp() const;
+    void logDefault(LogSeverity severity, QStringView message);
+    void logDefault(LogSeverity severity, QUtf8StringView message);
+    template <typename Text>
+    void sendText(RawLogMessage& msg, Text& text);
+    void send(const RawLogMessage& msg);
+    bool writeRing(const RawLogMessage& msg);
+    quint64 ringRoom() const;
+    void drainPending();
+    void closeRing();
+    void startSession();
+    void startReconnect();
+    void reportDrops();
+
+    bool openSpool(QString fileName, quint32 capacity);
+    void closeSpool();
+    quint64 spoolSize() const;
+    bool makeSpoolRoom(int frames);
+    void spool(const RawLogMessage& msg);
+
 
     QTcpSocket* m_socket;
+    QLocalSocket* m_localSocket;
+    QIODevice* m_device;
     qint64 m_pid;
     QString m_machineName;
     QString m_executablePath;
     QString m_module;
     QString m_channel;
-    QVector<RawLogMessage> m_pendingMessages;
+    QByteArray m_moduleBytes;
+    QByteArray m_channelBytes;
+    QElapsedTimer m_clock;
+    qint64 m_clockBase;
+    QString m_server;
+    bool m_useSharedMemory;
+    QSharedMemory* m_ring;
+    QTimer* m_drainTimer;
+    bool m_batching;
+    QByteArray m_batch;
+    bool m_reconnect;
+    int m_reconnectDelay;
+    QTimer* m_reconnectTimer;
+    bool m_clockSync;
+    QTimer* m_clockSyncTimer;
+
+    quint32 m_spoolCapacity;
+    SpoolOverflow m_spoolOverflow;
+    QString m_spoolFileName;
+    QFile* m_spoolFile;
+    SpoolHeader m_memorySpoolHeader;
+    std::unique_ptr<RawLogMessage[]> m_spoolMemory;
+    SpoolHeader* m_spoolHeader;
+    RawLogMessage* m_spoolFrames;
+    quint64 m_droppedMessages;
+    quint64 m_reportedDrops;
 
     enum State
     {
         Disconnected,
         Connecting,
+        Synchronizing,
+        Handshaking,
         Connected,
     };
 
     State m_state;
 private slots:
     void connected();
+    void readReply();
+    void socketDisconnected();
+    void socketError();
+    void reconnectNow();
+    void synchronizeClock();
+    void drainRing();
 };
 
 
@@ -2,49 +2,17 @@
 #define ABSTRACTLOGMODEL
 
 #include <QAbstractTableModel>
-#include <QDateTime>
+#include <QHash>
 #include <QIODevice>
+#include <QPair>
 #include <QPixmap>
 #include <cstdint>
+#include "logmessage.h"
+#include "logpatterns.h"
+#include "logsummarytree.h"
+#include "timestampindex.h"
 
 
-enum LogSeverity
-{
-    SEVERITY_INFO,
-    SEVERITY_NOTICE,
-    SEVERITY_WARN,
-    SEVERITY_ERR,
-
-    SEVERITY_COUNT,
-};
-
-enum LogField
-{
-    LOGFIELD_SEVERITY = -1,
-    LOGFIELD_TIMESTAMP = 0,
-    LOGFIELD_PID,
-    LOGFIELD_EXE_PATH,
-    LOGFIELD_MACHINE,
-    LOGFIELD_MODULE,
-    LOGFIELD_CHANNEL,
-    LOGFIELD_MESSAGE,
-};
-
-struct LogMessage
-{
-    QDateTime timestamp;
-    quint64 pid;
-    LogSeverity severity;
-    QString machineName;
-    QString executablePath;
-    QString module;
-    QString channel;
-    QString message;
-
-    QString originalMessage;
-    bool isMultilineContinuation;
-};
-
 enum LogColorBackground
 {
     COLOR_NONE,
@@ -78,12 +46,16 @@ public:
         int notice;
         int info;
         int clients;
+        int dropped;
     };
 
     virtual const Statistics &statistics() const = 0;
     virtual bool isListening() const = 0;
 
     const LogMessage *message(int index) const;
+    const LogSummaryTree &summary() const;
+    const TimestampIndex &timestampIndex() const;
+    LogPatterns *patterns() const;
 
     void setBreakLines(bool breakLines);
     void setColorBackground(LogColorBackground colorBackground);
@@ -91,6 +63,9 @@ public:
 
     void setSplitByPid(bool split);
     bool splitByPid() const;
+    void setFoldRepeats(bool foldRepeats);
+    bool foldRepeats() const;
+    void expandRepeats(int row);
     void setTimestampPrecision(TimestampPrecision precision);
 
     void saveAsText(QIODevice* output);
@@ -100,13 +75,16 @@ public:
     QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
 protected:
-    void addMessage(LogMessage*);
+    bool addMessage(LogMessage*);
+    void emitFoldedRows();
+    void deleteMessages();
     QVector<LogMessage*> m_messages;
     bool m_breakLines;
 private:
     void refreshColorBackgroundTheme();
     void explodeMessages();
     void collapseMessages();
+    bool foldRepeat(LogMessage* message);
 
     QVector<QPixmap> m_logTypes;
     QList<uint64_t> m_pids;
@@ -114,6 +92,13 @@ private:
     TimestampPrecision m_timestampPrecision;
     LogColorBackground m_colorBackground;
     LogColorTheme m_colorTheme;
+    bool m_foldRepeats;
+    QHash<QPair<QString, quint64>, int> m_lastRows;
+    int m_foldedFirst;
+    int m_foldedLast;
+    LogSummaryTree m_summary;
+    TimestampIndex m_timestampIndex;
+    LogPatterns* m_patterns;
 public slots:
     virtual void clear() = 0;
 };
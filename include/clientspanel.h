@@ -0,0 +1,34 @@
+#ifndef CLIENTSPANEL_H
+#define CLIENTSPANEL_H
+
+#include <QTimer>
+#include <QWidget>
+
+class LogModel;
+class QPushButton;
+class QTableWidget;
+
+
+class ClientsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ClientsPanel(LogModel *model, QWidget *parent = nullptr);
+
+    static QString formatBytes(double bytes);
+protected:
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+private:
+    LogModel *m_model;
+    QTableWidget *m_table;
+    QPushButton *m_disconnect;
+    QTimer m_updateTimer;
+private slots:
+    void updateClients();
+    void updateButtons();
+    void disconnectSelected();
+};
+
+#endif // CLIENTSPANEL_H
@@ -0,0 +1,52 @@
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include "logrelay.h"
+#include "logserver.h"
+
+
+class Collector : public QObject
+{
+    Q_OBJECT
+
+public:
+    Collector(QObject* parent = nullptr);
+    ~Collector();
+
+    bool listen(quint16 port = LogServer::DEFAULT_PORT);
+
+    void setOutputDirectory(const QString& outputDirectory);
+    QString outputDirectory() const;
+    void setMaxMessages(int maxMessages);
+    int maxMessages() const;
+    void setSegmentInterval(int seconds);
+    int segmentInterval() const;
+    void setClientRateLimit(int messagesPerSecond);
+    int clientRateLimit() const;
+    bool setDatagramsEnabled(bool enabled);
+    bool setUpstream(const QString& address);
+public slots:
+    bool flush();
+private slots:
+    void clientConnected();
+    void clientDisconnected();
+    void addMessages(const QVector<LogMessage*>& messages);
+private:
+    LogServer m_server;
+    LogRelay m_relay;
+    QVector<const LogMessage*> m_messages;
+    QString m_outputDirectory;
+    int m_maxMessages;
+    QTimer m_segmentTimer;
+    // After a failed write, segments are only tried again on the segment
+    // timer, or this one without it, and messages past a full segment are
+    // dropped.
+    bool m_writeFailed;
+    QTimer m_retryTimer;
+    quint64 m_droppedMessages;
+};
+
+#endif // COLLECTOR_H
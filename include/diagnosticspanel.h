@@ -0,0 +1,32 @@
+#ifndef DIAGNOSTICSPANEL_H
+#define DIAGNOSTICSPANEL_H
+
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QWidget>
+#include "profiler.h"
+
+class QTableWidget;
+
+
+class DiagnosticsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsPanel(QWidget *parent = nullptr);
+protected:
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+private:
+    QTableWidget *m_table;
+    QTimer m_updateTimer;
+    QElapsedTimer m_sinceUpdate;
+    quint64 m_previousCalls[Profiler::SECTION_COUNT];
+private slots:
+    void updateCounters();
+    void resetCounters();
+    void exportTrace();
+};
+
+#endif // DIAGNOSTICSPANEL_H
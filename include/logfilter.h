@@ -3,6 +3,7 @@
 
 #include <QSortFilterProxyModel>
 #include <QColor>
+#include <QRegularExpression>
 #include "abstractlogmodel.h"
 
 class QDir;
@@ -20,6 +21,8 @@ public:
         GTE,
         LT,
         LTE,
+        MATCHES,
+        NOT_MATCHES,
     };
 
     enum BoolOperator
@@ -33,14 +36,23 @@ public:
         Condition();
         bool load(QJsonObject json);
         QJsonObject save() const;
+        void prepare();
         bool applies(const LogMessage *message) const;
+        bool evaluateString(const QString& value) const;
 
-        static bool evaluateOperator(Operator op, int operand0, int operand1);
+        static bool evaluateOperator(Operator op, qint64 operand0, qint64 operand1);
         static bool evaluateOperator(Operator op, QString operand0, QString operand1);
 
         LogField m_field;
         Operator m_op;
         QVariant m_operand;
+
+        bool m_hasNumericOperand;
+        qint64 m_numericOperand;
+        QString m_stringOperand;
+        QRegularExpression m_regex;
+        QString m_regexPrefix;
+        bool m_regexAnchored;
     };
 
     typedef QVector<Condition> Conditions;
@@ -52,6 +64,9 @@ public:
     QJsonObject save() const;
     bool save(QString path) const;
 
+    void prepare();
+    bool timeBounds(qint64& from, qint64& to) const;
+
     static bool applies(const LogMessage *message, const Conditions& conditions, BoolOperator juncture);
     bool applies(const LogMessage* message) const;
 
@@ -67,6 +82,10 @@ public:
     static QString boolOperatorToString(BoolOperator op);
     static BoolOperator boolOperatorFromString(QString string, bool* ok = nullptr);
 
+    static QDateTime parseDateTime(QString text, QDate date = QDate());
+    static qint64 parseTimestamp(QString text, bool* ok = nullptr);
+    static LogSeverity parseSeverity(QVariant value, bool* ok = nullptr);
+
     static QDir settingsDirectory();
 
     QString m_name;
@@ -87,6 +106,7 @@ public:
         Highlight();
         bool load(QJsonObject object);
         QJsonObject save() const;
+        void prepare();
 
         QColor m_foreground;
         QColor m_background;
@@ -100,6 +120,7 @@ public:
     bool load(QString path);
     QJsonObject save() const;
     bool save(QString path) const;
+    void prepare();
 
     QColor getForegroundColor(const LogMessage* message) const;
     QColor getBackgroundColor(const LogMessage* message) const;
@@ -120,11 +141,18 @@ public:
     LogFilter(QObject* parent = nullptr);
 
     void filterSeverity(LogSeverity severity, bool visible);
+    bool isSeverityVisible(LogSeverity severity) const;
     bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
     void setCustomFilter(const Filter* filter);
     const Filter* customFilter() const;
     void setHighlight(const HighlightSet* highlight);
     const HighlightSet* highlight() const;
+    void setTimeRange(const QDateTime& from, const QDateTime& to);
+    bool hasTimeRange() const;
+    QDateTime timeRangeFrom() const;
+    QDateTime timeRangeTo() const;
+    void setTemplateFilter(int templateId);
+    int templateFilter() const;
 
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
 public slots:
@@ -133,11 +161,27 @@ public slots:
     void showNotices(bool show);
     void showInfos(bool show);
 private:
+    void refilter();
+    void updateTimeBounds();
+    bool acceptsTimestamp(const AbstractLogModel* model, int sourceRow, const LogMessage* message) const;
+
     uint32_t m_severity;
     Filter m_customFilter;
     HighlightSet m_highlight;
     bool m_hasCustomFilter;
     bool m_hasHighlight;
+    QDateTime m_timeRangeFrom;
+    QDateTime m_timeRangeTo;
+    bool m_hasTimeBounds;
+    qint64 m_timeFrom;
+    qint64 m_timeTo;
+
+    mutable const TimestampIndex* m_timeBoundsIndex;
+    mutable int m_timeBoundsGeneration;
+    mutable int m_timeBoundsRows;
+    mutable int m_firstTimeRow;
+    mutable int m_lastTimeRow;
+    int m_templateId;
 };
 
 #endif // LOGFILTER_H
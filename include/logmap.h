@@ -24,13 +24,28 @@ protected:
 private:
     void paintMap();
     void scrollTo(int y);
+    void rebuildBuckets();
+    void addRow(int row);
+
+    // Worst severity (plus one, zero meaning no rows) for each run of
+    // m_bucketSize consecutive filtered rows. The bucket size doubles whenever
+    // the number of buckets would exceed MAX_BUCKETS, so painting never
+    // depends on the number of rows.
+    static const int MAX_BUCKETS = 4096;
 
     LogFilter *m_model;
     QPixmap m_map;
     QTableView *m_buddy;
     bool m_mapValid;
+    bool m_bucketsValid;
+    QVector<quint8> m_buckets;
+    int m_bucketSize;
+    int m_rows;
 public slots:
     void invalidateMap();
+private slots:
+    void rowsInserted(const QModelIndex &parent, int first, int last);
+    void invalidateBuckets();
 };
 
 #endif // LOGMAP_H
@@ -0,0 +1,54 @@
+#ifndef LOGMESSAGE_H
+#define LOGMESSAGE_H
+
+#include <QDateTime>
+#include <QString>
+
+
+enum LogSeverity
+{
+    SEVERITY_INFO,
+    SEVERITY_NOTICE,
+    SEVERITY_WARN,
+    SEVERITY_ERR,
+
+    SEVERITY_COUNT,
+};
+
+enum LogField
+{
+    LOGFIELD_SEVERITY = -1,
+    LOGFIELD_TIMESTAMP = 0,
+    LOGFIELD_PID,
+    LOGFIELD_EXE_PATH,
+    LOGFIELD_MACHINE,
+    LOGFIELD_MODULE,
+    LOGFIELD_CHANNEL,
+    LOGFIELD_MESSAGE,
+};
+
+struct LogMessage
+{
+    QDateTime timestamp;
+    quint64 pid;
+    LogSeverity severity;
+    QString machineName;
+    QString executablePath;
+    QString module;
+    QString channel;
+    QString message;
+
+    QString originalMessage;
+    bool isMultilineContinuation;
+
+    // Identical messages folded into this one, lastTimestamp is only set
+    // when repeatCount is above one.
+    quint32 repeatCount = 1;
+    QDateTime lastTimestamp;
+
+    // Milliseconds added to the timestamp the client sent to bring it to
+    // the server's clock.
+    qint32 clockOffset = 0;
+};
+
+#endif // LOGMESSAGE_H
@@ -1,8 +1,15 @@
 #ifndef LOGMODEL_H
 #define LOGMODEL_H
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
 #include "abstractlogmodel.h"
-#include <QtNetwork/QTcpServer>
+#include "logrelay.h"
+#include "logserver.h"
+#include "reorderbuffer.h"
+
+class QTimer;
 
 
 class LogModel : public AbstractLogModel
@@ -10,32 +17,39 @@ class LogModel : public AbstractLogModel
     Q_OBJECT
 
 public:
-    LogModel(QObject* parent = nullptr);
+    LogModel(QObject* parent = nullptr, quint16 port = LogServer::DEFAULT_PORT);
     ~LogModel();
 
-    class Client
-    {
-    public:
-        Client();
-        Client(QTcpSocket* socket);
+    typedef LogServer::Client Client;
+    typedef LogServer::Clients Clients;
+    typedef LogServer::ClientMetrics ClientMetrics;
 
-        uint64_t pid() const;
-        QString path() const;
-        QString machine() const;
-
-        QTcpSocket* socket() const;
+    // While the server backlog or its age is over a threshold, info and
+    // notice messages are sampled per client and the rest dropped. Warnings
+    // and errors are always kept. A zero threshold disables that check.
+    struct OverloadPolicy
+    {
+        OverloadPolicy();
 
-        bool operator==(const Client& other) const;
-    private:
-        QTcpSocket* m_socket;
+        int maxBacklog;
+        int maxLag;
+        int sampleInterval;
     };
 
-
-    typedef QSet<Client> Clients;
-
     const Clients& clients() const;
     bool clientFromMessage(const LogMessage& message, Client& client);
     void disconnect(const Client& client);
+    ClientMetrics clientMetrics(const Client& client) const;
+    void setClientRateLimit(int messagesPerSecond);
+    int clientRateLimit() const;
+    bool setDatagramsEnabled(bool enabled);
+    bool datagramsEnabled() const;
+    void setClockCorrection(bool enabled);
+    bool clockCorrection() const;
+    // Forwards everything received, before overload shedding, to another
+    // LogLite given as "host[:port]"; empty to stop.
+    bool setUpstream(const QString& address);
+    const LogRelay& relay() const;
 
     const Statistics &statistics() const;
     bool isListening() const;
@@ -47,8 +61,22 @@ public:
     void setAutoSaveDirectory(const QString& autoSaveDirectory);
     QString autoSaveDirectory() const;
     int getRunningCount(LogSeverity severity);
+
+    void setOverloadPolicy(const OverloadPolicy& policy);
+    const OverloadPolicy& overloadPolicy() const;
+    bool isOverloaded() const;
+
+    // Holds messages back for up to this many milliseconds to add them in
+    // timestamp order across clients, see ReorderBuffer. Zero adds them as
+    // they arrive.
+    void setReorderDelay(int milliseconds);
+    int reorderDelay() const;
 private:
     bool autoSave();
+    void appendMessages(const QVector<LogMessage*>& messages);
+    void updateOverload();
+    bool shed(const LogMessage* message);
+    void appendDropMarkers();
 
     class RunningCount
     {
@@ -63,30 +91,45 @@ private:
         int m_count;
     };
 
-    Clients m_clients;
-
-    QTcpServer m_server;
-    LogMessage *m_nextMessage;
-    QByteArray m_receivedText;
+    LogServer m_server;
+    LogRelay m_relay;
     Statistics m_statistics;
     int m_maxMessages;
     QString m_autoSaveDirectory;
-    bool m_listening;
     bool m_serverMode;
     RunningCount m_runningCounts[SEVERITY_COUNT];
+
+    struct Shedding
+    {
+        Shedding();
+
+        int sampleCounter;
+        int dropped;
+        QDateTime lastTimestamp;
+        QString executablePath;
+    };
+
+    OverloadPolicy m_overloadPolicy;
+    bool m_overloaded;
+    QHash<QPair<QString, quint64>, Shedding> m_shedding;
+
+    ReorderBuffer m_reorder;
+    QElapsedTimer m_reorderClock;
+    QTimer* m_reorderTimer;
 private slots:
     void acceptConnection();
     void socketDisconnected();
-    void readMessages();
+    void addMessages(const QVector<LogMessage*>& messages);
     void updateRuningCounts();
+    void flushDropMarkers();
+    void releaseReordered();
 public slots:
     void clear();
     void disconnectAll();
 signals:
     void clientConnected();
     void clientDisconnected();
+    void overloadChanged(bool overloaded);
 };
 
-uint qHash(const LogModel::Client& client);
-
 #endif // LOGMODEL_H
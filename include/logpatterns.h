@@ -0,0 +1,84 @@
+#ifndef LOGPATTERNS_H
+#define LOGPATTERNS_H
+
+#include <QDateTime>
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+
+class AbstractLogModel;
+class TemplateMiner;
+
+// Assigns every row of an AbstractLogModel a message template mined by a
+// TemplateMiner on a worker thread. Rows appended to the model are mined
+// incrementally; any other change to the rows starts over once the event
+// loop gets a turn, so a burst of changes costs a single rebuild.
+class LogPatterns : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Template
+    {
+        Template();
+
+        QString text;
+        quint64 count;
+        qint64 first;
+        qint64 last;
+    };
+
+    LogPatterns(AbstractLogModel* model);
+    ~LogPatterns();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    // While watched, the model reports rows getting a template as changed,
+    // so filters on the template re-evaluate them.
+    void watch(bool watch);
+    bool isWatched() const;
+
+    int templateOf(int row) const;
+    const QVector<Template>& templates() const;
+    int pendingRows() const;
+signals:
+    void templatesChanged();
+    void rowsAssigned(int first, int last);
+private:
+    struct Entry
+    {
+        QString text;
+        qint64 first;
+        qint64 last;
+        quint32 repeats;
+        bool continuation;
+    };
+
+    typedef QVector<QPair<int, Template>> Changes;
+
+    void scheduleRebuild();
+    void submit(int first, int last);
+    void mine(int generation, int first, const QVector<Entry>& entries);
+    void assign(int generation, int first, const QVector<int>& ids, const Changes& changes);
+
+    AbstractLogModel* m_model;
+    QThread m_thread;
+    QObject* m_worker;
+    TemplateMiner* m_miner;
+    QVector<Template> m_minedTemplates;
+    QVector<int> m_rows;
+    QVector<Template> m_templates;
+    int m_submitted;
+    int m_generation;
+    QTimer m_rebuildTimer;
+    int m_watchers;
+    bool m_enabled;
+private slots:
+    void rowsInserted(const QModelIndex& parent, int first, int last);
+    void rowsChanged();
+    void rebuild();
+};
+
+#endif // LOGPATTERNS_H
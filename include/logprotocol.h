@@ -0,0 +1,145 @@
+#ifndef LOGPROTOCOL_H
+#define LOGPROTOCOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace LogProtocol
+{
+
+const uint32_t VERSION = 5;
+const uint16_t DEFAULT_PORT = 0xCC9;
+// Local socket of a server on the default port; servers on other ports
+// append "-<port>".
+const char* const DEFAULT_LOCAL_NAME = "loglite";
+
+enum MessageType
+{
+    CONNECTION_MESSAGE,
+    SIMPLE_MESSAGE,
+    LARGE_MESSAGE,
+    CONTINUATION_MESSAGE,
+    CONTINUATION_END_MESSAGE,
+    SHARED_MEMORY_MESSAGE,
+    RELAY_MESSAGE,
+    CLOCK_MESSAGE,
+};
+
+const char SHARED_MEMORY_REJECTED = 0;
+const char SHARED_MEMORY_ACCEPTED = 1;
+
+struct ConnectionMessage
+{
+    static const size_t MESSAGE_MAX_PATH = 260;
+
+    uint32_t version;
+    uint64_t pid;
+    char machineName[32];
+    char executablePath[MESSAGE_MAX_PATH];
+};
+
+struct TextMessage
+{
+    static const size_t TEXT_SIZE = 256;
+
+    uint64_t timestamp;
+    uint32_t severity;
+    char module[32];
+    char channel[32];
+    char message[TEXT_SIZE];
+};
+
+// Sent by a version 3 client on the same machine, right after its
+// connection message, to move all further messages to a shared memory ring
+// it has created. The server answers with a single SHARED_MEMORY_ACCEPTED or
+// SHARED_MEMORY_REJECTED byte; until then the client sends nothing else, and
+// if rejected it carries on over the socket.
+struct SharedMemoryMessage
+{
+    static const size_t KEY_SIZE = 64;
+
+    uint32_t capacity;
+    char key[KEY_SIZE];
+};
+
+// Sent by a version 5 client to find out how far its clock is from the
+// server's, first right after its connection message and then whenever it
+// likes. The client fills in clientSent and leaves the rest zero; the server
+// at once writes the same ClockMessage back as raw bytes with serverTime
+// filled in, and the client returns it in another clock message with
+// clientReceived. All three are milliseconds since the epoch, like
+// TextMessage::timestamp.
+struct ClockMessage
+{
+    uint64_t clientSent;
+    uint64_t serverTime;
+    uint64_t clientReceived;
+};
+
+struct RawLogMessage
+{
+    uint32_t type;
+    union
+    {
+        ConnectionMessage connection;
+        TextMessage text;
+        SharedMemoryMessage sharedMemory;
+        ClockMessage clock;
+    };
+};
+
+// Start of a shared memory ring, followed by capacity RawLogMessage frames.
+// head and tail count the frames ever written and read: only the client
+// moves head and only the server moves tail.
+struct SharedRingHeader
+{
+    static const uint32_t MAGIC = 0x4C4C5352;
+
+    uint32_t magic;
+    uint32_t capacity;
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+};
+
+// Fire-and-forget messages over UDP, sent to the server's port without any
+// connection. A datagram is a DatagramHeader, the sender's machine name and
+// executable path, then recordCount records, each a DatagramRecord followed
+// by its module, channel and message. Text is UTF-8 without terminators and
+// nothing is aligned. sequence counts the sender's datagrams, so the server
+// can tell how many got lost.
+const size_t MAX_DATAGRAM_SIZE = 65507;
+
+struct DatagramHeader
+{
+    static const uint32_t MAGIC = 0x4C4C4447;
+
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t recordCount;
+    // From here up to the end of the executable path identifies the sender.
+    uint8_t machineNameSize;
+    uint8_t reserved;
+    uint16_t executablePathSize;
+    uint64_t pid;
+};
+
+struct DatagramRecord
+{
+    uint64_t timestamp;
+    uint32_t severity;
+    uint16_t messageSize;
+    uint8_t moduleSize;
+    uint8_t channelSize;
+};
+
+// Sent by a version 4 client, right after its connection message, to
+// forward the messages other clients sent to it. Everything after it on the
+// connection is relay blocks: a uint32_t size, then a datagram of that size
+// whose sequence is the int32_t the relay's server corrected the timestamps
+// by, in milliseconds.
+const size_t MAX_RELAY_BLOCK_SIZE = MAX_DATAGRAM_SIZE;
+
+}
+
+#endif // LOGPROTOCOL_H
@@ -0,0 +1,66 @@
+#ifndef LOGRELAY_H
+#define LOGRELAY_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+#include <QtNetwork/QTcpSocket>
+#include "logmessage.h"
+
+
+// Forwards the messages a server receives to an upstream LogLite, where
+// each original client shows up as a remote client behind this relay.
+// Messages are packed into relay blocks, one per run of messages from the
+// same client, and written every few milliseconds. While the upstream cannot
+// be reached they are kept up to the capacity, then dropped and counted.
+class LogRelay : public QObject
+{
+    Q_OBJECT
+
+public:
+    LogRelay(QObject* parent = nullptr);
+
+    // Upstream as "host[:port]", empty to stop relaying.
+    bool setUpstream(const QString& address);
+    QString upstream() const;
+    bool isConnected() const;
+
+    void setCapacity(qint64 bytes);
+    qint64 capacity() const;
+    quint64 dropped() const;
+public slots:
+    void forward(const QVector<LogMessage*>& messages);
+    void flush();
+private slots:
+    void connected();
+    void socketError();
+    void reconnectNow();
+private:
+    void startReconnect();
+    void append(const LogMessage& message);
+    void beginBlock(const LogMessage& message);
+    void finishBlock();
+    void reportDrops();
+
+    QTcpSocket m_socket;
+    QString m_host;
+    quint16 m_port;
+    QTimer m_flushTimer;
+    QTimer m_reconnectTimer;
+    int m_reconnectDelay;
+    qint64 m_capacity;
+    QByteArray m_pending;
+    // Start of the block being filled in m_pending, or -1.
+    int m_blockStart;
+    quint32 m_blockRecords;
+    quint64 m_blockPid;
+    qint32 m_blockClockOffset;
+    QString m_blockMachineName;
+    QString m_blockExecutablePath;
+    quint64 m_dropped;
+    quint64 m_reportedDrops;
+};
+
+#endif // LOGRELAY_H
@@ -0,0 +1,254 @@
+#ifndef LOGSERVER_H
+#define LOGSERVER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QUdpSocket>
+#include "logmessage.h"
+#include "logprotocol.h"
+
+class QIODevice;
+class SharedRing;
+
+
+class LogServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const quint16 DEFAULT_PORT = LogProtocol::DEFAULT_PORT;
+
+    LogServer(QObject* parent = nullptr);
+    ~LogServer();
+
+    class Client
+    {
+    public:
+        Client();
+        Client(QIODevice* socket);
+
+        uint64_t pid() const;
+        QString path() const;
+        QString machine() const;
+        // The relay a remote client's messages arrive through, or a null
+        // client for one connected directly.
+        Client relay() const;
+
+        QIODevice* socket() const;
+
+        bool operator==(const Client& other) const;
+    private:
+        QIODevice* m_socket;
+    };
+
+    typedef QSet<Client> Clients;
+
+    struct ClientMetrics
+    {
+        ClientMetrics();
+
+        double messagesPerSecond;
+        double bytesPerSecond;
+        qint64 backlog;
+        qint64 reassemblyBytes;
+        quint64 totalMessages;
+        quint64 totalBytes;
+        bool throttled;
+        bool sharedMemory;
+        bool localSocket;
+        bool datagram;
+        quint64 lostDatagrams;
+        bool relay;
+        // The server's clock minus the client's in milliseconds, and whether
+        // the client measured it with clock messages.
+        qint64 clockOffset;
+        bool clockSynchronized;
+    };
+
+    // Listens on the TCP port and on a local socket (a Unix domain socket or
+    // named pipe) named after it, both speaking the same protocol.
+    bool listen(quint16 port = DEFAULT_PORT);
+    bool isListening() const;
+    bool isListeningLocally() const;
+    quint16 port() const;
+    static QString localName(quint16 port);
+    QString localServerName() const;
+
+    // Also accept datagrams (see LogProtocol::DatagramHeader) on the UDP port
+    // of the same number. Each sender shows up as a client of its own until
+    // it has been quiet for a minute or is disconnected.
+    bool setDatagramsEnabled(bool enabled);
+    bool datagramsEnabled() const;
+    bool isListeningForDatagrams() const;
+
+    const Clients& clients() const;
+    bool clientFromMessage(const LogMessage& message, Client& client) const;
+    void disconnect(const Client& client);
+    ClientMetrics metrics(const Client& client) const;
+
+    // A client receiving more than this many messages per second over the
+    // metrics window gets throttled: its socket read buffer is capped so the
+    // sender sees TCP backpressure, and its backlog is read at this rate.
+    // Zero disables throttling.
+    void setClientRateLimit(int messagesPerSecond);
+    int clientRateLimit() const;
+
+    // Ready sockets are read round-robin, a quantum of frames each per turn,
+    // until the frame budget is spent; then the event loop gets a turn. The
+    // quantum adapts so a full round stays well inside the budget.
+    void setFrameBudget(int microseconds);
+    int frameBudget() const;
+    int readQuantum() const;
+
+    // Frames waiting in client sockets, and how long in milliseconds the
+    // read queue has not been drained.
+    qint64 backlog() const;
+    qint64 backlogAge() const;
+
+    // Move the timestamps of clients that exchange clock messages to the
+    // server's clock, keeping the offset in the message. On by default.
+    void setClockCorrection(bool enabled);
+    bool clockCorrection() const;
+public slots:
+    void disconnectAll();
+signals:
+    void clientConnected();
+    void clientDisconnected();
+    void messagesReceived(const QVector<LogMessage*>& messages);
+private:
+    class RateWindow
+    {
+    public:
+        RateWindow();
+        void add(qint64 amount);
+        void update();
+        double perSecond() const;
+    private:
+        QVector<qint64> m_bins;
+        int m_bin;
+        qint64 m_total;
+    };
+
+    // A clock message cannot arrive before it was sent, so its arrival time
+    // minus the client's time in it bounds the client's clock offset from
+    // above; the server's time returned by the client bounds it from below.
+    // The offset is taken halfway between the tightest bounds of the current
+    // and the previous window. Message timestamps are no guide, as a client
+    // may send messages long after it stamped them.
+    class ClockEstimate
+    {
+    public:
+        ClockEstimate();
+        void addUpperBound(qint64 offset);
+        void addLowerBound(qint64 offset);
+        void update();
+        bool isSynchronized() const;
+        qint64 offset() const;
+    private:
+        void estimate();
+
+        qint64 m_upperBounds[2];
+        qint64 m_lowerBounds[2];
+        int m_intervals;
+        bool m_synchronized;
+        qint64 m_offset;
+    };
+
+    struct Connection
+    {
+        Connection();
+
+        LogMessage* nextMessage;
+        QByteArray receivedText;
+        RateWindow messages;
+        RateWindow bytes;
+        quint64 totalMessages;
+        quint64 totalBytes;
+        bool throttled;
+        double readTokens;
+        bool ready;
+        SharedRing* ring;
+        bool relay;
+        ClockEstimate clock;
+    };
+
+    // Datagram senders and clients behind a relay have no socket of their
+    // own. Their client is a stand-in device with the same properties as a
+    // connected socket, a child of the relay socket for remote clients.
+    struct VirtualClient
+    {
+        VirtualClient();
+
+        QIODevice* relay;
+        QByteArray identity;
+        quint64 pid;
+        QString machineName;
+        QString executablePath;
+        RateWindow messages;
+        RateWindow bytes;
+        quint64 totalMessages;
+        quint64 totalBytes;
+        quint32 nextSequence;
+        quint64 lostDatagrams;
+        QElapsedTimer lastSeen;
+        qint32 clockOffset;
+    };
+
+    void scheduleRead(QIODevice* socket);
+    int readClient(QIODevice* socket, int maxFrames, QVector<LogMessage*>& messages);
+    int readRing(QIODevice* socket, Connection& connection, int maxFrames, QVector<LogMessage*>& messages);
+    int readRelay(QIODevice* socket, Connection& connection, int maxFrames, QVector<LogMessage*>& messages);
+    bool processFrame(QIODevice* socket, Connection& connection, const LogProtocol::RawLogMessage& msg, QVector<LogMessage*>& messages);
+    void attachRing(QIODevice* socket, Connection& connection, const LogProtocol::SharedMemoryMessage& message);
+    qint64 pendingFrames(QIODevice* socket, const Connection& connection) const;
+    bool canRead(QIODevice* socket, const Connection& connection) const;
+    void setThrottled(QIODevice* socket, Connection& connection, bool throttled);
+    bool bindDatagrams();
+    void processDatagram(const char* data, qint64 size, QIODevice* relay, QVector<LogMessage*>& messages);
+    VirtualClient* virtualClient(const LogProtocol::DatagramHeader& header, const char* identity, int identitySize, QIODevice* relay);
+    void removeVirtualClient(QIODevice* device);
+    qint32 correction(const ClockEstimate& clock) const;
+
+    QTcpServer m_server;
+    QLocalServer m_localServer;
+    Clients m_clients;
+    QHash<QIODevice*, Connection> m_connections;
+    QUdpSocket m_datagramSocket;
+    bool m_datagramsEnabled;
+    QByteArray m_datagramBuffer;
+    QHash<QIODevice*, VirtualClient> m_virtualClients;
+    QHash<QPair<QIODevice*, QByteArray>, QIODevice*> m_virtualDevices;
+    QTimer m_datagramTimer;
+    bool m_clockCorrection;
+    int m_clientRateLimit;
+    QTimer m_metricsTimer;
+    QTimer m_throttleTimer;
+    QList<QIODevice*> m_readyClients;
+    QTimer m_readTimer;
+    QTimer m_ringTimer;
+    QElapsedTimer m_backlogClock;
+    qint64 m_frameBudget;
+    double m_frameCost;
+    int m_readQuantum;
+private slots:
+    void acceptConnection();
+    void acceptLocalConnection();
+    void socketDisconnected();
+    void readMessages();
+    void readReadyClients();
+    void updateMetrics();
+    void readThrottled();
+    void pollRings();
+    void readDatagrams();
+};
+
+uint qHash(const LogServer::Client& client);
+
+#endif // LOGSERVER_H
@@ -0,0 +1,19 @@
+#ifndef LOGSTORAGE_H
+#define LOGSTORAGE_H
+
+#include <QString>
+#include <QVector>
+#include "logmessage.h"
+
+
+class LogStorage
+{
+public:
+    static bool load(const QString& fileName, QVector<LogMessage*>& messages, QString* error = nullptr);
+    static bool save(const QVector<const LogMessage*>& messages, const QString& fileName);
+
+    static QString autoSaveFileName(const QString& directory);
+    static bool autoSave(const QVector<const LogMessage*>& messages, const QString& directory);
+};
+
+#endif // LOGSTORAGE_H
@@ -0,0 +1,51 @@
+#ifndef LOGSUMMARYTREE_H
+#define LOGSUMMARYTREE_H
+
+#include "logmessage.h"
+#include <QVector>
+
+// Block based aggregate index over the rows of an AbstractLogModel. Leaves
+// summarize BLOCK_SIZE consecutive rows and every parent summarizes FAN_OUT
+// children, so range queries and severity searches skip whole blocks.
+class LogSummaryTree
+{
+public:
+    struct Summary
+    {
+        Summary();
+        void add(LogSeverity severity, qint64 timestamp, quint64 pid);
+        void merge(const Summary& other);
+        LogSeverity worstSeverity() const;
+        bool mayContainPid(quint64 pid) const;
+
+        int rows;
+        int counts[SEVERITY_COUNT];
+        qint64 minTimestamp;
+        qint64 maxTimestamp;
+        // One bit per pid hash, so blocks without a pid can be skipped.
+        quint64 pids;
+    };
+
+    LogSummaryTree(const QVector<LogMessage*>& messages);
+
+    void clear();
+    void rebuild();
+    void append(int row);
+    int size() const;
+
+    int findNext(int row, LogSeverity severity) const;
+    int findPrevious(int row, LogSeverity severity) const;
+    Summary summarize(int first, int last) const;
+private:
+    static const int BLOCK_SIZE = 256;
+    static const int FAN_OUT = 16;
+
+    bool matches(int row, LogSeverity severity) const;
+    void collect(Summary& summary, int level, int first, int last) const;
+
+    const QVector<LogMessage*>& m_messages;
+    QVector<QVector<Summary>> m_levels;
+    int m_rows;
+};
+
+#endif // LOGSUMMARYTREE_H
@@ -20,6 +20,8 @@ public:
     QString selectionAsText() const;
     QString selectionMessagesAsText() const;
 
+    bool goToTimestamp(qint64 timestamp);
+
 signals:
 
 public slots:
@@ -41,6 +43,7 @@ private slots:
 private:
     QTimer m_autoScroll;
 
+    bool selectSourceRow(int row);
     void nextSeverity(LogSeverity);
     void previousSeverity(LogSeverity);
 };
@@ -46,6 +46,8 @@ private slots:
     void openFind();
     void findNext();
     void findPrevious();
+    void goToTime();
+    void editTimeRange();
 
     void columnMenu(const QPoint &position);
     void columnMenuChanged();
@@ -61,6 +63,8 @@ private slots:
 
     void setServerMode();
     void splitByPids();
+    void foldRepeats();
+    void expandRepeats();
     void showSettings();
     void showAboutDialog();
 
@@ -0,0 +1,50 @@
+#ifndef PATTERNSPANEL_H
+#define PATTERNSPANEL_H
+
+#include <QPointer>
+#include <QTimer>
+#include <QWidget>
+
+class AbstractLogModel;
+class LogFilter;
+class PatternTableModel;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QSortFilterProxyModel;
+class QTableView;
+
+
+class PatternsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PatternsPanel(LogFilter *filter, QWidget *parent = nullptr);
+protected:
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+private:
+    int selectedTemplate() const;
+
+    LogFilter *m_filter;
+    QPointer<AbstractLogModel> m_model;
+    PatternTableModel *m_patterns;
+    QSortFilterProxyModel *m_sorted;
+    QLineEdit *m_search;
+    QTableView *m_table;
+    QPushButton *m_filterButton;
+    QPushButton *m_showAll;
+    QLabel *m_status;
+    QTimer m_updateTimer;
+    bool m_dirty;
+private slots:
+    void sourceModelChanged();
+    void markDirty();
+    void updatePatterns();
+    void updateButtons();
+    void filterSelected();
+    void showAll();
+};
+
+#endif // PATTERNSPANEL_H
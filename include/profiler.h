@@ -0,0 +1,123 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+
+class Profiler
+{
+public:
+    enum Section
+    {
+        SECTION_READ_MESSAGES,
+        SECTION_ADD_MESSAGE,
+        SECTION_FILTER_INVALIDATE,
+        SECTION_PAINT_MAP,
+        SECTION_SAVE_MODEL,
+        SECTION_DATA,
+
+        SECTION_COUNT,
+    };
+
+    // Durations are kept in power of two nanosecond buckets, bucket i
+    // holding durations in [2^i, 2^(i+1)).
+    static const int HISTOGRAM_BUCKETS = 40;
+    static const int MAX_TRACE_EVENTS = 200000;
+
+    struct Statistics
+    {
+        quint64 calls;
+        quint64 timedCalls;
+        quint64 totalNanoseconds;
+        quint64 maxNanoseconds;
+        quint64 histogram[HISTOGRAM_BUCKETS];
+
+        double meanNanoseconds() const;
+        double percentileNanoseconds(double fraction) const;
+    };
+
+    class Scope
+    {
+    public:
+        explicit Scope(Section section);
+        ~Scope();
+    private:
+        Section m_section;
+        qint64 m_start;
+    };
+
+    static Profiler& instance();
+    static const char* sectionName(Section section);
+    static qint64 now();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    void count(Section section);
+    void record(Section section, qint64 start, qint64 duration);
+    void reset();
+
+    Statistics statistics(Section section) const;
+    bool exportTrace(const QString& fileName) const;
+private:
+    Profiler();
+
+    struct Counters
+    {
+        std::atomic<quint64> calls;
+        std::atomic<quint64> timedCalls;
+        std::atomic<quint64> totalNanoseconds;
+        std::atomic<quint64> maxNanoseconds;
+        std::atomic<quint64> histogram[HISTOGRAM_BUCKETS];
+    };
+
+    struct TraceEvent
+    {
+        Section section;
+        qint64 start;
+        qint64 duration;
+        quint64 thread;
+    };
+
+    std::atomic<bool> m_enabled;
+    Counters m_counters[SECTION_COUNT];
+    mutable QMutex m_traceMutex;
+    QVector<TraceEvent> m_trace;
+    int m_traceNext;
+};
+
+
+inline Profiler::Scope::Scope(Section section)
+    :m_section(section),
+      m_start(-1)
+{
+    auto& profiler = Profiler::instance();
+    profiler.count(section);
+    if (profiler.isEnabled())
+    {
+        m_start = now();
+    }
+}
+
+inline Profiler::Scope::~Scope()
+{
+    if (m_start >= 0)
+    {
+        Profiler::instance().record(m_section, m_start, now() - m_start);
+    }
+}
+
+inline bool Profiler::isEnabled() const
+{
+    return m_enabled.load(std::memory_order_relaxed);
+}
+
+inline void Profiler::count(Section section)
+{
+    m_counters[section].calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+#endif // PROFILER_H
@@ -0,0 +1,73 @@
+#ifndef REORDERBUFFER_H
+#define REORDERBUFFER_H
+
+#include "logmessage.h"
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include <deque>
+
+// Holds received messages back for up to a maximum delay and releases them
+// as a k-way merge of the clients' streams by timestamp. Each client's
+// messages wait in a queue sorted by timestamp, so one arriving out of order
+// is inserted where it belongs. A message is released once every client
+// heard from within the delay has sent one at least as late, or once one at
+// least as late has waited the whole delay. A message that has waited only
+// takes along others up to the latest timestamp another client has reached,
+// so one far ahead of the rest does not release everything. Messages older
+// than what their client already had released are counted as late.
+class ReorderBuffer
+{
+public:
+    ReorderBuffer();
+    ~ReorderBuffer();
+
+    void setMaxDelay(int milliseconds);
+    int maxDelay() const;
+
+    // now is a monotonic clock in milliseconds.
+    void add(LogMessage* message, qint64 now);
+    void take(qint64 now, QVector<LogMessage*>& messages);
+    void takeAll(QVector<LogMessage*>& messages);
+    int size() const;
+    quint64 late() const;
+private:
+    Q_DISABLE_COPY(ReorderBuffer)
+
+    typedef QPair<QString, quint64> StreamKey;
+
+    struct Entry
+    {
+        qint64 timestamp;
+        qint64 arrival;
+        LogMessage* message;
+    };
+
+    struct Stream
+    {
+        Stream();
+
+        std::deque<Entry> entries;
+        qint64 latest;
+        qint64 lastArrival;
+        qint64 released;
+    };
+
+    struct Arrival
+    {
+        qint64 time;
+        qint64 timestamp;
+        StreamKey stream;
+    };
+
+    void release(qint64 bound, QVector<LogMessage*>& messages);
+    void releaseFront(Stream& stream, QVector<LogMessage*>& messages);
+
+    int m_maxDelay;
+    QHash<StreamKey, Stream> m_streams;
+    std::deque<Arrival> m_arrivals;
+    int m_size;
+    quint64 m_late;
+};
+
+#endif // REORDERBUFFER_H
@@ -0,0 +1,48 @@
+#ifndef SHAREDRING_H
+#define SHAREDRING_H
+
+#include <QSharedMemory>
+#include <QString>
+#include "logprotocol.h"
+
+// Single producer, single consumer ring of protocol frames in shared memory.
+// A client creates the ring and writes to it, the server attaches to it and
+// reads frames in place, releasing them once processed.
+class SharedRing
+{
+public:
+    static const quint32 DEFAULT_CAPACITY = 16384;
+    static const quint32 MAX_CAPACITY = 262144;
+
+    SharedRing();
+    ~SharedRing();
+
+    bool create(const QString& key, quint32 capacity = DEFAULT_CAPACITY);
+    bool attach(const QString& key, quint32 capacity);
+    void detach();
+    bool isAttached() const;
+    QString key() const;
+    quint32 capacity() const;
+    QString errorString() const;
+
+    // Copies as many frames as there is room for, returns how many.
+    quint32 write(const LogProtocol::RawLogMessage* frames, quint32 count);
+
+    // Frames waiting to be read.
+    quint64 size() const;
+    // The next contiguous run of waiting frames, valid until released.
+    const LogProtocol::RawLogMessage* read(quint32& count) const;
+    void release(quint32 count);
+private:
+    Q_DISABLE_COPY(SharedRing)
+
+    bool map(quint32 capacity);
+
+    QSharedMemory m_memory;
+    LogProtocol::SharedRingHeader* m_header;
+    LogProtocol::RawLogMessage* m_frames;
+    quint32 m_capacity;
+    QString m_error;
+};
+
+#endif // SHAREDRING_H
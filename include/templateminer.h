@@ -0,0 +1,43 @@
+#ifndef TEMPLATEMINER_H
+#define TEMPLATEMINER_H
+
+#include <QHash>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+// Incremental Drain-style log template miner. Messages are split on white
+// space and tokens containing digits are treated as variables. A message is
+// matched against the templates sharing its token count and leading tokens,
+// and the best match above the similarity threshold is generalised with a
+// wildcard wherever the two differ; otherwise a new template is started.
+class TemplateMiner
+{
+public:
+    static const QString WILDCARD;
+
+    TemplateMiner(double similarity = 0.4, int prefixDepth = 2);
+
+    int add(const QString& message, bool* changed = nullptr);
+    int size() const;
+    QString text(int id) const;
+    void clear();
+private:
+    struct Cluster
+    {
+        QVector<QString> tokens;
+        int wildcards;
+    };
+
+    void tokenize(const QString& message);
+    QString leafKey() const;
+    double similarity(const Cluster& cluster, int& wildcards) const;
+
+    double m_similarity;
+    int m_prefixDepth;
+    QVector<Cluster> m_clusters;
+    QHash<QString, QVector<int>> m_leaves;
+    QVector<QStringView> m_tokens;
+};
+
+#endif // TEMPLATEMINER_H
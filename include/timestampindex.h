@@ -0,0 +1,42 @@
+#ifndef TIMESTAMPINDEX_H
+#define TIMESTAMPINDEX_H
+
+#include "logmessage.h"
+#include <QVector>
+
+// Timestamp column of an AbstractLogModel split into a small number of runs
+// with non-decreasing timestamps. Rows from clients with skewed clocks end up
+// in separate runs, and every run can be binary searched on its own. Of the
+// rows fitting none of the runs once there are too many, only those that can
+// be the first row at or after, or the last row up to, a timestamp are kept,
+// each kind in a list ascending in both row and timestamp, so they are
+// binary searched too.
+class TimestampIndex
+{
+public:
+    TimestampIndex(const QVector<LogMessage*>& messages);
+
+    void clear();
+    void rebuild();
+    void append(int row);
+    int size() const;
+    bool isSynchronized() const;
+    int generation() const;
+
+    qint64 timestamp(int row) const;
+    int lowerBound(qint64 timestamp) const;
+    int upperBound(qint64 timestamp) const;
+private:
+    static const int MAX_RUNS = 32;
+
+    typedef QVector<int> Run;
+
+    const QVector<LogMessage*>& m_messages;
+    QVector<qint64> m_timestamps;
+    QVector<Run> m_runs;
+    Run m_unorderedFirst;
+    Run m_unorderedLast;
+    int m_generation;
+};
+
+#endif // TIMESTAMPINDEX_H
@@ -1,6 +1,8 @@
 #include "abstractlogmodel.h"
+#include "profiler.h"
 #include <QPixmap>
 #include <QTextStream>
+#include <algorithm>
 
 
 AbstractLogModel::AbstractLogModel(QObject* parent)
@@ -9,8 +11,21 @@ AbstractLogModel::AbstractLogModel(QObject* parent)
       m_splitByPids(false),
       m_timestampPrecision(PRECISION_MINUTES),
       m_colorBackground(COLOR_NONE),
-      m_colorTheme(THEME_LIGHT)
+      m_colorTheme(THEME_LIGHT),
+      m_foldRepeats(false),
+      m_foldedFirst(-1),
+      m_foldedLast(-1),
+      m_summary(m_messages),
+      m_timestampIndex(m_messages),
+      m_patterns(new LogPatterns(this))
 {
+    connect(m_patterns, &LogPatterns::rowsAssigned, this, [this](int first, int last)
+    {
+        if (m_patterns->isWatched())
+        {
+            dataChanged(index(first, 0), index(last, columnCount() - 1));
+        }
+    });
     m_logTypes.resize(SEVERITY_COUNT);
     m_logTypes[SEVERITY_INFO] = QPixmap(":/default/info");
     m_logTypes[SEVERITY_NOTICE] = QPixmap(":/default/notice");
@@ -23,6 +38,21 @@ const LogMessage *AbstractLogModel::message(int index) const
     return index >= 0 && index < m_messages.size() ? m_messages[index] : nullptr;
 }
 
+const LogSummaryTree &AbstractLogModel::summary() const
+{
+    return m_summary;
+}
+
+const TimestampIndex &AbstractLogModel::timestampIndex() const
+{
+    return m_timestampIndex;
+}
+
+LogPatterns *AbstractLogModel::patterns() const
+{
+    return m_patterns;
+}
+
 void AbstractLogModel::setBreakLines(bool breakLines)
 {
     if (m_breakLines == breakLines)
@@ -30,6 +60,7 @@ void AbstractLogModel::setBreakLines(bool breakLines)
         return;
     }
     m_breakLines = breakLines;
+    m_lastRows.clear();
     if (m_breakLines)
     {
         explodeMessages();
@@ -38,6 +69,8 @@ void AbstractLogModel::setBreakLines(bool breakLines)
     {
         collapseMessages();
     }
+    m_summary.rebuild();
+    m_timestampIndex.rebuild();
 }
 
 void AbstractLogModel::setColorBackground(LogColorBackground colorBackground)
@@ -80,6 +113,60 @@ bool AbstractLogModel::splitByPid() const
     return m_splitByPids;
 }
 
+void AbstractLogModel::setFoldRepeats(bool foldRepeats)
+{
+    m_foldRepeats = foldRepeats;
+    m_lastRows.clear();
+}
+
+bool AbstractLogModel::foldRepeats() const
+{
+    return m_foldRepeats;
+}
+
+void AbstractLogModel::expandRepeats(int row)
+{
+    if (row < 0 || row >= m_messages.size() || m_messages[row]->repeatCount <= 1)
+    {
+        return;
+    }
+    auto message = m_messages[row];
+    int span = 1;
+    while (row + span < m_messages.size() && m_messages[row + span]->isMultilineContinuation)
+    {
+        ++span;
+    }
+    int copies = int(message->repeatCount) - 1;
+    // Only the first and last timestamps are known, the copies in between
+    // get the first one.
+    QVector<LogMessage*> inserted;
+    inserted.reserve(copies * span);
+    for (int i = 0; i < copies; ++i)
+    {
+        auto timestamp = i == copies - 1 ? message->lastTimestamp : message->timestamp;
+        for (int j = 0; j < span; ++j)
+        {
+            auto copy = new LogMessage(*m_messages[row + j]);
+            copy->timestamp = timestamp;
+            copy->repeatCount = 1;
+            copy->lastTimestamp = QDateTime();
+            inserted.append(copy);
+        }
+    }
+    message->repeatCount = 1;
+    message->lastTimestamp = QDateTime();
+    dataChanged(index(row, 0), index(row, columnCount() - 1));
+
+    beginInsertRows(QModelIndex(), row + span, row + span + inserted.size() - 1);
+    m_messages.insert(row + span, inserted.size(), nullptr);
+    std::copy(inserted.begin(), inserted.end(), m_messages.begin() + row + span);
+    endInsertRows();
+
+    m_lastRows.clear();
+    m_summary.rebuild();
+    m_timestampIndex.rebuild();
+}
+
 void AbstractLogModel::saveAsText(QIODevice* output)
 {
     QTextStream s(output);
@@ -115,6 +202,12 @@ void AbstractLogModel::saveAsText(QIODevice* output)
             s << "\t";
             s << data(index(i, j)).toString();
         }
+        if (msg->repeatCount > 1)
+        {
+            s << "\t" << QString("repeated %1 times until %2")
+                 .arg(msg->repeatCount)
+                 .arg(msg->lastTimestamp.toString("yyyy-MM-dd HH:mm:ss.zzz"));
+        }
         s << Qt::endl;
     }
 }
@@ -135,11 +228,39 @@ int AbstractLogModel::columnCount(const QModelIndex &) const
 
 QVariant AbstractLogModel::data(const QModelIndex & index, int role) const
 {
-    if ((role != Qt::DisplayRole && role != Qt::BackgroundRole) || index.row() >= m_messages.size())
+    Profiler::Scope scope(Profiler::SECTION_DATA);
+    if ((role != Qt::DisplayRole && role != Qt::BackgroundRole && role != Qt::ToolTipRole) || index.row() >= m_messages.size())
     {
         return QVariant();
     }
     auto& message = *m_messages[index.row()];
+    if (role == Qt::ToolTipRole)
+    {
+        QStringList lines;
+        if (message.repeatCount > 1)
+        {
+            lines << QString("Repeated %1 times\nFirst %2\nLast %3")
+                    .arg(message.repeatCount)
+                    .arg(message.timestamp.toString("yyyy-MM-dd HH:mm:ss.zzz"))
+                    .arg(message.lastTimestamp.toString("yyyy-MM-dd HH:mm:ss.zzz"));
+        }
+        if (message.clockOffset)
+        {
+            lines << QString("Sent at %1 by the client's clock, corrected by %2 ms")
+                    .arg(message.timestamp.addMSecs(-message.clockOffset).toString("yyyy-MM-dd HH:mm:ss.zzz"))
+                    .arg(message.clockOffset);
+        }
+        if (lines.isEmpty())
+        {
+            return QVariant();
+        }
+        return lines.join("\n");
+    }
+    auto text = message.message;
+    if (message.repeatCount > 1)
+    {
+        text += QString("  [%1 times]").arg(message.repeatCount);
+    }
     if (role == Qt::BackgroundRole)
     {
         if (m_colorBackground == COLOR_NONE)
@@ -201,12 +322,12 @@ QVariant AbstractLogModel::data(const QModelIndex & index, int role) const
             auto pidIndex = index.column() - 6;
             if (pidIndex < m_pids.size())
             {
-                return m_pids[pidIndex] == message.pid ? message.message : "";
+                return m_pids[pidIndex] == message.pid ? text : "";
             }
         }
         else
         {
-            return message.message;
+            return text;
         }
         return QVariant();
     }
@@ -265,8 +386,17 @@ QVariant AbstractLogModel::headerData(int section, Qt::Orientation orientation,
     return QAbstractTableModel::headerData(section, orientation, role);
 }
 
-void AbstractLogModel::addMessage(LogMessage* message)
+bool AbstractLogModel::addMessage(LogMessage* message)
 {
+    Profiler::Scope scope(Profiler::SECTION_ADD_MESSAGE);
+    if (m_foldRepeats)
+    {
+        if (foldRepeat(message))
+        {
+            return false;
+        }
+        m_lastRows[qMakePair(message->machineName, message->pid)] = m_messages.size();
+    }
     bool isMultiline = message->message.contains('\n');
     message->isMultilineContinuation = false;
     message->originalMessage = message->message;
@@ -294,6 +424,11 @@ void AbstractLogModel::addMessage(LogMessage* message)
     {
         m_messages.append(message);
     }
+    for (int i = m_summary.size(); i < m_messages.size(); ++i)
+    {
+        m_summary.append(i);
+        m_timestampIndex.append(i);
+    }
     if (!m_pids.contains(message->pid))
     {
         m_pids.append(message->pid);
@@ -303,6 +438,61 @@ void AbstractLogModel::addMessage(LogMessage* message)
             endInsertColumns();
         }
     }
+    return true;
+}
+
+bool AbstractLogModel::foldRepeat(LogMessage* message)
+{
+    auto last = m_lastRows.constFind(qMakePair(message->machineName, message->pid));
+    if (last == m_lastRows.constEnd() || *last >= m_messages.size())
+    {
+        return false;
+    }
+    int row = *last;
+    auto previous = m_messages[row];
+    if (previous->severity != message->severity || previous->module != message->module ||
+            previous->channel != message->channel || previous->executablePath != message->executablePath ||
+            previous->originalMessage != message->message)
+    {
+        return false;
+    }
+    previous->repeatCount += message->repeatCount;
+    previous->lastTimestamp = message->repeatCount > 1 ? message->lastTimestamp : message->timestamp;
+    delete message;
+
+    m_foldedFirst = m_foldedFirst < 0 ? row : std::min(m_foldedFirst, row);
+    m_foldedLast = std::max(m_foldedLast, row);
+    return true;
+}
+
+void AbstractLogModel::emitFoldedRows()
+{
+    if (m_foldedFirst < 0)
+    {
+        return;
+    }
+    // Rows may have moved since, clamp to what is still there.
+    auto last = std::min(m_foldedLast, int(m_messages.size()) - 1);
+    if (m_foldedFirst <= last)
+    {
+        dataChanged(index(m_foldedFirst, 0), index(last, columnCount() - 1));
+    }
+    m_foldedFirst = -1;
+    m_foldedLast = -1;
+}
+
+void AbstractLogModel::deleteMessages()
+{
+    for (int i = 0; i < m_messages.size(); ++i)
+    {
+        delete m_messages[i];
+    }
+    m_messages.clear();
+    m_lastRows.clear();
+    m_foldedFirst = -1;
+    m_foldedLast = -1;
+    m_summary.clear();
+    m_timestampIndex.clear();
 }
 
 void AbstractLogModel::refreshColorBackgroundTheme()
@@ -0,0 +1,179 @@
+#include "clientspanel.h"
+#include "logmodel.h"
+#include <QBoxLayout>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QIODevice>
+
+namespace
+{
+
+enum Column
+{
+    COLUMN_PID,
+    COLUMN_EXECUTABLE,
+    COLUMN_MACHINE,
+    COLUMN_MESSAGE_RATE,
+    COLUMN_BYTE_RATE,
+    COLUMN_BACKLOG,
+    COLUMN_REASSEMBLY,
+    COLUMN_STATE,
+
+    COLUMN_COUNT,
+};
+
+}
+
+ClientsPanel::ClientsPanel(LogModel *model, QWidget *parent)
+    :QWidget(parent),
+      m_model(model)
+{
+    auto layout = new QBoxLayout(QBoxLayout::TopToBottom);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    m_table = new QTableWidget(0, COLUMN_COUNT, this);
+    m_table->setHorizontalHeaderLabels(QStringList() << "PID" << "Executable" << "Machine" << "Messages/s" << "Bytes/s"
+                                       << "Backlog" << "Reassembly" << "State");
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_table->verticalHeader()->hide();
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_table->horizontalHeader()->setSectionResizeMode(COLUMN_EXECUTABLE, QHeaderView::Stretch);
+    connect(m_table, &QTableWidget::itemSelectionChanged, this, &ClientsPanel::updateButtons);
+    layout->addWidget(m_table);
+
+    auto buttons = new QBoxLayout(QBoxLayout::LeftToRight);
+    buttons->addStretch();
+    m_disconnect = new QPushButton("Disconnect", this);
+    connect(m_disconnect, &QPushButton::clicked, this, &ClientsPanel::disconnectSelected);
+    buttons->addWidget(m_disconnect);
+    layout->addLayout(buttons);
+
+    setLayout(layout);
+    updateButtons();
+
+    connect(&m_updateTimer, &QTimer::timeout, this, &ClientsPanel::updateClients);
+}
+
+QString ClientsPanel::formatBytes(double bytes)
+{
+    if (bytes < 1024)
+    {
+        return QString("%1 B").arg(bytes, 0, 'f', 0);
+    }
+    if (bytes < 1024 * 1024)
+    {
+        return QString("%1 KB").arg(bytes / 1024, 0, 'f', 1);
+    }
+    return QString("%1 MB").arg(bytes / (1024 * 1024), 0, 'f', 1);
+}
+
+void ClientsPanel::showEvent(QShowEvent *event)
+{
+    m_updateTimer.start(1000);
+    updateClients();
+    QWidget::showEvent(event);
+}
+
+void ClientsPanel::hideEvent(QHideEvent *event)
+{
+    m_updateTimer.stop();
+    QWidget::hideEvent(event);
+}
+
+void ClientsPanel::updateClients()
+{
+    QIODevice* selected = nullptr;
+    if (auto item = m_table->item(m_table->currentRow(), COLUMN_PID))
+    {
+        selected = reinterpret_cast<QIODevice*>(item->data(Qt::UserRole).toULongLong());
+    }
+    m_table->clearSelection();
+
+    auto& clients = m_model->clients();
+    m_table->setRowCount(clients.size());
+    int row = 0;
+    for (auto it = clients.begin(); it != clients.end(); ++it, ++row)
+    {
+        auto metrics = m_model->clientMetrics(*it);
+        QStringList state;
+        if (metrics.localSocket)
+        {
+            state << "Local socket";
+        }
+        if (metrics.sharedMemory)
+        {
+            state << "Shared memory";
+        }
+        if (metrics.relay)
+        {
+            state << "Relay";
+        }
+        auto relay = it->relay();
+        if (relay.socket())
+        {
+            state << QString("Via %1 [%2]").arg(relay.machine()).arg(relay.pid());
+        }
+        if (metrics.datagram)
+        {
+            state << QString("UDP, %1 datagrams lost").arg(metrics.lostDatagrams);
+        }
+        if (metrics.clockOffset)
+        {
+            state << QString("Clock %1 ms %2%3").arg(qAbs(metrics.clockOffset))
+                     .arg(metrics.clockOffset > 0 ? "behind" : "ahead")
+                     .arg(metrics.clockSynchronized ? ", synchronized" : "");
+        }
+        if (metrics.throttled)
+        {
+            state << "Throttled";
+        }
+        QString texts[COLUMN_COUNT] = {
+            QString::number(it->pid()),
+            it->path(),
+            it->machine(),
+            QString::number(metrics.messagesPerSecond, 'f', 0),
+            formatBytes(metrics.bytesPerSecond),
+            formatBytes(double(metrics.backlog)),
+            formatBytes(double(metrics.reassemblyBytes)),
+            state.join(", "),
+        };
+        for (int column = 0; column < COLUMN_COUNT; ++column)
+        {
+            auto item = m_table->item(row, column);
+            if (!item)
+            {
+                item = new QTableWidgetItem;
+                if (column >= COLUMN_MESSAGE_RATE && column <= COLUMN_REASSEMBLY)
+                {
+                    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                }
+                m_table->setItem(row, column, item);
+            }
+            item->setText(texts[column]);
+        }
+        m_table->item(row, COLUMN_PID)->setData(Qt::UserRole, quint64(it->socket()));
+        if (it->socket() == selected)
+        {
+            m_table->selectRow(row);
+        }
+    }
+    updateButtons();
+}
+
+void ClientsPanel::updateButtons()
+{
+    m_disconnect->setEnabled(!m_table->selectionModel()->selectedRows().isEmpty());
+}
+
+void ClientsPanel::disconnectSelected()
+{
+    auto rows = m_table->selectionModel()->selectedRows(COLUMN_PID);
+    for (auto it = rows.begin(); it != rows.end(); ++it)
+    {
+        auto socket = reinterpret_cast<QIODevice*>(it->data(Qt::UserRole).toULongLong());
+        m_model->disconnect(LogModel::Client(socket));
+    }
+    updateClients();
+}
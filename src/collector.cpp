@@ -0,0 +1,168 @@
+#include "collector.h"
+#include "logstorage.h"
+#include <QDebug>
+#include <QDir>
+
+namespace
+{
+
+// How soon a segment that could not be written is tried again without a
+// segment interval.
+const int RETRY_INTERVAL = 60000;
+
+}
+
+Collector::Collector(QObject* parent)
+    :QObject(parent),
+      m_outputDirectory(QDir::currentPath()),
+      m_maxMessages(100000),
+      m_writeFailed(false),
+      m_droppedMessages(0)
+{
+    connect(&m_server, &LogServer::clientConnected, this, &Collector::clientConnected);
+    connect(&m_server, &LogServer::clientDisconnected, this, &Collector::clientDisconnected);
+    // The relay reads the messages before they are stored and deleted.
+    connect(&m_server, &LogServer::messagesReceived, &m_relay, &LogRelay::forward);
+    connect(&m_server, &LogServer::messagesReceived, this, &Collector::addMessages);
+    connect(&m_segmentTimer, &QTimer::timeout, this, &Collector::flush);
+    m_retryTimer.setSingleShot(true);
+    connect(&m_retryTimer, &QTimer::timeout, this, &Collector::flush);
+}
+
+Collector::~Collector()
+{
+    flush();
+    qDeleteAll(m_messages);
+}
+
+bool Collector::listen(quint16 port)
+{
+    return m_server.listen(port);
+}
+
+void Collector::setOutputDirectory(const QString& outputDirectory)
+{
+    m_outputDirectory = outputDirectory;
+}
+
+QString Collector::outputDirectory() const
+{
+    return m_outputDirectory;
+}
+
+void Collector::setMaxMessages(int maxMessages)
+{
+    m_maxMessages = maxMessages;
+    if (m_messages.size() >= m_maxMessages && !m_writeFailed)
+    {
+        flush();
+    }
+}
+
+int Collector::maxMessages() const
+{
+    return m_maxMessages;
+}
+
+void Collector::setSegmentInterval(int seconds)
+{
+    if (seconds > 0)
+    {
+        m_segmentTimer.start(seconds * 1000);
+    }
+    else
+    {
+        m_segmentTimer.stop();
+        if (m_writeFailed)
+        {
+            m_retryTimer.start(RETRY_INTERVAL);
+        }
+    }
+}
+
+int Collector::segmentInterval() const
+{
+    return m_segmentTimer.isActive() ? m_segmentTimer.interval() / 1000 : 0;
+}
+
+void Collector::setClientRateLimit(int messagesPerSecond)
+{
+    m_server.setClientRateLimit(messagesPerSecond);
+}
+
+int Collector::clientRateLimit() const
+{
+    return m_server.clientRateLimit();
+}
+
+bool Collector::setDatagramsEnabled(bool enabled)
+{
+    return m_server.setDatagramsEnabled(enabled);
+}
+
+bool Collector::setUpstream(const QString& address)
+{
+    return m_relay.setUpstream(address);
+}
+
+bool Collector::flush()
+{
+    if (m_messages.isEmpty())
+    {
+        return true;
+    }
+    if (!QDir(m_outputDirectory).exists())
+    {
+        QDir().mkpath(m_outputDirectory);
+    }
+    auto fileName = LogStorage::autoSaveFileName(m_outputDirectory);
+    if (!LogStorage::save(m_messages, fileName))
+    {
+        qWarning() << "Failed to write" << fileName;
+        m_writeFailed = true;
+        if (!m_segmentTimer.isActive())
+        {
+            m_retryTimer.start(RETRY_INTERVAL);
+        }
+        return false;
+    }
+    qInfo() << "Wrote" << m_messages.size() << "messages to" << fileName;
+    if (m_droppedMessages)
+    {
+        qWarning() << "Dropped" << m_droppedMessages << "messages while segments could not be written";
+        m_droppedMessages = 0;
+    }
+    m_writeFailed = false;
+    m_retryTimer.stop();
+    qDeleteAll(m_messages);
+    m_messages.clear();
+    return true;
+}
+
+void Collector::clientConnected()
+{
+    qInfo() << "Client connected," << m_server.clients().size() << "connected";
+}
+
+void Collector::clientDisconnected()
+{
+    qInfo() << "Client disconnected," << m_server.clients().size() << "connected";
+}
+
+void Collector::addMessages(const QVector<LogMessage*>& messages)
+{
+    for (auto it = messages.begin(); it != messages.end(); ++it)
+    {
+        if (m_writeFailed && m_messages.size() >= m_maxMessages)
+        {
+            delete *it;
+            ++m_droppedMessages;
+            continue;
+        }
+        m_messages.append(*it);
+    }
+    if (m_messages.size() >= m_maxMessages && !m_writeFailed)
+    {
+        flush();
+    }
+}
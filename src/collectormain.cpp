@@ -0,0 +1,105 @@
+#include "collector.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QTimer>
+#include <csignal>
+
+namespace
+{
+
+volatile std::sig_atomic_t s_quitRequested = 0;
+
+void requestQuit(int)
+{
+    s_quitRequested = 1;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    a.setOrganizationName("CCP");
+    a.setOrganizationDomain("ccpgames.com");
+    a.setApplicationName("loglite-collector");
+    a.setApplicationVersion(APP_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless LogLite collector writing received messages to .lsw files");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Directory for the .lsw segments.", "directory", ".");
+    QCommandLineOption portOption(QStringList() << "p" << "port", "Port to listen on.", "port", QString::number(LogServer::DEFAULT_PORT));
+    QCommandLineOption maxMessagesOption(QStringList() << "m" << "max-messages", "Messages per segment.", "count", "100000");
+    QCommandLineOption intervalOption(QStringList() << "i" << "segment-interval", "Seconds before a segment is written, 0 to disable.", "seconds", "3600");
+    QCommandLineOption rateLimitOption(QStringList() << "r" << "client-rate-limit", "Messages per second before a client is throttled, 0 to disable.", "count", "0");
+    parser.addOption(outputOption);
+    parser.addOption(portOption);
+    parser.addOption(maxMessagesOption);
+    parser.addOption(intervalOption);
+    QCommandLineOption datagramsOption(QStringList() << "u" << "udp", "Also accept datagrams on the UDP port.");
+    QCommandLineOption relayOption("relay", "Forward all messages to another LogLite or collector.", "host[:port]");
+    parser.addOption(rateLimitOption);
+    parser.addOption(datagramsOption);
+    parser.addOption(relayOption);
+    parser.process(a);
+
+    bool ok = false;
+    auto port = parser.value(portOption).toUShort(&ok);
+    if (!ok)
+    {
+        qCritical() << "Invalid port" << parser.value(portOption);
+        return 1;
+    }
+    auto maxMessages = parser.value(maxMessagesOption).toInt(&ok);
+    if (!ok || maxMessages <= 0)
+    {
+        qCritical() << "Invalid message count" << parser.value(maxMessagesOption);
+        return 1;
+    }
+    auto interval = parser.value(intervalOption).toInt(&ok);
+    if (!ok || interval < 0)
+    {
+        qCritical() << "Invalid segment interval" << parser.value(intervalOption);
+        return 1;
+    }
+
+    auto rateLimit = parser.value(rateLimitOption).toInt(&ok);
+    if (!ok || rateLimit < 0)
+    {
+        qCritical() << "Invalid client rate limit" << parser.value(rateLimitOption);
+        return 1;
+    }
+
+    Collector collector;
+    collector.setOutputDirectory(parser.value(outputOption));
+    collector.setMaxMessages(maxMessages);
+    collector.setSegmentInterval(interval);
+    collector.setClientRateLimit(rateLimit);
+    collector.setDatagramsEnabled(parser.isSet(datagramsOption));
+    if (!collector.setUpstream(parser.value(relayOption)))
+    {
+        qCritical() << "Invalid relay upstream" << parser.value(relayOption);
+        return 1;
+    }
+    if (!collector.listen(port))
+    {
+        return 1;
+    }
+
+    std::signal(SIGINT, requestQuit);
+    std::signal(SIGTERM, requestQuit);
+    QTimer quitTimer;
+    QObject::connect(&quitTimer, &QTimer::timeout, &a, [&]()
+    {
+        if (s_quitRequested)
+        {
+            QCoreApplication::quit();
+        }
+    });
+    quitTimer.start(250);
+    QObject::connect(&a, &QCoreApplication::aboutToQuit, &collector, &Collector::flush);
+
+    return a.exec();
+}
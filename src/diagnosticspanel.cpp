@@ -0,0 +1,138 @@
+#include "diagnosticspanel.h"
+#include <QBoxLayout>
+#include <QFileDialog>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QSettings>
+#include <QTableWidget>
+#include <algorithm>
+
+namespace
+{
+
+enum Column
+{
+    COLUMN_RATE,
+    COLUMN_CALLS,
+    COLUMN_MEAN,
+    COLUMN_P50,
+    COLUMN_P99,
+    COLUMN_MAX,
+
+    COLUMN_COUNT,
+};
+
+QString formatDuration(double nanoseconds)
+{
+    if (nanoseconds < 1000)
+    {
+        return QString("%1 ns").arg(nanoseconds, 0, 'f', 0);
+    }
+    if (nanoseconds < 1000000)
+    {
+        return QString("%1 us").arg(nanoseconds / 1000, 0, 'f', 1);
+    }
+    return QString("%1 ms").arg(nanoseconds / 1000000, 0, 'f', 2);
+}
+
+}
+
+DiagnosticsPanel::DiagnosticsPanel(QWidget *parent)
+    :QWidget(parent)
+{
+    auto layout = new QBoxLayout(QBoxLayout::TopToBottom);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    m_table = new QTableWidget(Profiler::SECTION_COUNT, COLUMN_COUNT, this);
+    m_table->setHorizontalHeaderLabels(QStringList() << "Calls/s" << "Calls" << "Mean" << "p50" << "p99" << "Max");
+    QStringList sections;
+    for (int i = 0; i < Profiler::SECTION_COUNT; ++i)
+    {
+        sections << Profiler::sectionName(Profiler::Section(i));
+        for (int j = 0; j < COLUMN_COUNT; ++j)
+        {
+            auto item = new QTableWidgetItem;
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_table->setItem(i, j, item);
+        }
+    }
+    m_table->setVerticalHeaderLabels(sections);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    layout->addWidget(m_table);
+
+    auto buttons = new QBoxLayout(QBoxLayout::LeftToRight);
+    buttons->addStretch();
+    auto reset = new QPushButton("Reset", this);
+    connect(reset, &QPushButton::clicked, this, &DiagnosticsPanel::resetCounters);
+    buttons->addWidget(reset);
+    auto exportButton = new QPushButton("Export Trace...", this);
+    connect(exportButton, &QPushButton::clicked, this, &DiagnosticsPanel::exportTrace);
+    buttons->addWidget(exportButton);
+    layout->addLayout(buttons);
+
+    setLayout(layout);
+
+    for (int i = 0; i < Profiler::SECTION_COUNT; ++i)
+    {
+        m_previousCalls[i] = Profiler::instance().statistics(Profiler::Section(i)).calls;
+    }
+    connect(&m_updateTimer, &QTimer::timeout, this, &DiagnosticsPanel::updateCounters);
+}
+
+void DiagnosticsPanel::showEvent(QShowEvent *event)
+{
+    Profiler::instance().setEnabled(true);
+    m_sinceUpdate.start();
+    m_updateTimer.start(1000);
+    updateCounters();
+    QWidget::showEvent(event);
+}
+
+void DiagnosticsPanel::hideEvent(QHideEvent *event)
+{
+    m_updateTimer.stop();
+    Profiler::instance().setEnabled(false);
+    QWidget::hideEvent(event);
+}
+
+void DiagnosticsPanel::updateCounters()
+{
+    double seconds = std::max<qint64>(1, m_sinceUpdate.restart()) / 1000.0;
+    for (int i = 0; i < Profiler::SECTION_COUNT; ++i)
+    {
+        auto statistics = Profiler::instance().statistics(Profiler::Section(i));
+        auto rate = (statistics.calls - m_previousCalls[i]) / seconds;
+        m_previousCalls[i] = statistics.calls;
+        m_table->item(i, COLUMN_RATE)->setText(QString::number(rate, 'f', 0));
+        m_table->item(i, COLUMN_CALLS)->setText(QString::number(statistics.calls));
+        m_table->item(i, COLUMN_MEAN)->setText(formatDuration(statistics.meanNanoseconds()));
+        m_table->item(i, COLUMN_P50)->setText(formatDuration(statistics.percentileNanoseconds(0.5)));
+        m_table->item(i, COLUMN_P99)->setText(formatDuration(statistics.percentileNanoseconds(0.99)));
+        m_table->item(i, COLUMN_MAX)->setText(formatDuration(double(statistics.maxNanoseconds)));
+    }
+}
+
+void DiagnosticsPanel::resetCounters()
+{
+    Profiler::instance().reset();
+    updateCounters();
+}
+
+void DiagnosticsPanel::exportTrace()
+{
+    auto fileName = QFileDialog::getSaveFileName(this, "Export Trace", QSettings().value("lastDir").toString(), "Chrome trace files (*.json);;All files (*.*)");
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+    if (!Profiler::instance().exportTrace(fileName))
+    {
+        QMessageBox msg(this);
+        msg.setIcon(QMessageBox::Warning);
+        msg.setText("Could not export trace");
+        msg.setInformativeText(QString("Could not open file %1 for writing").arg(fileName));
+        msg.exec();
+    }
+}
@@ -31,10 +31,12 @@ FilterCondition::FilterCondition(QWidget *parent, const Filter::Condition& condi
     op->addItem("not equals");
     op->addItem("contains");
     op->addItem("does not contain");
-    op->addItem("less than");
-    op->addItem("less than or equals");
     op->addItem("greater than");
     op->addItem("greater than or equals");
+    op->addItem("less than");
+    op->addItem("less than or equals");
+    op->addItem("matches");
+    op->addItem("does not match");
     connect(op, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &FilterCondition::operationChanged);
     hLayout->addWidget(op);
 
@@ -55,7 +57,7 @@ FilterCondition::FilterCondition(QWidget *parent, const Filter::Condition& condi
     op->setCurrentIndex(condition.m_op);
     if (condition.m_field == LOGFIELD_SEVERITY)
     {
-        static_cast<QComboBox*>(m_value)->setCurrentIndex(condition.m_operand.toInt());
+        static_cast<QComboBox*>(m_value)->setCurrentIndex(Filter::parseSeverity(condition.m_operand));
     }
     else
     {
@@ -91,7 +93,7 @@ void FilterCondition::fieldChanged(int index)
         value->addItem("notice");
         value->addItem("warning");
         value->addItem("error");
-        value->setCurrentIndex(m_condition.m_operand.toInt());
+        value->setCurrentIndex(Filter::parseSeverity(m_condition.m_operand));
         connect(value, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &FilterCondition::severityChanged);
         auto item = layout()->replaceWidget(m_value, value);
         delete item;
@@ -101,6 +103,10 @@ void FilterCondition::fieldChanged(int index)
     else
     {
         auto value = new QLineEdit(m_condition.m_operand.toString(), this);
+        if (m_condition.m_field == LOGFIELD_TIMESTAMP)
+        {
+            value->setPlaceholderText("yyyy-MM-dd hh:mm:ss, epoch ms or -5m");
+        }
         connect(value, &QLineEdit::textChanged, this, &FilterCondition::operandChanged);
         auto item = layout()->replaceWidget(m_value, value);
         delete item;
@@ -109,6 +115,7 @@ void FilterCondition::fieldChanged(int index)
     }
     if (emitChanged)
     {
+        m_condition.prepare();
         emit changed(this);
     }
 }
@@ -118,6 +125,7 @@ void FilterCondition::operationChanged(int index)
     if (m_condition.m_op != Filter::Operator(index))
     {
         m_condition.m_op = Filter::Operator(index);
+        m_condition.prepare();
         emit changed(this);
     }
 }
@@ -127,6 +135,7 @@ void FilterCondition::severityChanged(int index)
     if (m_condition.m_operand != index)
     {
         m_condition.m_operand = index;
+        m_condition.prepare();
         emit changed(this);
     }
 }
@@ -136,6 +145,7 @@ void FilterCondition::operandChanged(QString text)
     if (m_condition.m_operand != text)
     {
         m_condition.m_operand = text;
+        m_condition.prepare();
         emit changed(this);
     }
 }
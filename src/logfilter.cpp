@@ -1,4 +1,5 @@
 #include "logfilter.h"
+#include "profiler.h"
 #include <QColor>
 #include <QStandardPaths>
 #include <QDir>
@@ -6,11 +7,29 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QRegularExpression>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+
+const char* SEVERITY_NAMES[] = {
+    "info",
+    "notice",
+    "warning",
+    "error",
+};
+
+}
 
 Filter::Condition::Condition()
     : m_field(LOGFIELD_SEVERITY),
       m_op(Filter::EQUALS),
-      m_operand(0)
+      m_operand(0),
+      m_hasNumericOperand(true),
+      m_numericOperand(0),
+      m_regexAnchored(false)
 {
 }
 
@@ -29,6 +48,7 @@ bool Filter::Condition::load(QJsonObject json)
         return false;
     }
     m_operand = QJsonValue(json["operand"]).toVariant();
+    prepare();
     return true;
 }
 
@@ -41,8 +61,82 @@ QJsonObject Filter::Condition::save() const
     return result;
 }
 
+static QString literalPrefix(const QString& pattern, bool* anchored)
+{
+    static const QString s_special = "\\.^$|?*+()[]{}";
+    QString prefix;
+    int i = 0;
+    *anchored = pattern.startsWith('^');
+    if (*anchored)
+    {
+        ++i;
+    }
+    for (; i < pattern.size(); ++i)
+    {
+        QChar c = pattern[i];
+        if (c == '\\' && i + 1 < pattern.size() && !pattern[i + 1].isLetterOrNumber())
+        {
+            c = pattern[++i];
+        }
+        else if (s_special.contains(c))
+        {
+            break;
+        }
+        prefix.append(c);
+    }
+    if (i < pattern.size() && (pattern[i] == '?' || pattern[i] == '*' || pattern[i] == '{'))
+    {
+        prefix.chop(1);
+    }
+    for (int j = 0; j < pattern.size(); ++j)
+    {
+        if (pattern[j] == '\\')
+        {
+            ++j;
+        }
+        else if (pattern[j] == '|')
+        {
+            return QString();
+        }
+    }
+    return prefix;
+}
+
+void Filter::Condition::prepare()
+{
+    m_stringOperand = m_operand.toString();
+    m_numericOperand = 0;
+    m_hasNumericOperand = false;
+    m_regex = QRegularExpression();
+    m_regexPrefix.clear();
+    m_regexAnchored = false;
+    if (m_op == MATCHES || m_op == NOT_MATCHES)
+    {
+        m_regex.setPattern(m_stringOperand);
+        m_regex.optimize();
+        if (m_regex.isValid())
+        {
+            m_regexPrefix = literalPrefix(m_stringOperand, &m_regexAnchored);
+        }
+        return;
+    }
+    switch (m_field)
+    {
+    case LOGFIELD_SEVERITY:
+        m_numericOperand = Filter::parseSeverity(m_operand, &m_hasNumericOperand);
+        break;
+    case LOGFIELD_TIMESTAMP:
+        m_numericOperand = Filter::parseTimestamp(m_stringOperand, &m_hasNumericOperand);
+        break;
+    case LOGFIELD_PID:
+        m_numericOperand = m_stringOperand.trimmed().toLongLong(&m_hasNumericOperand);
+        break;
+    default:
+        break;
+    }
+}
 
-bool Filter::Condition::evaluateOperator(Operator op, int operand0, int operand1)
+bool Filter::Condition::evaluateOperator(Operator op, qint64 operand0, qint64 operand1)
 {
     switch (op)
     {
@@ -61,7 +155,7 @@ bool Filter::Condition::evaluateOperator(Operator op, int operand0, int operand1
     case LT:
         return operand0 < operand1;
     case LTE:
-        return operand0 >= operand1;
+        return operand0 <= operand1;
     default:
         return false;
     }
@@ -86,32 +180,62 @@ bool Filter::Condition::evaluateOperator(Operator op, QString operand0, QString
     case LT:
         return operand0 < operand1;
     case LTE:
-        return operand0 >= operand1;
+        return operand0 <= operand1;
     default:
         return false;
     }
 }
 
+bool Filter::Condition::evaluateString(const QString& value) const
+{
+    if (m_op != MATCHES && m_op != NOT_MATCHES)
+    {
+        return evaluateOperator(m_op, value, m_stringOperand);
+    }
+    bool matches = false;
+    if (m_regex.isValid())
+    {
+        if (m_regexAnchored ? value.startsWith(m_regexPrefix) : value.contains(m_regexPrefix))
+        {
+            matches = m_regex.match(value).hasMatch();
+        }
+    }
+    return m_op == MATCHES ? matches : !matches;
+}
+
 bool Filter::Condition::applies(const LogMessage *message) const
 {
+    bool numeric = m_hasNumericOperand && m_op < MATCHES && m_op != CONTAINS && m_op != NOT_CONTAINS;
     switch (m_field)
     {
     case LOGFIELD_SEVERITY:
-        return evaluateOperator(m_op, message->severity, m_operand.toInt());
+        if (m_op == MATCHES || m_op == NOT_MATCHES)
+        {
+            return evaluateString(SEVERITY_NAMES[message->severity]);
+        }
+        return evaluateOperator(m_op, qint64(message->severity), m_numericOperand);
     case LOGFIELD_TIMESTAMP:
-        return evaluateOperator(m_op, message->timestamp.toString(), m_operand.toString());
+        if (numeric)
+        {
+            return evaluateOperator(m_op, message->timestamp.toMSecsSinceEpoch(), m_numericOperand);
+        }
+        return evaluateString(message->timestamp.toString());
     case LOGFIELD_PID:
-        return evaluateOperator(m_op, QString::number(message->pid), m_operand.toString());
+        if (numeric)
+        {
+            return evaluateOperator(m_op, qint64(message->pid), m_numericOperand);
+        }
+        return evaluateString(QString::number(message->pid));
     case LOGFIELD_EXE_PATH:
-        return evaluateOperator(m_op, message->executablePath, m_operand.toString());
+        return evaluateString(message->executablePath);
     case LOGFIELD_MACHINE:
-        return evaluateOperator(m_op, message->machineName, m_operand.toString());
+        return evaluateString(message->machineName);
     case LOGFIELD_MODULE:
-        return evaluateOperator(m_op, message->module, m_operand.toString());
+        return evaluateString(message->module);
     case LOGFIELD_CHANNEL:
-        return evaluateOperator(m_op, message->channel, m_operand.toString());
+        return evaluateString(message->channel);
     default:
-        return evaluateOperator(m_op, message->message, m_operand.toString());
+        return evaluateString(message->message);
     }
 }
 
@@ -130,6 +254,7 @@ bool Filter::load(QJsonObject object)
         return false;
     }
     m_name = object["name"].toString();
+    m_conditions.clear();
     auto conditions = object["conditions"].toArray();
     for (auto ic = conditions.begin(); ic != conditions.end(); ++ic)
     {
@@ -184,6 +309,54 @@ bool Filter::save(QString path) const
     return true;
 }
 
+void Filter::prepare()
+{
+    for (auto it = m_conditions.begin(); it != m_conditions.end(); ++it)
+    {
+        it->prepare();
+    }
+}
+
+bool Filter::timeBounds(qint64& from, qint64& to) const
+{
+    if (m_conditions.isEmpty() || (m_juncture == OR && m_conditions.size() > 1))
+    {
+        return false;
+    }
+    bool bounded = false;
+    for (auto it = m_conditions.begin(); it != m_conditions.end(); ++it)
+    {
+        if (it->m_field != LOGFIELD_TIMESTAMP || !it->m_hasNumericOperand)
+        {
+            continue;
+        }
+        auto value = it->m_numericOperand;
+        switch (it->m_op)
+        {
+        case EQUALS:
+            from = std::max(from, value);
+            to = std::min(to, value);
+            break;
+        case GT:
+            from = std::max(from, value + 1);
+            break;
+        case GTE:
+            from = std::max(from, value);
+            break;
+        case LT:
+            to = std::min(to, value - 1);
+            break;
+        case LTE:
+            to = std::min(to, value);
+            break;
+        default:
+            continue;
+        }
+        bounded = true;
+    }
+    return bounded;
+}
+
 bool Filter::applies(const LogMessage *message, const Conditions& conditions, BoolOperator juncture)
 {
     if (juncture == AND)
@@ -289,7 +462,9 @@ const char** Filter::operatorNames()
         "gt",
         "gte",
         "ls",
-        "lte"
+        "lte",
+        "matches",
+        "not_matches"
     };
     return s_names;
 }
@@ -337,7 +512,7 @@ QString Filter::operatorToString(Operator op)
 Filter::Operator Filter::operatorFromString(QString string, bool* ok)
 {
     auto names = operatorNames();
-    for (int i = 0; i <= LTE; ++i)
+    for (int i = 0; i <= NOT_MATCHES; ++i)
     {
         if (string == names[i])
         {
@@ -381,6 +556,113 @@ Filter::BoolOperator Filter::boolOperatorFromString(QString string, bool* ok)
     return AND;
 }
 
+QDateTime Filter::parseDateTime(QString text, QDate date)
+{
+    static const char* s_dateTimeFormats[] = {
+        "yyyy-MM-dd hh:mm:ss.zzz",
+        "yyyy-MM-dd hh:mm:ss",
+        "yyyy-MM-dd hh:mm",
+        "yyyy-MM-ddThh:mm:ss.zzz",
+        "yyyy-MM-ddThh:mm:ss",
+    };
+    static const char* s_timeFormats[] = {
+        "hh:mm:ss.zzz",
+        "hh:mm:ss",
+        "hh:mm",
+        "h:mm:ss.zzz",
+        "h:mm:ss",
+        "h:mm",
+    };
+    text = text.trimmed();
+    for (auto format : s_dateTimeFormats)
+    {
+        auto result = QDateTime::fromString(text, format);
+        if (result.isValid())
+        {
+            return result;
+        }
+    }
+    for (auto format : s_timeFormats)
+    {
+        auto time = QTime::fromString(text, format);
+        if (time.isValid())
+        {
+            return QDateTime(date.isValid() ? date : QDate::currentDate(), time);
+        }
+    }
+    return QDateTime();
+}
+
+qint64 Filter::parseTimestamp(QString text, bool* ok)
+{
+    text = text.trimmed();
+    bool parsed = false;
+    qint64 result = text.toLongLong(&parsed);
+    if (!parsed)
+    {
+        static const QRegularExpression s_relative("^([+-]?)(\\d+)\\s*(ms|s|m|min|h|d)$");
+        auto match = s_relative.match(text);
+        if (match.hasMatch())
+        {
+            auto unit = match.captured(3);
+            qint64 scale = 1;
+            if (unit == "s")
+            {
+                scale = 1000;
+            }
+            else if (unit == "m" || unit == "min")
+            {
+                scale = 60 * 1000;
+            }
+            else if (unit == "h")
+            {
+                scale = 60 * 60 * 1000;
+            }
+            else if (unit == "d")
+            {
+                scale = 24 * 60 * 60 * 1000;
+            }
+            auto offset = match.captured(2).toLongLong() * scale;
+            result = QDateTime::currentMSecsSinceEpoch() + (match.captured(1) == "+" ? offset : -offset);
+            parsed = true;
+        }
+        else
+        {
+            auto dateTime = parseDateTime(text);
+            parsed = dateTime.isValid();
+            result = parsed ? dateTime.toMSecsSinceEpoch() : 0;
+        }
+    }
+    if (ok)
+    {
+        *ok = parsed;
+    }
+    return result;
+}
+
+LogSeverity Filter::parseSeverity(QVariant value, bool* ok)
+{
+    bool parsed = false;
+    int result = value.toInt(&parsed);
+    if (!parsed)
+    {
+        auto text = value.toString().trimmed().toLower();
+        for (int i = 0; i < SEVERITY_COUNT; ++i)
+        {
+            if (text == SEVERITY_NAMES[i])
+            {
+                result = i;
+                parsed = true;
+                break;
+            }
+        }
+    }
+    if (ok)
+    {
+        *ok = parsed;
+    }
+    return parsed ? LogSeverity(result) : SEVERITY_INFO;
+}
 
 
 HighlightSet::Highlight::Highlight()
@@ -414,6 +696,7 @@ bool HighlightSet::Highlight::load(QJsonObject object)
     {
         m_background = QColor();
     }
+    m_conditions.clear();
     auto conditions = object["conditions"].toArray();
     for (auto it = conditions.begin(); it != conditions.end(); ++it)
     {
@@ -427,6 +710,14 @@ bool HighlightSet::Highlight::load(QJsonObject object)
     return true;
 }
 
+void HighlightSet::Highlight::prepare()
+{
+    for (auto it = m_conditions.begin(); it != m_conditions.end(); ++it)
+    {
+        it->prepare();
+    }
+}
+
 QJsonObject HighlightSet::Highlight::save() const
 {
     QJsonObject result;
@@ -502,6 +793,14 @@ QJsonObject HighlightSet::save() const
     return result;
 }
 
+void HighlightSet::prepare()
+{
+    for (auto it = m_highlights.begin(); it != m_highlights.end(); ++it)
+    {
+        it->prepare();
+    }
+}
+
 bool HighlightSet::save(QString path) const
 {
     QFile f(path);
@@ -587,7 +886,16 @@ LogFilter::LogFilter(QObject* parent)
     : QSortFilterProxyModel(parent),
       m_severity(0xffffffff),
       m_hasCustomFilter(false),
-      m_hasHighlight(false)
+      m_hasHighlight(false),
+      m_hasTimeBounds(false),
+      m_timeFrom(std::numeric_limits<qint64>::min()),
+      m_timeTo(std::numeric_limits<qint64>::max()),
+      m_timeBoundsIndex(nullptr),
+      m_timeBoundsGeneration(0),
+      m_timeBoundsRows(-1),
+      m_firstTimeRow(0),
+      m_lastTimeRow(-1),
+      m_templateId(-1)
 {
 
 }
@@ -605,10 +913,15 @@ void LogFilter::filterSeverity(LogSeverity severity, bool visible)
     }
     if (prevSeverity != m_severity)
     {
-        invalidateFilter();
+        refilter();
     }
 }
 
+bool LogFilter::isSeverityVisible(LogSeverity severity) const
+{
+    return ((1 << severity) & m_severity) != 0;
+}
+
 bool LogFilter::filterAcceptsRow(int sourceRow, const QModelIndex &) const
 {
     auto model = static_cast<AbstractLogModel*>(sourceModel());
@@ -625,6 +938,14 @@ bool LogFilter::filterAcceptsRow(int sourceRow, const QModelIndex &) const
     {
         return false;
     }
+    if (m_hasTimeBounds && !acceptsTimestamp(model, sourceRow, message))
+    {
+        return false;
+    }
+    if (m_templateId >= 0 && model->patterns()->templateOf(sourceRow) != m_templateId)
+    {
+        return false;
+    }
     auto filter = filterRegularExpression();
     if (!filter.pattern().isEmpty() && !message->channel.contains(filter) &&
             !message->module.contains(filter) && !message->message.contains(filter))
@@ -638,18 +959,44 @@ bool LogFilter::filterAcceptsRow(int sourceRow, const QModelIndex &) const
     return true;
 }
 
+bool LogFilter::acceptsTimestamp(const AbstractLogModel* model, int sourceRow, const LogMessage* message) const
+{
+    auto& index = model->timestampIndex();
+    if (!index.isSynchronized() || sourceRow >= index.size())
+    {
+        auto timestamp = message->timestamp.toMSecsSinceEpoch();
+        return timestamp >= m_timeFrom && timestamp <= m_timeTo;
+    }
+    if (m_timeBoundsIndex != &index || m_timeBoundsGeneration != index.generation() || m_timeBoundsRows < 0)
+    {
+        m_timeBoundsIndex = &index;
+        m_timeBoundsGeneration = index.generation();
+        m_timeBoundsRows = index.size();
+        m_firstTimeRow = index.lowerBound(m_timeFrom);
+        m_lastTimeRow = index.upperBound(m_timeTo);
+    }
+    if (sourceRow < m_timeBoundsRows && (sourceRow < m_firstTimeRow || sourceRow > m_lastTimeRow))
+    {
+        return false;
+    }
+    auto timestamp = index.timestamp(sourceRow);
+    return timestamp >= m_timeFrom && timestamp <= m_timeTo;
+}
+
 void LogFilter::setCustomFilter(const Filter* filter)
 {
     if (filter)
     {
         m_customFilter = *filter;
+        m_customFilter.prepare();
         m_hasCustomFilter = true;
     }
     else
     {
         m_hasCustomFilter = false;
     }
-    invalidateFilter();
+    updateTimeBounds();
+    refilter();
 }
 
 const Filter* LogFilter::customFilter() const
@@ -662,6 +1009,7 @@ void LogFilter::setHighlight(const HighlightSet* highlight)
     if (highlight)
     {
         m_highlight = *highlight;
+        m_highlight.prepare();
         m_hasHighlight = true;
     }
     else
@@ -676,6 +1024,70 @@ const HighlightSet* LogFilter::highlight() const
     return m_hasHighlight ? &m_highlight : nullptr;
 }
 
+void LogFilter::setTimeRange(const QDateTime& from, const QDateTime& to)
+{
+    m_timeRangeFrom = from;
+    m_timeRangeTo = to;
+    updateTimeBounds();
+    refilter();
+}
+
+void LogFilter::setTemplateFilter(int templateId)
+{
+    templateId = std::max(templateId, -1);
+    if (m_templateId == templateId)
+    {
+        return;
+    }
+    if (auto model = static_cast<AbstractLogModel*>(sourceModel()))
+    {
+        if (m_templateId < 0 || templateId < 0)
+        {
+            model->patterns()->watch(templateId >= 0);
+        }
+    }
+    m_templateId = templateId;
+    refilter();
+}
+
+int LogFilter::templateFilter() const
+{
+    return m_templateId;
+}
+
+void LogFilter::refilter()
+{
+    Profiler::Scope scope(Profiler::SECTION_FILTER_INVALIDATE);
+    invalidateFilter();
+}
+
+void LogFilter::updateTimeBounds()
+{
+    m_timeFrom = m_timeRangeFrom.isValid() ? m_timeRangeFrom.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+    m_timeTo = m_timeRangeTo.isValid() ? m_timeRangeTo.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max();
+    m_hasTimeBounds = hasTimeRange();
+    if (m_hasCustomFilter && m_customFilter.timeBounds(m_timeFrom, m_timeTo))
+    {
+        m_hasTimeBounds = true;
+    }
+    m_timeBoundsRows = -1;
+}
+
+bool LogFilter::hasTimeRange() const
+{
+    return m_timeRangeFrom.isValid() || m_timeRangeTo.isValid();
+}
+
+QDateTime LogFilter::timeRangeFrom() const
+{
+    return m_timeRangeFrom;
+}
+
+QDateTime LogFilter::timeRangeTo() const
+{
+    return m_timeRangeTo;
+}
+
 QVariant LogFilter::data(const QModelIndex& index, int role) const
 {
     if (m_hasHighlight)
@@ -1,15 +1,20 @@
 #include "logmap.h"
 #include "logfilter.h"
 #include "abstractlogmodel.h"
+#include "profiler.h"
 #include <QPainter>
 #include <QApplication>
 #include <QMouseEvent>
 #include <QTableView>
+#include <algorithm>
 
 LogMap::LogMap(QWidget *parent) : QWidget(parent),
     m_model(nullptr),
     m_buddy(nullptr),
-    m_mapValid(false)
+    m_mapValid(false),
+    m_bucketsValid(false),
+    m_bucketSize(1),
+    m_rows(0)
 {
     m_map = QPixmap(width(), height());
 }
@@ -18,15 +23,20 @@ void LogMap::setModel(LogFilter *model)
 {
     if (m_model)
     {
-        disconnect(m_model, &LogFilter::rowsInserted, this, &LogMap::invalidateMap);
-        disconnect(m_model, &LogFilter::rowsRemoved, this, &LogMap::invalidateMap);
+        disconnect(m_model, &LogFilter::rowsInserted, this, &LogMap::rowsInserted);
+        disconnect(m_model, &LogFilter::rowsRemoved, this, &LogMap::invalidateBuckets);
+        disconnect(m_model, &LogFilter::modelReset, this, &LogMap::invalidateBuckets);
+        disconnect(m_model, &LogFilter::layoutChanged, this, &LogMap::invalidateBuckets);
     }
     m_model = model;
     if (m_model)
     {
-        connect(m_model, &LogFilter::rowsInserted, this, &LogMap::invalidateMap);
-        connect(m_model, &LogFilter::rowsRemoved, this, &LogMap::invalidateMap);
+        connect(m_model, &LogFilter::rowsInserted, this, &LogMap::rowsInserted);
+        connect(m_model, &LogFilter::rowsRemoved, this, &LogMap::invalidateBuckets);
+        connect(m_model, &LogFilter::modelReset, this, &LogMap::invalidateBuckets);
+        connect(m_model, &LogFilter::layoutChanged, this, &LogMap::invalidateBuckets);
     }
+    invalidateBuckets();
 }
 
 void LogMap::setBuddyView(QTableView *buddy)
@@ -47,14 +57,106 @@ void LogMap::invalidateMap()
     update();
 }
 
+void LogMap::invalidateBuckets()
+{
+    m_bucketsValid = false;
+    invalidateMap();
+}
+
+void LogMap::rowsInserted(const QModelIndex &, int first, int last)
+{
+    if (m_bucketsValid)
+    {
+        if (first == m_rows)
+        {
+            for (int i = first; i <= last; ++i)
+            {
+                addRow(i);
+            }
+        }
+        else
+        {
+            m_bucketsValid = false;
+        }
+    }
+    invalidateMap();
+}
+
+void LogMap::addRow(int row)
+{
+    auto model = static_cast<AbstractLogModel*>(m_model->sourceModel());
+    auto message = model->message(m_model->mapToSource(m_model->index(row, 0)).row());
+    if (!message)
+    {
+        return;
+    }
+    int bucket = row / m_bucketSize;
+    while (bucket >= MAX_BUCKETS)
+    {
+        m_buckets.resize(MAX_BUCKETS);
+        for (int i = 0; i < MAX_BUCKETS / 2; ++i)
+        {
+            m_buckets[i] = std::max(m_buckets[i * 2], m_buckets[i * 2 + 1]);
+        }
+        m_buckets.resize(MAX_BUCKETS / 2);
+        m_bucketSize *= 2;
+        bucket = row / m_bucketSize;
+    }
+    if (bucket >= m_buckets.size())
+    {
+        m_buckets.resize(bucket + 1);
+    }
+    m_buckets[bucket] = std::max(m_buckets[bucket], quint8(message->severity + 1));
+    m_rows = row + 1;
+}
+
+void LogMap::rebuildBuckets()
+{
+    m_buckets.clear();
+    m_bucketSize = 1;
+    m_rows = 0;
+    m_bucketsValid = true;
+    if (!m_model)
+    {
+        return;
+    }
+    int count = m_model->rowCount();
+    auto model = static_cast<AbstractLogModel*>(m_model->sourceModel());
+    if (model && count == model->rowCount())
+    {
+        auto& summary = model->summary();
+        m_rows = summary.size();
+        while ((m_rows + m_bucketSize - 1) / m_bucketSize > MAX_BUCKETS)
+        {
+            m_bucketSize *= 2;
+        }
+        m_buckets.resize((m_rows + m_bucketSize - 1) / m_bucketSize);
+        for (int i = 0; i < m_buckets.size(); ++i)
+        {
+            auto bucket = summary.summarize(i * m_bucketSize, (i + 1) * m_bucketSize - 1);
+            m_buckets[i] = quint8(bucket.worstSeverity() + 1);
+        }
+        return;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        addRow(i);
+    }
+}
+
 void LogMap::paintMap()
 {
+    Profiler::Scope scope(Profiler::SECTION_PAINT_MAP);
     QPainter p(&m_map);
     p.fillRect(rect(), QBrush(QApplication::palette().window().color()));
     if (!m_model)
     {
         return;
     }
+    if (!m_bucketsValid)
+    {
+        rebuildBuckets();
+    }
 
     QPen warning(QBrush(Qt::yellow), 3, Qt::SolidLine);
     QPen error(QBrush(Qt::red), 3, Qt::SolidLine);
@@ -62,31 +164,32 @@ void LogMap::paintMap()
 
     auto width = rect().width() - 2;
     auto height = rect().height();
+    if (height <= 0)
+    {
+        return;
+    }
 
     int count = m_model->rowCount();
-    auto model = static_cast<AbstractLogModel*>(m_model->sourceModel());
-    int prevY = -1;
-    for (int i = 0; i < count; ++i)
+    QVector<quint8> pixels(height);
+    for (int i = 0; i < m_buckets.size(); ++i)
     {
-        auto row = m_model->mapToSource(m_model->index(i, 0)).row();
-        auto message = model->message(row);
-        if (!message)
+        if (m_buckets[i] > SEVERITY_WARN)
         {
-            continue;
+            float y = 3 + float(i * m_bucketSize) / count * (height - 6);
+            auto& pixel = pixels[std::clamp(int(y), 0, height - 1)];
+            pixel = std::max(pixel, m_buckets[i]);
         }
-        if (message->severity >= SEVERITY_WARN)
+    }
+    for (int y = 0; y < height; ++y)
+    {
+        if (pixels[y])
         {
-            float y = 3 + float(i) / count * (height - 6);
-            if (int(y) != prevY)
-            {
-                QLineF line(2, y + 1, width, y + 1);
-                p.setPen(shadow);
-                p.drawLine(line);
-                p.setPen(message->severity == SEVERITY_WARN ? warning : error);
-                line = QLineF(1, y, width - 1, y);
-                p.drawLine(line);
-                prevY = int(y);
-            }
+            QLineF line(2, y + 1, width, y + 1);
+            p.setPen(shadow);
+            p.drawLine(line);
+            p.setPen(pixels[y] == SEVERITY_WARN + 1 ? warning : error);
+            line = QLineF(1, y, width - 1, y);
+            p.drawLine(line);
         }
     }
 }
@@ -1,61 +1,15 @@
 #include "logmodel.h"
-#include <QTcpSocket>
-#include <QDateTime>
-#include <QPixmap>
-#include <QSortFilterProxyModel>
-#include <QDebug>
-#include <QFileInfo>
-#include <QDir>
-#include <QHostInfo>
 #include <QTimer>
-#include <QMessageBox>
-#include "logmonitorfilemodel.h"
+#include "logstorage.h"
+#include <algorithm>
 #include <cmath>
 
 namespace
 {
 
-const uint32_t VERSION = 2;
-
-enum MessageType
-{
-    CONNECTION_MESSAGE,
-    SIMPLE_MESSAGE,
-    LARGE_MESSAGE,
-    CONTINUATION_MESSAGE,
-    CONTINUATION_END_MESSAGE,
-};
-
-struct ConnectionMessage
-{
-    static const size_t MESSAGE_MAX_PATH = 260;
-
-    uint32_t version;
-    uint64_t pid;
-    char machineName[32];
-    char executablePath[MESSAGE_MAX_PATH];
-};
-
-struct TextMessage
-{
-    static const size_t TEXT_SIZE = 256;
-
-    uint64_t timestamp;
-    uint32_t severity;
-    char module[32];
-    char channel[32];
-    char message[TEXT_SIZE];
-};
-
-struct RawLogMessage
-{
-    uint32_t type;
-    union
-    {
-        ConnectionMessage connection;
-        TextMessage text;
-    };
-};
+// Held messages are released at a quarter of the reorder delay, but not
+// more often than this.
+const int MIN_REORDER_INTERVAL = 10;
 
 }
 
@@ -85,125 +39,123 @@ int LogModel::RunningCount::get() const
 }
 
 
-LogModel::Client::Client()
-    :m_socket(nullptr)
+LogModel::OverloadPolicy::OverloadPolicy()
+    :maxBacklog(200000),
+      maxLag(3000),
+      sampleInterval(10)
 {
 }
 
-LogModel::Client::Client(QTcpSocket* socket)
-    :m_socket(socket)
+
+LogModel::Shedding::Shedding()
+    :sampleCounter(0),
+      dropped(0)
 {
 }
 
-uint64_t LogModel::Client::pid() const
+
+LogModel::LogModel(QObject* parent, quint16 port)
+    :AbstractLogModel(parent),
+    m_maxMessages(100000),
+    m_serverMode(false),
+    m_overloaded(false),
+    m_reorderTimer(nullptr)
 {
-    if (m_socket)
-    {
-        return m_socket->property("pid").toULongLong();
-    }
-    return 0;
+    connect(&m_server, &LogServer::clientConnected, this, &LogModel::acceptConnection);
+    connect(&m_server, &LogServer::clientDisconnected, this, &LogModel::socketDisconnected);
+    // The relay reads the messages before they are shed, folded or trimmed.
+    connect(&m_server, &LogServer::messagesReceived, &m_relay, &LogRelay::forward);
+    connect(&m_server, &LogServer::messagesReceived, this, &LogModel::addMessages);
+    m_server.listen(port);
+
+    m_statistics.error = 0;
+    m_statistics.warning = 0;
+    m_statistics.notice = 0;
+    m_statistics.info = 0;
+    m_statistics.clients = 0;
+    m_statistics.dropped = 0;
+
+    QTimer* timer = new QTimer(this);
+    connect(timer, &QTimer::timeout, this, &LogModel::updateRuningCounts);
+    timer->start(500);
+
+    QTimer* markerTimer = new QTimer(this);
+    connect(markerTimer, &QTimer::timeout, this, &LogModel::flushDropMarkers);
+    markerTimer->start(1000);
+
+    m_reorderTimer = new QTimer(this);
+    connect(m_reorderTimer, &QTimer::timeout, this, &LogModel::releaseReordered);
+    m_reorderClock.start();
 }
 
-QString LogModel::Client::path() const
+LogModel::~LogModel()
 {
-    if (m_socket)
-    {
-        return m_socket->property("executablePath").toString();
-    }
-    return QString();
+
 }
 
-QString LogModel::Client::machine() const
+const LogModel::Clients& LogModel::clients() const
 {
-    if (m_socket)
-    {
-        return m_socket->property("machineName").toString();
-    }
-    return QString();
+    return m_server.clients();
 }
 
-QTcpSocket* LogModel::Client::socket() const
+bool LogModel::clientFromMessage(const LogMessage& message, Client& client)
 {
-    return m_socket;
+    return m_server.clientFromMessage(message, client);
 }
 
-bool LogModel::Client::operator==(const Client& other) const
+void LogModel::disconnect(const Client& client)
 {
-    return m_socket == other.m_socket;
+    m_server.disconnect(client);
 }
 
-
-uint qHash(const LogModel::Client& client)
+LogModel::ClientMetrics LogModel::clientMetrics(const Client& client) const
 {
-    return qHash(client.socket());
+    return m_server.metrics(client);
 }
 
-
-LogModel::LogModel(QObject* parent)
-    :AbstractLogModel(parent),
-    m_nextMessage(nullptr),
-    m_maxMessages(100000),
-    m_serverMode(false)
+void LogModel::setClientRateLimit(int messagesPerSecond)
 {
-    connect(&m_server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
-    m_listening = m_server.listen(QHostAddress::Any, 0xCC9);
-    if (m_listening)
-    {
-        qDebug() << "Server started";
-    }
-    else
-    {
-        qDebug() << "Server failed to start";
-    }
+    m_server.setClientRateLimit(messagesPerSecond);
+}
 
-    m_statistics.error = 0;
-    m_statistics.warning = 0;
-    m_statistics.notice = 0;
-    m_statistics.info = 0;
-    m_statistics.clients = 0;
+int LogModel::clientRateLimit() const
+{
+    return m_server.clientRateLimit();
+}
 
-    QTimer* timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, &LogModel::updateRuningCounts);
-    timer->start(500);
+bool LogModel::setDatagramsEnabled(bool enabled)
+{
+    return m_server.setDatagramsEnabled(enabled);
 }
 
-LogModel::~LogModel()
+bool LogModel::datagramsEnabled() const
 {
+    return m_server.datagramsEnabled();
+}
 
+void LogModel::setClockCorrection(bool enabled)
+{
+    m_server.setClockCorrection(enabled);
 }
 
-const LogModel::Clients& LogModel::clients() const
+bool LogModel::clockCorrection() const
 {
-    return m_clients;
+    return m_server.clockCorrection();
 }
 
-bool LogModel::clientFromMessage(const LogMessage& message, Client& client)
+bool LogModel::setUpstream(const QString& address)
 {
-    auto found = std::find_if(m_clients.begin(), m_clients.end(), [&](const Client& client)
-    {
-        return client.pid() == message.pid && client.machine() == message.machineName &&
-                client.path() == message.executablePath;
-    });
-    if (found == m_clients.end())
-    {
-        return false;
-    }
-    client = *found;
-    return true;
+    return m_relay.setUpstream(address);
 }
 
-void LogModel::disconnect(const Client& client)
+const LogRelay& LogModel::relay() const
 {
-    if (!client.socket())
-    {
-        return;
-    }
-    client.socket()->disconnectFromHost();
+    return m_relay;
 }
 
 bool LogModel::isListening() const
 {
-    return m_listening;
+    return m_server.isListening();
 }
 
 void LogModel::setServerMode(bool serverMode)
@@ -251,112 +203,207 @@ int LogModel::getRunningCount(LogSeverity severity)
     return m_runningCounts[severity].get();
 }
 
-void LogModel::acceptConnection()
+void LogModel::setOverloadPolicy(const OverloadPolicy& policy)
 {
-    m_statistics.clients++;
-    while (auto socket = m_server.nextPendingConnection())
+    m_overloadPolicy = policy;
+}
+
+const LogModel::OverloadPolicy& LogModel::overloadPolicy() const
+{
+    return m_overloadPolicy;
+}
+
+bool LogModel::isOverloaded() const
+{
+    return m_overloaded;
+}
+
+void LogModel::updateOverload()
+{
+    auto backlog = m_server.backlog();
+    auto lag = m_server.backlogAge();
+    bool overloaded;
+    if (m_overloaded)
+    {
+        // Leave overload mode only well below the thresholds, so the mode
+        // does not flap while the backlog hovers around them.
+        overloaded = (m_overloadPolicy.maxBacklog && backlog > m_overloadPolicy.maxBacklog / 2) ||
+                (m_overloadPolicy.maxLag && lag > m_overloadPolicy.maxLag / 2);
+    }
+    else
+    {
+        overloaded = (m_overloadPolicy.maxBacklog && backlog > m_overloadPolicy.maxBacklog) ||
+                (m_overloadPolicy.maxLag && lag > m_overloadPolicy.maxLag);
+    }
+    if (overloaded != m_overloaded)
+    {
+        m_overloaded = overloaded;
+        if (!m_overloaded)
+        {
+            appendDropMarkers();
+        }
+        emit overloadChanged(m_overloaded);
+    }
+}
+
+bool LogModel::shed(const LogMessage* message)
+{
+    if (message->severity >= SEVERITY_WARN)
+    {
+        return false;
+    }
+    auto& shedding = m_shedding[qMakePair(message->machineName, message->pid)];
+    if (m_overloadPolicy.sampleInterval > 0 && shedding.sampleCounter++ % m_overloadPolicy.sampleInterval == 0)
     {
-        socket->setProperty("receivedConnectionMessage", false);
-        connect(socket, &QTcpSocket::readyRead, this, &LogModel::readMessages);
-        connect(socket, &QTcpSocket::disconnected, this, &LogModel::socketDisconnected);
-        m_clients.insert(socket);
-        emit clientConnected();
+        return false;
+    }
+    ++shedding.dropped;
+    shedding.lastTimestamp = message->timestamp;
+    shedding.executablePath = message->executablePath;
+    m_statistics.dropped++;
+    return true;
+}
+
+void LogModel::appendDropMarkers()
+{
+    for (auto it = m_shedding.begin(); it != m_shedding.end();)
+    {
+        if (!it->dropped)
+        {
+            it = m_shedding.erase(it);
+            continue;
+        }
+        auto marker = new LogMessage;
+        marker->timestamp = it->lastTimestamp;
+        marker->pid = it.key().second;
+        marker->severity = SEVERITY_WARN;
+        marker->machineName = it.key().first;
+        marker->executablePath = it->executablePath;
+        marker->module = "LogLite";
+        marker->channel = "overload";
+        marker->message = QString("%1 messages dropped").arg(it->dropped);
+        marker->originalMessage = marker->message;
+        marker->isMultilineContinuation = false;
+        addMessage(marker);
+        it->dropped = 0;
+        ++it;
+    }
+}
+
+void LogModel::flushDropMarkers()
+{
+    int count = m_messages.size();
+    appendDropMarkers();
+    if (m_messages.size() > count)
+    {
+        beginInsertRows(QModelIndex(), count, m_messages.size() - 1);
+        endInsertRows();
     }
+    emitFoldedRows();
+}
+
+void LogModel::acceptConnection()
+{
+    m_statistics.clients++;
+    emit clientConnected();
 }
 
 void LogModel::socketDisconnected()
 {
-    m_clients.remove(static_cast<QTcpSocket*>(sender()));
     m_statistics.clients--;
     emit clientDisconnected();
 }
 
-void LogModel::readMessages()
+void LogModel::setReorderDelay(int milliseconds)
+{
+    m_reorder.setMaxDelay(milliseconds);
+    if (m_reorder.maxDelay())
+    {
+        m_reorderTimer->start(std::max(MIN_REORDER_INTERVAL, m_reorder.maxDelay() / 4));
+        return;
+    }
+    m_reorderTimer->stop();
+    QVector<LogMessage*> messages;
+    m_reorder.takeAll(messages);
+    if (!messages.isEmpty())
+    {
+        appendMessages(messages);
+    }
+}
+
+int LogModel::reorderDelay() const
+{
+    return m_reorder.maxDelay();
+}
+
+void LogModel::addMessages(const QVector<LogMessage*>& messages)
+{
+    if (!m_reorder.maxDelay())
+    {
+        appendMessages(messages);
+        return;
+    }
+    auto now = m_reorderClock.elapsed();
+    for (auto it = messages.begin(); it != messages.end(); ++it)
+    {
+        m_reorder.add(*it, now);
+    }
+    releaseReordered();
+}
+
+void LogModel::releaseReordered()
+{
+    QVector<LogMessage*> messages;
+    m_reorder.take(m_reorderClock.elapsed(), messages);
+    if (!messages.isEmpty())
+    {
+        appendMessages(messages);
+    }
+}
+
+void LogModel::appendMessages(const QVector<LogMessage*>& messages)
 {
-    auto socket = static_cast<QTcpSocket*>(sender());
-    RawLogMessage msg;
     int count = m_messages.size();
-    while (socket->bytesAvailable() >= qint64(sizeof(msg)))
+    updateOverload();
+    for (auto it = messages.begin(); it != messages.end(); ++it)
     {
-        socket->read(reinterpret_cast<char*>(&msg), sizeof(msg));
-        bool receivedConnectionMessage = socket->property("receivedConnectionMessage").toBool();
-        if ((msg.type != CONNECTION_MESSAGE) != receivedConnectionMessage )
+        auto message = *it;
+        if (m_overloaded && shed(message))
         {
-            socket->abort();
-            return;
-        }
-        if (msg.type == CONNECTION_MESSAGE)
-        {
-            if (msg.connection.version > VERSION)
-            {
-                socket->abort();
-                return;
-            }
-            socket->setProperty("version", msg.connection.version);
-            socket->setProperty("receivedConnectionMessage", true);
-            socket->setProperty("pid", quint64(msg.connection.pid));
-            socket->setProperty("machineName", QString::fromLocal8Bit(msg.connection.machineName));
-            socket->setProperty("executablePath", QString::fromLocal8Bit(msg.connection.executablePath));
+            delete message;
             continue;
         }
-
-        if (!m_nextMessage)
-        {
-            m_nextMessage = new LogMessage;
-            if (socket->property("version") == 1)
-            {
-                m_nextMessage->timestamp = QDateTime::fromSecsSinceEpoch(msg.text.timestamp);
-            }
-            else
-            {
-                m_nextMessage->timestamp.setMSecsSinceEpoch(msg.text.timestamp);
-            }
-            m_nextMessage->pid = uint64_t(socket->property("pid").toULongLong());
-            m_nextMessage->severity = LogSeverity(msg.text.severity);
-            m_nextMessage->machineName = socket->property("machineName").toString();
-            m_nextMessage->executablePath = socket->property("executablePath").toString();
-            m_nextMessage->module = QString::fromLocal8Bit(msg.text.module);
-            m_nextMessage->channel = QString::fromLocal8Bit(msg.text.channel);
-        }
-        m_receivedText.append(msg.text.message);
-
-        if (msg.type == SIMPLE_MESSAGE || msg.type == CONTINUATION_END_MESSAGE)
+        m_runningCounts[message->severity].add();
+        switch (message->severity)
         {
-            m_nextMessage->message = QString::fromUtf8(m_receivedText.constData());
-            m_receivedText.clear();
-            addMessage(m_nextMessage);
-            m_runningCounts[m_nextMessage->severity].add();
-            switch (m_nextMessage->severity)
-            {
-            case SEVERITY_ERR:
-                m_statistics.error++;
-                break;
-            case SEVERITY_WARN:
-                m_statistics.warning++;
-                break;
-            case SEVERITY_NOTICE:
-                m_statistics.notice++;
-                break;
-            case SEVERITY_INFO:
-                m_statistics.info++;
-                break;
-            default:
-                break;
-            }
-            m_nextMessage = nullptr;
+        case SEVERITY_ERR:
+            m_statistics.error++;
+            break;
+        case SEVERITY_WARN:
+            m_statistics.warning++;
+            break;
+        case SEVERITY_NOTICE:
+            m_statistics.notice++;
+            break;
+        case SEVERITY_INFO:
+            m_statistics.info++;
+            break;
+        default:
+            break;
         }
+        addMessage(message);
     }
     if (m_messages.size() > count)
     {
         beginInsertRows(QModelIndex(), count, m_messages.size() - 1);
         endInsertRows();
     }
+    emitFoldedRows();
     if (m_serverMode && m_messages.size() >= m_maxMessages)
     {
         if (autoSave())
         {
             clear();
-            count = 0;
         }
     }
 }
@@ -368,12 +415,13 @@ const LogModel::Statistics &LogModel::statistics() const
 
 bool LogModel::autoSave()
 {
-    if (!QDir(m_autoSaveDirectory).exists())
+    QVector<const LogMessage*> messages;
+    messages.reserve(m_messages.size());
+    for (auto it = m_messages.begin(); it != m_messages.end(); ++it)
     {
-        QDir().mkpath(m_autoSaveDirectory);
+        messages.append(*it);
     }
-    auto fi = QString("%1%2%3.%4.lsw").arg(m_autoSaveDirectory, QDir::separator(), QHostInfo::localHostName(), QDateTime::currentDateTime().toString("yyyy-MM-dd_HH.mm.ss"));
-    return LogMonitorFileModel::saveModel(this, fi);
+    return LogStorage::autoSave(messages, m_autoSaveDirectory);
 }
 
 void LogModel::clear()
@@ -383,26 +431,19 @@ void LogModel::clear()
         return;
     }
     beginRemoveRows(QModelIndex(), 0, m_messages.size() - 1);
-    for (int i = 0; i < m_messages.size(); ++i)
-    {
-        delete m_messages[i];
-    }
-    m_messages.clear();
+    deleteMessages();
 
     m_statistics.error = 0;
     m_statistics.warning = 0;
     m_statistics.notice = 0;
     m_statistics.info = 0;
+    m_statistics.dropped = 0;
     endRemoveRows();
 }
 
 void LogModel::disconnectAll()
 {
-    auto copy = m_clients;
-    for (auto it = copy.begin(); it != copy.end(); ++it)
-    {
-        disconnect(*it);
-    }
+    m_server.disconnectAll();
 }
 
 void LogModel::updateRuningCounts()
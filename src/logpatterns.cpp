@@ -0,0 +1,260 @@
+#include "logpatterns.h"
+#include "abstractlogmodel.h"
+#include "templateminer.h"
+#include <QSet>
+#include <algorithm>
+
+namespace
+{
+
+const int CHUNK_ROWS = 16384;
+
+}
+
+LogPatterns::Template::Template()
+    :count(0),
+      first(0),
+      last(0)
+{
+}
+
+
+LogPatterns::LogPatterns(AbstractLogModel* model)
+    :QObject(model),
+      m_model(model),
+      m_worker(nullptr),
+      m_miner(nullptr),
+      m_submitted(0),
+      m_generation(0),
+      m_watchers(0),
+      m_enabled(false)
+{
+    m_thread.setObjectName("LogPatterns");
+    m_rebuildTimer.setSingleShot(true);
+    connect(&m_rebuildTimer, &QTimer::timeout, this, &LogPatterns::rebuild);
+    connect(model, &QAbstractItemModel::rowsInserted, this, &LogPatterns::rowsInserted);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, &LogPatterns::rowsChanged);
+    connect(model, &QAbstractItemModel::modelReset, this, &LogPatterns::rowsChanged);
+}
+
+LogPatterns::~LogPatterns()
+{
+    setEnabled(false);
+}
+
+void LogPatterns::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+    {
+        return;
+    }
+    m_enabled = enabled;
+    if (m_enabled)
+    {
+        m_miner = new TemplateMiner;
+        m_worker = new QObject;
+        m_worker->moveToThread(&m_thread);
+        m_thread.start(QThread::LowPriority);
+        rebuild();
+    }
+    else
+    {
+        ++m_generation;
+        m_rebuildTimer.stop();
+        m_thread.quit();
+        m_thread.wait();
+        delete m_worker;
+        delete m_miner;
+        m_worker = nullptr;
+        m_miner = nullptr;
+        m_minedTemplates.clear();
+        m_rows.clear();
+        m_templates.clear();
+        m_submitted = 0;
+        emit templatesChanged();
+    }
+}
+
+bool LogPatterns::isEnabled() const
+{
+    return m_enabled;
+}
+
+void LogPatterns::watch(bool watch)
+{
+    m_watchers += watch ? 1 : -1;
+}
+
+bool LogPatterns::isWatched() const
+{
+    return m_watchers > 0;
+}
+
+int LogPatterns::templateOf(int row) const
+{
+    return row >= 0 && row < m_rows.size() ? m_rows[row] : -1;
+}
+
+const QVector<LogPatterns::Template>& LogPatterns::templates() const
+{
+    return m_templates;
+}
+
+int LogPatterns::pendingRows() const
+{
+    return m_submitted - m_rows.size();
+}
+
+void LogPatterns::rowsInserted(const QModelIndex&, int first, int last)
+{
+    if (!m_enabled)
+    {
+        return;
+    }
+    // Rows added while a rebuild is pending are covered by it.
+    if (first == m_submitted && !m_rebuildTimer.isActive())
+    {
+        submit(first, last);
+    }
+    else
+    {
+        scheduleRebuild();
+    }
+}
+
+void LogPatterns::rowsChanged()
+{
+    if (m_enabled)
+    {
+        scheduleRebuild();
+    }
+}
+
+void LogPatterns::scheduleRebuild()
+{
+    // Templates still being mined no longer match the rows.
+    ++m_generation;
+    m_rows.clear();
+    m_rebuildTimer.start(0);
+}
+
+void LogPatterns::rebuild()
+{
+    m_rebuildTimer.stop();
+    ++m_generation;
+    m_rows.clear();
+    m_templates.clear();
+    m_submitted = 0;
+    QMetaObject::invokeMethod(m_worker, [this]()
+    {
+        m_miner->clear();
+        m_minedTemplates.clear();
+    });
+    emit templatesChanged();
+
+    auto rows = m_model->rowCount() - 1;
+    if (rows > 0)
+    {
+        submit(0, rows - 1);
+    }
+}
+
+void LogPatterns::submit(int first, int last)
+{
+    auto generation = m_generation;
+    for (int start = first; start <= last; start += CHUNK_ROWS)
+    {
+        auto end = std::min(last, start + CHUNK_ROWS - 1);
+        QVector<Entry> entries;
+        entries.reserve(end - start + 1);
+        for (int row = start; row <= end; ++row)
+        {
+            auto message = m_model->message(row);
+            Entry entry;
+            entry.first = 0;
+            entry.last = 0;
+            entry.repeats = 0;
+            entry.continuation = !message || message->isMultilineContinuation;
+            if (!entry.continuation)
+            {
+                entry.text = message->originalMessage;
+                entry.first = message->timestamp.toMSecsSinceEpoch();
+                entry.last = message->repeatCount > 1 ? message->lastTimestamp.toMSecsSinceEpoch() : entry.first;
+                entry.repeats = message->repeatCount;
+            }
+            entries.append(entry);
+        }
+        QMetaObject::invokeMethod(m_worker, [this, generation, start, entries]()
+        {
+            mine(generation, start, entries);
+        });
+    }
+    m_submitted = last + 1;
+}
+
+void LogPatterns::mine(int generation, int first, const QVector<Entry>& entries)
+{
+    // Runs on m_thread, the only place m_miner and m_minedTemplates are used.
+    QVector<int> ids;
+    ids.reserve(entries.size());
+    QSet<int> touched;
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        if (it->continuation)
+        {
+            ids.append(-1);
+            continue;
+        }
+        bool changed = false;
+        auto id = m_miner->add(it->text, &changed);
+        if (id >= m_minedTemplates.size())
+        {
+            m_minedTemplates.resize(id + 1);
+        }
+        auto& minedTemplate = m_minedTemplates[id];
+        if (changed)
+        {
+            minedTemplate.text = m_miner->text(id);
+        }
+        minedTemplate.first = minedTemplate.count ? std::min(minedTemplate.first, it->first) : it->first;
+        minedTemplate.last = minedTemplate.count ? std::max(minedTemplate.last, it->last) : it->last;
+        minedTemplate.count += it->repeats;
+        ids.append(id);
+        touched.insert(id);
+    }
+    Changes changes;
+    changes.reserve(touched.size());
+    for (auto it = touched.begin(); it != touched.end(); ++it)
+    {
+        changes.append(qMakePair(*it, m_minedTemplates[*it]));
+    }
+    QMetaObject::invokeMethod(this, [this, generation, first, ids, changes]()
+    {
+        assign(generation, first, ids, changes);
+    }, Qt::QueuedConnection);
+}
+
+void LogPatterns::assign(int generation, int first, const QVector<int>& ids, const Changes& changes)
+{
+    if (generation != m_generation || first != m_rows.size() || ids.isEmpty())
+    {
+        return;
+    }
+    m_rows.resize(first + ids.size());
+    for (int i = 0; i < ids.size(); ++i)
+    {
+        auto row = first + i;
+        // Continuation lines belong to the template of their first line.
+        m_rows[row] = ids[i] >= 0 || row == 0 ? ids[i] : m_rows[row - 1];
+    }
+    for (auto it = changes.begin(); it != changes.end(); ++it)
+    {
+        if (it->first >= m_templates.size())
+        {
+            m_templates.resize(it->first + 1);
+        }
+        m_templates[it->first] = it->second;
+    }
+    emit rowsAssigned(first, first + ids.size() - 1);
+    emit templatesChanged();
+}
@@ -0,0 +1,308 @@
+#include "logrelay.h"
+#include "logprotocol.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QSysInfo>
+#include <QUrl>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+using namespace LogProtocol;
+
+namespace
+{
+
+const int FLUSH_INTERVAL = 20;
+// Written right away once this much has queued up.
+const int FLUSH_SIZE = 64 * 1024;
+const qint64 DEFAULT_CAPACITY = 16 * 1024 * 1024;
+const int MIN_RECONNECT_DELAY = 100;
+const int MAX_RECONNECT_DELAY = 5000;
+// Longer messages are cut so that any one fits a block with the longest
+// names.
+const int MAX_TEXT_SIZE = int(MAX_RELAY_BLOCK_SIZE - sizeof(DatagramHeader) - ConnectionMessage::MESSAGE_MAX_PATH - sizeof(DatagramRecord)) - 3 * 0xFF;
+
+// Cut to what the size field holds, on a character boundary.
+QByteArray utf8(const QString& text, int maxSize)
+{
+    auto bytes = text.toUtf8();
+    if (bytes.size() > maxSize)
+    {
+        auto size = maxSize;
+        while (size > 0 && (uchar(bytes[size]) & 0xC0) == 0x80)
+        {
+            --size;
+        }
+        bytes.truncate(size);
+    }
+    return bytes;
+}
+
+void appendRaw(QByteArray& buffer, const void* data, size_t size)
+{
+    buffer.append(static_cast<const char*>(data), qsizetype(size));
+}
+
+}
+
+
+LogRelay::LogRelay(QObject* parent)
+    :QObject(parent),
+      m_port(DEFAULT_PORT),
+      m_reconnectDelay(MIN_RECONNECT_DELAY),
+      m_capacity(DEFAULT_CAPACITY),
+      m_blockStart(-1),
+      m_blockRecords(0),
+      m_blockPid(0),
+      m_blockClockOffset(0),
+      m_dropped(0),
+      m_reportedDrops(0)
+{
+    connect(&m_socket, &QTcpSocket::connected, this, &LogRelay::connected);
+    connect(&m_socket, &QTcpSocket::errorOccurred, this, &LogRelay::socketError);
+    connect(&m_flushTimer, &QTimer::timeout, this, &LogRelay::flush);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, &LogRelay::reconnectNow);
+    m_flushTimer.setSingleShot(true);
+    m_reconnectTimer.setSingleShot(true);
+}
+
+bool LogRelay::setUpstream(const QString& address)
+{
+    QString host;
+    quint16 port = DEFAULT_PORT;
+    if (!address.isEmpty())
+    {
+        QUrl url("tcp://" + address);
+        if (!url.isValid() || url.host().isEmpty() || !url.path().isEmpty())
+        {
+            qDebug() << "Invalid relay upstream" << address;
+            return false;
+        }
+        host = url.host();
+        port = quint16(url.port(DEFAULT_PORT));
+    }
+    if (host == m_host && port == m_port)
+    {
+        return true;
+    }
+
+    m_host = host;
+    m_port = port;
+    m_reconnectTimer.stop();
+    m_reconnectDelay = MIN_RECONNECT_DELAY;
+    m_socket.abort();
+    if (m_host.isEmpty())
+    {
+        m_flushTimer.stop();
+        m_pending.clear();
+        m_blockStart = -1;
+        return true;
+    }
+    reconnectNow();
+    return true;
+}
+
+QString LogRelay::upstream() const
+{
+    return m_host.isEmpty() ? QString() : QString("%1:%2").arg(m_host).arg(m_port);
+}
+
+bool LogRelay::isConnected() const
+{
+    return m_socket.state() == QAbstractSocket::ConnectedState;
+}
+
+void LogRelay::setCapacity(qint64 bytes)
+{
+    m_capacity = std::max<qint64>(bytes, 0);
+}
+
+qint64 LogRelay::capacity() const
+{
+    return m_capacity;
+}
+
+quint64 LogRelay::dropped() const
+{
+    return m_dropped;
+}
+
+void LogRelay::forward(const QVector<LogMessage*>& messages)
+{
+    if (m_host.isEmpty())
+    {
+        return;
+    }
+    for (auto it = messages.begin(); it != messages.end(); ++it)
+    {
+        append(**it);
+    }
+    if (m_pending.size() >= FLUSH_SIZE)
+    {
+        flush();
+    }
+    else if (!m_flushTimer.isActive())
+    {
+        m_flushTimer.start(FLUSH_INTERVAL);
+    }
+}
+
+void LogRelay::flush()
+{
+    m_flushTimer.stop();
+    if (!isConnected())
+    {
+        return;
+    }
+    reportDrops();
+    finishBlock();
+    if (!m_pending.isEmpty())
+    {
+        m_socket.write(m_pending);
+        m_pending.clear();
+    }
+}
+
+void LogRelay::connected()
+{
+    m_reconnectDelay = MIN_RECONNECT_DELAY;
+
+    RawLogMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = CONNECTION_MESSAGE;
+    // Version 4 servers are the first to take relays.
+    msg.connection.version = 4;
+    msg.connection.pid = quint64(QCoreApplication::applicationPid());
+    strncpy(msg.connection.machineName, QSysInfo::machineHostName().toLocal8Bit().constData(), sizeof(msg.connection.machineName) - 1);
+    strncpy(msg.connection.executablePath, QCoreApplication::applicationFilePath().toLocal8Bit().constData(), ConnectionMessage::MESSAGE_MAX_PATH - 1);
+    m_socket.write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = RELAY_MESSAGE;
+    m_socket.write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+    qDebug() << "Relaying to" << upstream();
+    flush();
+}
+
+void LogRelay::socketError()
+{
+    if (m_host.isEmpty())
+    {
+        return;
+    }
+    // Whatever the socket had not written yet is lost with it.
+    qDebug() << "Relay connection to" << upstream() << "failed:" << m_socket.errorString();
+    m_socket.abort();
+    startReconnect();
+}
+
+void LogRelay::startReconnect()
+{
+    if (!m_reconnectTimer.isActive())
+    {
+        m_reconnectTimer.start(m_reconnectDelay);
+        m_reconnectDelay = std::min(m_reconnectDelay * 2, MAX_RECONNECT_DELAY);
+    }
+}
+
+void LogRelay::reconnectNow()
+{
+    if (m_host.isEmpty() || m_socket.state() != QAbstractSocket::UnconnectedState)
+    {
+        return;
+    }
+    m_socket.connectToHost(m_host, m_port);
+}
+
+void LogRelay::append(const LogMessage& message)
+{
+    auto module = utf8(message.module, 0xFF);
+    auto channel = utf8(message.channel, 0xFF);
+    auto text = utf8(message.message, MAX_TEXT_SIZE);
+    auto recordSize = qint64(sizeof(DatagramRecord)) + module.size() + channel.size() + text.size();
+    // What the socket has yet to write counts too, so a slow upstream fills
+    // the capacity like a lost one.
+    if (m_pending.size() + m_socket.bytesToWrite() + recordSize > m_capacity)
+    {
+        ++m_dropped;
+        return;
+    }
+    if (m_blockStart < 0 || message.pid != m_blockPid || message.machineName != m_blockMachineName ||
+            message.executablePath != m_blockExecutablePath || message.clockOffset != m_blockClockOffset ||
+            m_pending.size() - m_blockStart + recordSize > qint64(sizeof(quint32) + MAX_RELAY_BLOCK_SIZE))
+    {
+        finishBlock();
+        beginBlock(message);
+    }
+
+    DatagramRecord record;
+    record.timestamp = quint64(message.timestamp.toMSecsSinceEpoch());
+    record.severity = quint32(message.severity);
+    record.messageSize = quint16(text.size());
+    record.moduleSize = quint8(module.size());
+    record.channelSize = quint8(channel.size());
+    appendRaw(m_pending, &record, sizeof(record));
+    m_pending.append(module);
+    m_pending.append(channel);
+    m_pending.append(text);
+    ++m_blockRecords;
+}
+
+void LogRelay::beginBlock(const LogMessage& message)
+{
+    auto machineName = utf8(message.machineName, 0xFF);
+    auto executablePath = utf8(message.executablePath, int(ConnectionMessage::MESSAGE_MAX_PATH));
+    m_blockStart = int(m_pending.size());
+    m_blockRecords = 0;
+    m_blockPid = message.pid;
+    m_blockClockOffset = message.clockOffset;
+    m_blockMachineName = message.machineName;
+    m_blockExecutablePath = message.executablePath;
+
+    // The size and record count are filled in when the block is finished.
+    quint32 size = 0;
+    appendRaw(m_pending, &size, sizeof(size));
+    DatagramHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DatagramHeader::MAGIC;
+    header.sequence = quint32(message.clockOffset);
+    header.machineNameSize = quint8(machineName.size());
+    header.executablePathSize = quint16(executablePath.size());
+    header.pid = message.pid;
+    appendRaw(m_pending, &header, sizeof(header));
+    m_pending.append(machineName);
+    m_pending.append(executablePath);
+}
+
+void LogRelay::finishBlock()
+{
+    if (m_blockStart < 0)
+    {
+        return;
+    }
+    auto block = m_pending.data() + m_blockStart;
+    auto size = quint32(m_pending.size() - m_blockStart - qsizetype(sizeof(quint32)));
+    memcpy(block, &size, sizeof(size));
+    memcpy(block + sizeof(size) + offsetof(DatagramHeader, recordCount), &m_blockRecords, sizeof(m_blockRecords));
+    m_blockStart = -1;
+}
+
+void LogRelay::reportDrops()
+{
+    if (m_dropped == m_reportedDrops)
+    {
+        return;
+    }
+    LogMessage message;
+    message.timestamp = QDateTime::currentDateTime();
+    message.pid = quint64(QCoreApplication::applicationPid());
+    message.severity = SEVERITY_WARN;
+    message.machineName = QSysInfo::machineHostName();
+    message.executablePath = QCoreApplication::applicationFilePath();
+    message.module = "LogLite";
+    message.channel = "overload";
+    message.message = QString("%1 messages dropped, the relay could not keep up with %2").arg(m_dropped - m_reportedDrops).arg(upstream());
+    m_reportedDrops = m_dropped;
+    append(message);
+}
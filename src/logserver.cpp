@@ -0,0 +1,1227 @@
+#include "logserver.h"
+#include "profiler.h"
+#include "sharedring.h"
+#include <QBuffer>
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+using namespace LogProtocol;
+
+namespace
+{
+
+const int METRICS_INTERVAL = 500;
+const float METRICS_WINDOW = 5.f;
+const int THROTTLE_INTERVAL = 50;
+// Enough for a handful of messages, so a throttled client stalls on send
+// instead of queuing megabytes in our socket buffer.
+const qint64 THROTTLED_READ_BUFFER = 64 * sizeof(RawLogMessage);
+const qint64 DEFAULT_FRAME_BUDGET = 8000000;
+const int MIN_READ_QUANTUM = 16;
+const int MAX_READ_QUANTUM = 4096;
+const int DEFAULT_READ_QUANTUM = 256;
+// Rings have no readyRead, so they are polled: every millisecond while any
+// client is writing, backing off while they are all quiet.
+const int MIN_RING_POLL = 1;
+const int MAX_RING_POLL = 16;
+// Datagrams arriving while the event loop is busy wait in the receive
+// buffer, or are lost once it is full.
+const int DATAGRAM_RECEIVE_BUFFER = 8 * 1024 * 1024;
+const qint64 DATAGRAM_SENDER_TIMEOUT = 60000;
+// Clock offsets are estimated over windows of a minute, so clocks drifting
+// apart are followed.
+const int CLOCK_WINDOW = 60000 / METRICS_INTERVAL;
+const qint64 NO_UPPER_BOUND = std::numeric_limits<qint64>::max();
+const qint64 NO_LOWER_BOUND = std::numeric_limits<qint64>::min();
+
+// Clients arrive on either a QTcpSocket or a QLocalSocket, which share
+// QIODevice but not the socket calls.
+void abortSocket(QIODevice* socket)
+{
+    if (auto local = qobject_cast<QLocalSocket*>(socket))
+    {
+        local->abort();
+    }
+    else
+    {
+        static_cast<QTcpSocket*>(socket)->abort();
+    }
+}
+
+void closeSocket(QIODevice* socket)
+{
+    if (auto local = qobject_cast<QLocalSocket*>(socket))
+    {
+        local->disconnectFromServer();
+    }
+    else
+    {
+        static_cast<QTcpSocket*>(socket)->disconnectFromHost();
+    }
+}
+
+void setReadBufferSize(QIODevice* socket, qint64 size)
+{
+    if (auto local = qobject_cast<QLocalSocket*>(socket))
+    {
+        local->setReadBufferSize(size);
+    }
+    else
+    {
+        static_cast<QTcpSocket*>(socket)->setReadBufferSize(size);
+    }
+}
+
+bool isLocalPeer(QIODevice* socket)
+{
+    if (qobject_cast<QLocalSocket*>(socket))
+    {
+        return true;
+    }
+    return static_cast<QTcpSocket*>(socket)->peerAddress().isLoopback();
+}
+
+// Severities past the last one known are taken as errors, so nothing
+// downstream indexes by them out of range.
+LogSeverity severityFromWire(uint32_t severity)
+{
+    return severity < SEVERITY_COUNT ? LogSeverity(severity) : SEVERITY_ERR;
+}
+
+// A relay block is only read once all of it has arrived. One over the size
+// limit counts as ready, so reading it aborts the relay.
+bool hasRelayBlock(QIODevice* socket)
+{
+    quint32 size = 0;
+    if (socket->peek(reinterpret_cast<char*>(&size), sizeof(size)) < qint64(sizeof(size)))
+    {
+        return false;
+    }
+    return size > MAX_RELAY_BLOCK_SIZE || socket->bytesAvailable() >= qint64(sizeof(size) + size);
+}
+
+}
+
+
+LogServer::Client::Client()
+    :m_socket(nullptr)
+{
+}
+
+LogServer::Client::Client(QIODevice* socket)
+    :m_socket(socket)
+{
+}
+
+uint64_t LogServer::Client::pid() const
+{
+    if (m_socket)
+    {
+        return m_socket->property("pid").toULongLong();
+    }
+    return 0;
+}
+
+QString LogServer::Client::path() const
+{
+    if (m_socket)
+    {
+        return m_socket->property("executablePath").toString();
+    }
+    return QString();
+}
+
+QString LogServer::Client::machine() const
+{
+    if (m_socket)
+    {
+        return m_socket->property("machineName").toString();
+    }
+    return QString();
+}
+
+LogServer::Client LogServer::Client::relay() const
+{
+    if (m_socket)
+    {
+        return Client(qobject_cast<QIODevice*>(m_socket->parent()));
+    }
+    return Client();
+}
+
+QIODevice* LogServer::Client::socket() const
+{
+    return m_socket;
+}
+
+bool LogServer::Client::operator==(const Client& other) const
+{
+    return m_socket == other.m_socket;
+}
+
+
+uint qHash(const LogServer::Client& client)
+{
+    return qHash(client.socket());
+}
+
+
+LogServer::ClientMetrics::ClientMetrics()
+    :messagesPerSecond(0),
+      bytesPerSecond(0),
+      backlog(0),
+      reassemblyBytes(0),
+      totalMessages(0),
+      totalBytes(0),
+      throttled(false),
+      sharedMemory(false),
+      localSocket(false),
+      datagram(false),
+      lostDatagrams(0),
+      relay(false),
+      clockOffset(0),
+      clockSynchronized(false)
+{
+}
+
+
+LogServer::RateWindow::RateWindow()
+    :m_bin(0),
+      m_total(0)
+{
+    m_bins.resize(int(ceil(METRICS_WINDOW * 1000 / METRICS_INTERVAL)));
+}
+
+void LogServer::RateWindow::add(qint64 amount)
+{
+    m_bins[m_bin] += amount;
+    m_total += amount;
+}
+
+void LogServer::RateWindow::update()
+{
+    m_bin = (m_bin + 1) % m_bins.size();
+    m_total -= m_bins[m_bin];
+    m_bins[m_bin] = 0;
+}
+
+double LogServer::RateWindow::perSecond() const
+{
+    return m_total / METRICS_WINDOW;
+}
+
+
+LogServer::ClockEstimate::ClockEstimate()
+    :m_upperBounds{NO_UPPER_BOUND, NO_UPPER_BOUND},
+      m_lowerBounds{NO_LOWER_BOUND, NO_LOWER_BOUND},
+      m_intervals(0),
+      m_synchronized(false),
+      m_offset(0)
+{
+}
+
+void LogServer::ClockEstimate::addUpperBound(qint64 offset)
+{
+    if (offset < m_upperBounds[0])
+    {
+        m_upperBounds[0] = offset;
+        estimate();
+    }
+}
+
+void LogServer::ClockEstimate::addLowerBound(qint64 offset)
+{
+    if (offset > m_lowerBounds[0])
+    {
+        m_lowerBounds[0] = offset;
+        estimate();
+    }
+}
+
+void LogServer::ClockEstimate::update()
+{
+    if (++m_intervals < CLOCK_WINDOW)
+    {
+        return;
+    }
+    m_intervals = 0;
+    m_upperBounds[1] = m_upperBounds[0];
+    m_upperBounds[0] = NO_UPPER_BOUND;
+    m_lowerBounds[1] = m_lowerBounds[0];
+    m_lowerBounds[0] = NO_LOWER_BOUND;
+    estimate();
+}
+
+bool LogServer::ClockEstimate::isSynchronized() const
+{
+    return m_synchronized;
+}
+
+qint64 LogServer::ClockEstimate::offset() const
+{
+    return m_offset;
+}
+
+void LogServer::ClockEstimate::estimate()
+{
+    auto upper = std::min(m_upperBounds[0], m_upperBounds[1]);
+    auto lower = std::max(m_lowerBounds[0], m_lowerBounds[1]);
+    // A client that stopped exchanging clock messages keeps its last offset,
+    // as does one whose bounds cross because they were taken on either side
+    // of a step of its clock, until they age out.
+    if (upper == NO_UPPER_BOUND || lower == NO_LOWER_BOUND || lower > upper)
+    {
+        return;
+    }
+    m_synchronized = true;
+    m_offset = lower + (upper - lower) / 2;
+}
+
+
+LogServer::Connection::Connection()
+    :nextMessage(nullptr),
+      totalMessages(0),
+      totalBytes(0),
+      throttled(false),
+      readTokens(0),
+      ready(false),
+      ring(nullptr),
+      relay(false)
+{
+}
+
+
+LogServer::VirtualClient::VirtualClient()
+    :relay(nullptr),
+      pid(0),
+      totalMessages(0),
+      totalBytes(0),
+      nextSequence(0),
+      lostDatagrams(0),
+      clockOffset(0)
+{
+}
+
+
+LogServer::LogServer(QObject* parent)
+    :QObject(parent),
+      m_datagramsEnabled(false),
+      m_clockCorrection(true),
+      m_clientRateLimit(0),
+      m_frameBudget(DEFAULT_FRAME_BUDGET),
+      m_frameCost(0),
+      m_readQuantum(DEFAULT_READ_QUANTUM)
+{
+    connect(&m_server, &QTcpServer::newConnection, this, &LogServer::acceptConnection);
+    connect(&m_localServer, &QLocalServer::newConnection, this, &LogServer::acceptLocalConnection);
+    connect(&m_metricsTimer, &QTimer::timeout, this, &LogServer::updateMetrics);
+    connect(&m_throttleTimer, &QTimer::timeout, this, &LogServer::readThrottled);
+    connect(&m_readTimer, &QTimer::timeout, this, &LogServer::readReadyClients);
+    connect(&m_ringTimer, &QTimer::timeout, this, &LogServer::pollRings);
+    connect(&m_datagramSocket, &QUdpSocket::readyRead, this, &LogServer::readDatagrams);
+    connect(&m_datagramTimer, &QTimer::timeout, this, &LogServer::readDatagrams);
+    m_readTimer.setSingleShot(true);
+    m_datagramTimer.setSingleShot(true);
+    m_ringTimer.setTimerType(Qt::PreciseTimer);
+    m_datagramBuffer.resize(int(MAX_DATAGRAM_SIZE));
+    m_metricsTimer.start(METRICS_INTERVAL);
+}
+
+LogServer::~LogServer()
+{
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        delete it->nextMessage;
+        delete it->ring;
+    }
+}
+
+bool LogServer::listen(quint16 port)
+{
+    auto listening = m_server.listen(QHostAddress::Any, port);
+    if (listening)
+    {
+        qDebug() << "Server started on port" << m_server.serverPort();
+    }
+    else
+    {
+        qDebug() << "Server failed to start:" << m_server.errorString();
+        return false;
+    }
+
+    // Holding the port means any socket file by the same name was left
+    // behind by a server that is gone.
+    auto name = localName(m_server.serverPort());
+    QLocalServer::removeServer(name);
+    if (m_localServer.listen(name))
+    {
+        qDebug() << "Local server started on" << m_localServer.fullServerName();
+    }
+    else
+    {
+        qDebug() << "Local server failed to start:" << m_localServer.errorString();
+    }
+    if (m_datagramsEnabled)
+    {
+        bindDatagrams();
+    }
+    return true;
+}
+
+bool LogServer::isListening() const
+{
+    return m_server.isListening();
+}
+
+bool LogServer::isListeningLocally() const
+{
+    return m_localServer.isListening();
+}
+
+QString LogServer::localName(quint16 port)
+{
+    return port == DEFAULT_PORT ? QString(DEFAULT_LOCAL_NAME) : QString("%1-%2").arg(DEFAULT_LOCAL_NAME).arg(port);
+}
+
+QString LogServer::localServerName() const
+{
+    return m_localServer.serverName();
+}
+
+quint16 LogServer::port() const
+{
+    return m_server.serverPort();
+}
+
+bool LogServer::setDatagramsEnabled(bool enabled)
+{
+    m_datagramsEnabled = enabled;
+    if (enabled)
+    {
+        return !isListening() || bindDatagrams();
+    }
+    m_datagramSocket.close();
+    m_datagramTimer.stop();
+    auto devices = m_virtualClients.keys();
+    for (auto it = devices.begin(); it != devices.end(); ++it)
+    {
+        if (!m_virtualClients[*it].relay)
+        {
+            removeVirtualClient(*it);
+        }
+    }
+    return true;
+}
+
+bool LogServer::datagramsEnabled() const
+{
+    return m_datagramsEnabled;
+}
+
+bool LogServer::isListeningForDatagrams() const
+{
+    return m_datagramSocket.state() == QAbstractSocket::BoundState;
+}
+
+bool LogServer::bindDatagrams()
+{
+    if (isListeningForDatagrams())
+    {
+        return true;
+    }
+    if (!m_datagramSocket.bind(QHostAddress::Any, m_server.serverPort()))
+    {
+        qDebug() << "Datagram socket failed to bind:" << m_datagramSocket.errorString();
+        return false;
+    }
+    m_datagramSocket.setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, DATAGRAM_RECEIVE_BUFFER);
+    qDebug() << "Datagram socket bound to port" << m_datagramSocket.localPort();
+    return true;
+}
+
+const LogServer::Clients& LogServer::clients() const
+{
+    return m_clients;
+}
+
+bool LogServer::clientFromMessage(const LogMessage& message, Client& client) const
+{
+    auto found = std::find_if(m_clients.begin(), m_clients.end(), [&](const Client& client)
+    {
+        return client.pid() == message.pid && client.machine() == message.machineName &&
+                client.path() == message.executablePath;
+    });
+    if (found == m_clients.end())
+    {
+        return false;
+    }
+    client = *found;
+    return true;
+}
+
+void LogServer::disconnect(const Client& client)
+{
+    if (!client.socket() || !m_clients.contains(client))
+    {
+        return;
+    }
+    if (m_virtualClients.contains(client.socket()))
+    {
+        // There is nothing to close, it comes back with its next message.
+        removeVirtualClient(client.socket());
+        return;
+    }
+    closeSocket(client.socket());
+}
+
+LogServer::ClientMetrics LogServer::metrics(const Client& client) const
+{
+    ClientMetrics result;
+    auto connection = m_connections.find(client.socket());
+    if (connection == m_connections.end())
+    {
+        auto sender = m_virtualClients.find(client.socket());
+        if (sender != m_virtualClients.end())
+        {
+            result.messagesPerSecond = sender->messages.perSecond();
+            result.bytesPerSecond = sender->bytes.perSecond();
+            result.totalMessages = sender->totalMessages;
+            result.totalBytes = sender->totalBytes;
+            result.datagram = !sender->relay;
+            result.lostDatagrams = sender->lostDatagrams;
+            result.clockOffset = sender->clockOffset;
+            result.clockSynchronized = sender->clockOffset != 0;
+        }
+        return result;
+    }
+    result.messagesPerSecond = connection->messages.perSecond();
+    result.bytesPerSecond = connection->bytes.perSecond();
+    result.backlog = connection->ring ? pendingFrames(client.socket(), *connection) * qint64(sizeof(RawLogMessage))
+                                      : client.socket()->bytesAvailable();
+    result.reassemblyBytes = connection->receivedText.size();
+    result.totalMessages = connection->totalMessages;
+    result.totalBytes = connection->totalBytes;
+    result.throttled = connection->throttled;
+    result.sharedMemory = connection->ring;
+    result.localSocket = qobject_cast<QLocalSocket*>(client.socket());
+    result.relay = connection->relay;
+    result.clockOffset = connection->clock.offset();
+    result.clockSynchronized = connection->clock.isSynchronized();
+    return result;
+}
+
+void LogServer::setClientRateLimit(int messagesPerSecond)
+{
+    m_clientRateLimit = std::max(messagesPerSecond, 0);
+    updateMetrics();
+}
+
+int LogServer::clientRateLimit() const
+{
+    return m_clientRateLimit;
+}
+
+void LogServer::setFrameBudget(int microseconds)
+{
+    m_frameBudget = std::max(microseconds, 1) * qint64(1000);
+}
+
+int LogServer::frameBudget() const
+{
+    return int(m_frameBudget / 1000);
+}
+
+int LogServer::readQuantum() const
+{
+    return m_readQuantum;
+}
+
+qint64 LogServer::backlog() const
+{
+    qint64 frames = 0;
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        frames += pendingFrames(it.key(), *it);
+    }
+    return frames;
+}
+
+qint64 LogServer::backlogAge() const
+{
+    return m_backlogClock.isValid() ? m_backlogClock.elapsed() : 0;
+}
+
+void LogServer::setClockCorrection(bool enabled)
+{
+    m_clockCorrection = enabled;
+}
+
+bool LogServer::clockCorrection() const
+{
+    return m_clockCorrection;
+}
+
+void LogServer::disconnectAll()
+{
+    auto copy = m_clients;
+    for (auto it = copy.begin(); it != copy.end(); ++it)
+    {
+        disconnect(*it);
+    }
+}
+
+void LogServer::acceptConnection()
+{
+    while (auto socket = m_server.nextPendingConnection())
+    {
+        socket->setProperty("receivedConnectionMessage", false);
+        connect(socket, &QTcpSocket::readyRead, this, &LogServer::readMessages);
+        connect(socket, &QTcpSocket::disconnected, this, &LogServer::socketDisconnected);
+        m_clients.insert(socket);
+        m_connections.insert(socket, Connection());
+        emit clientConnected();
+    }
+}
+
+void LogServer::acceptLocalConnection()
+{
+    while (auto socket = m_localServer.nextPendingConnection())
+    {
+        socket->setProperty("receivedConnectionMessage", false);
+        connect(socket, &QLocalSocket::readyRead, this, &LogServer::readMessages);
+        connect(socket, &QLocalSocket::disconnected, this, &LogServer::socketDisconnected);
+        m_clients.insert(socket);
+        m_connections.insert(socket, Connection());
+        emit clientConnected();
+    }
+}
+
+void LogServer::socketDisconnected()
+{
+    auto socket = static_cast<QIODevice*>(sender());
+    auto connection = m_connections.find(socket);
+    if (connection != m_connections.end())
+    {
+        // Reads wait for their turn, so a client that closed right after a
+        // burst may have left most of it unread in the socket or its ring,
+        // and the throttle may have held back much of what a client sent.
+        connection->throttled = false;
+        QVector<LogMessage*> messages;
+        readClient(socket, std::numeric_limits<int>::max(), messages);
+        if (!messages.isEmpty())
+        {
+            emit messagesReceived(messages);
+        }
+        connection = m_connections.find(socket);
+    }
+    if (connection != m_connections.end())
+    {
+        delete connection->nextMessage;
+        delete connection->ring;
+        m_connections.erase(connection);
+    }
+    QList<QIODevice*> remote;
+    for (auto it = m_virtualClients.begin(); it != m_virtualClients.end(); ++it)
+    {
+        if (it->relay == socket)
+        {
+            remote.append(it.key());
+        }
+    }
+    for (auto it = remote.begin(); it != remote.end(); ++it)
+    {
+        removeVirtualClient(*it);
+    }
+    m_readyClients.removeOne(socket);
+    m_clients.remove(socket);
+    socket->deleteLater();
+    emit clientDisconnected();
+}
+
+void LogServer::readMessages()
+{
+    scheduleRead(static_cast<QIODevice*>(sender()));
+}
+
+void LogServer::scheduleRead(QIODevice* socket)
+{
+    auto connection = m_connections.find(socket);
+    if (connection == m_connections.end() || connection->ready)
+    {
+        return;
+    }
+    connection->ready = true;
+    m_readyClients.append(socket);
+    if (!m_readTimer.isActive())
+    {
+        m_readTimer.start(0);
+    }
+}
+
+qint64 LogServer::pendingFrames(QIODevice* socket, const Connection& connection) const
+{
+    if (connection.ring)
+    {
+        return qint64(connection.ring->size());
+    }
+    return socket->bytesAvailable() / qint64(sizeof(RawLogMessage));
+}
+
+bool LogServer::canRead(QIODevice* socket, const Connection& connection) const
+{
+    if (connection.throttled && connection.readTokens < 1)
+    {
+        return false;
+    }
+    if (connection.relay)
+    {
+        return hasRelayBlock(socket);
+    }
+    // Anything arriving on the socket of a ring client is a protocol error,
+    // which readClient deals with.
+    return pendingFrames(socket, connection) > 0 || (connection.ring && socket->bytesAvailable());
+}
+
+void LogServer::readReadyClients()
+{
+    QElapsedTimer clock;
+    clock.start();
+    while (!m_readyClients.isEmpty() && clock.nsecsElapsed() < m_frameBudget)
+    {
+        auto roundStart = clock.nsecsElapsed();
+        auto round = m_readyClients;
+        m_readyClients.clear();
+        QVector<LogMessage*> messages;
+        int frames = 0;
+        for (auto it = round.begin(); it != round.end(); ++it)
+        {
+            auto socket = *it;
+            frames += readClient(socket, m_readQuantum, messages);
+            // The socket is gone if reading aborted it.
+            auto connection = m_connections.find(socket);
+            if (connection == m_connections.end())
+            {
+                continue;
+            }
+            connection->ready = canRead(socket, *connection);
+            if (connection->ready)
+            {
+                m_readyClients.append(socket);
+            }
+        }
+        if (!messages.isEmpty())
+        {
+            emit messagesReceived(messages);
+        }
+
+        // Frame cost includes whatever the receivers do with the messages, so
+        // the quantum shrinks when the model or filters get expensive.
+        if (frames)
+        {
+            double cost = double(clock.nsecsElapsed() - roundStart) / frames;
+            m_frameCost = m_frameCost > 0 ? m_frameCost * 0.75 + cost * 0.25 : cost;
+            double quantum = m_frameBudget / 2 / (m_frameCost * std::max(1, int(m_readyClients.size())));
+            m_readQuantum = int(std::max<double>(MIN_READ_QUANTUM, std::min<double>(MAX_READ_QUANTUM, quantum)));
+        }
+    }
+    if (!m_readyClients.isEmpty())
+    {
+        if (!m_backlogClock.isValid())
+        {
+            m_backlogClock.start();
+        }
+        m_readTimer.start(0);
+    }
+    else
+    {
+        m_backlogClock.invalidate();
+    }
+}
+
+int LogServer::readClient(QIODevice* socket, int maxFrames, QVector<LogMessage*>& messages)
+{
+    Profiler::Scope scope(Profiler::SECTION_READ_MESSAGES);
+    auto found = m_connections.find(socket);
+    if (found == m_connections.end())
+    {
+        return 0;
+    }
+    auto& connection = *found;
+    if (connection.ring)
+    {
+        if (socket->bytesAvailable())
+        {
+            abortSocket(socket);
+            return 0;
+        }
+        return readRing(socket, connection, maxFrames, messages);
+    }
+    if (connection.relay)
+    {
+        return readRelay(socket, connection, maxFrames, messages);
+    }
+    RawLogMessage msg;
+    int frames = 0;
+    while (frames < maxFrames && socket->bytesAvailable() >= qint64(sizeof(msg)))
+    {
+        if (connection.throttled)
+        {
+            if (connection.readTokens < 1)
+            {
+                break;
+            }
+            connection.readTokens -= 1;
+        }
+        socket->read(reinterpret_cast<char*>(&msg), sizeof(msg));
+        ++frames;
+        if (!processFrame(socket, connection, msg, messages) || connection.ring || connection.relay)
+        {
+            break;
+        }
+    }
+    return frames;
+}
+
+int LogServer::readRing(QIODevice* socket, Connection& connection, int maxFrames, QVector<LogMessage*>& messages)
+{
+    // Frames are processed where they lie and handed back to the client a
+    // run at a time.
+    auto ring = connection.ring;
+    int frames = 0;
+    while (frames < maxFrames)
+    {
+        quint32 count = 0;
+        auto run = ring->read(count);
+        count = std::min(count, quint32(maxFrames - frames));
+        if (connection.throttled)
+        {
+            count = std::min(count, quint32(connection.readTokens));
+            connection.readTokens -= count;
+        }
+        if (!count)
+        {
+            break;
+        }
+        for (quint32 i = 0; i < count; ++i)
+        {
+            if (!processFrame(socket, connection, run[i], messages))
+            {
+                return frames + int(i) + 1;
+            }
+        }
+        ring->release(count);
+        frames += int(count);
+    }
+    return frames;
+}
+
+int LogServer::readRelay(QIODevice* socket, Connection& connection, int maxFrames, QVector<LogMessage*>& messages)
+{
+    // Counted in messages rather than blocks, so a relay gets the share of a
+    // turn a client sending frames would.
+    auto start = messages.size();
+    while (messages.size() - start < maxFrames && hasRelayBlock(socket))
+    {
+        quint32 size = 0;
+        socket->read(reinterpret_cast<char*>(&size), sizeof(size));
+        if (size > MAX_RELAY_BLOCK_SIZE)
+        {
+            abortSocket(socket);
+            break;
+        }
+        socket->read(m_datagramBuffer.data(), size);
+        connection.bytes.add(qint64(sizeof(size) + size));
+        connection.totalBytes += sizeof(size) + size;
+        auto count = messages.size();
+        processDatagram(m_datagramBuffer.constData(), size, socket, messages);
+        connection.messages.add(messages.size() - count);
+        connection.totalMessages += quint64(messages.size() - count);
+    }
+    return int(messages.size() - start);
+}
+
+bool LogServer::processFrame(QIODevice* socket, Connection& connection, const RawLogMessage& msg, QVector<LogMessage*>& messages)
+{
+    connection.bytes.add(sizeof(msg));
+    connection.totalBytes += sizeof(msg);
+    bool receivedConnectionMessage = socket->property("receivedConnectionMessage").toBool();
+    if ((msg.type != CONNECTION_MESSAGE) != receivedConnectionMessage )
+    {
+        abortSocket(socket);
+        return false;
+    }
+    if (msg.type == CONNECTION_MESSAGE)
+    {
+        if (msg.connection.version > VERSION)
+        {
+            abortSocket(socket);
+            return false;
+        }
+        socket->setProperty("version", msg.connection.version);
+        socket->setProperty("receivedConnectionMessage", true);
+        socket->setProperty("pid", quint64(msg.connection.pid));
+        socket->setProperty("machineName", QString::fromLocal8Bit(msg.connection.machineName));
+        socket->setProperty("executablePath", QString::fromLocal8Bit(msg.connection.executablePath));
+        return true;
+    }
+    if (msg.type == SHARED_MEMORY_MESSAGE)
+    {
+        if (connection.ring || connection.nextMessage || socket->property("version").toUInt() < 3)
+        {
+            abortSocket(socket);
+            return false;
+        }
+        attachRing(socket, connection, msg.sharedMemory);
+        return true;
+    }
+    if (msg.type == RELAY_MESSAGE)
+    {
+        if (connection.ring || connection.nextMessage || socket->property("version").toUInt() < 4)
+        {
+            abortSocket(socket);
+            return false;
+        }
+        connection.relay = true;
+        return true;
+    }
+    if (msg.type == CLOCK_MESSAGE)
+    {
+        if (connection.nextMessage || socket->property("version").toUInt() < 5)
+        {
+            abortSocket(socket);
+            return false;
+        }
+        auto now = QDateTime::currentMSecsSinceEpoch();
+        if (!msg.clock.serverTime)
+        {
+            auto reply = msg.clock;
+            reply.serverTime = quint64(now);
+            socket->write(reinterpret_cast<const char*>(&reply), sizeof(reply));
+            connection.clock.addUpperBound(now - qint64(msg.clock.clientSent));
+        }
+        else
+        {
+            // The client read our time after it was taken.
+            connection.clock.addLowerBound(qint64(msg.clock.serverTime) - qint64(msg.clock.clientReceived));
+        }
+        return true;
+    }
+
+    if (!connection.nextMessage)
+    {
+        connection.nextMessage = new LogMessage;
+        auto timestamp = qint64(msg.text.timestamp);
+        if (socket->property("version") == 1)
+        {
+            timestamp *= 1000;
+        }
+        connection.nextMessage->clockOffset = correction(connection.clock);
+        connection.nextMessage->timestamp.setMSecsSinceEpoch(timestamp + connection.nextMessage->clockOffset);
+        connection.nextMessage->pid = uint64_t(socket->property("pid").toULongLong());
+        connection.nextMessage->severity = severityFromWire(msg.text.severity);
+        connection.nextMessage->machineName = socket->property("machineName").toString();
+        connection.nextMessage->executablePath = socket->property("executablePath").toString();
+        connection.nextMessage->module = QString::fromLocal8Bit(msg.text.module, int(strnlen(msg.text.module, sizeof(msg.text.module))));
+        connection.nextMessage->channel = QString::fromLocal8Bit(msg.text.channel, int(strnlen(msg.text.channel, sizeof(msg.text.channel))));
+    }
+    connection.receivedText.append(msg.text.message, int(strnlen(msg.text.message, TextMessage::TEXT_SIZE)));
+
+    if (msg.type == SIMPLE_MESSAGE || msg.type == CONTINUATION_END_MESSAGE)
+    {
+        connection.nextMessage->message = QString::fromUtf8(connection.receivedText);
+        connection.nextMessage->originalMessage = connection.nextMessage->message;
+        connection.nextMessage->isMultilineContinuation = false;
+        connection.receivedText.clear();
+        messages.append(connection.nextMessage);
+        connection.nextMessage = nullptr;
+        connection.messages.add(1);
+        ++connection.totalMessages;
+    }
+    return true;
+}
+
+void LogServer::attachRing(QIODevice* socket, Connection& connection, const SharedMemoryMessage& message)
+{
+    auto key = QString::fromLatin1(message.key, int(strnlen(message.key, SharedMemoryMessage::KEY_SIZE)));
+    auto ring = new SharedRing;
+    char reply = SHARED_MEMORY_REJECTED;
+    // Only a process on this machine can be sharing memory with us.
+    if (isLocalPeer(socket) && ring->attach(key, message.capacity))
+    {
+        connection.ring = ring;
+        reply = SHARED_MEMORY_ACCEPTED;
+        m_ringTimer.start(MIN_RING_POLL);
+    }
+    else
+    {
+        qDebug() << "Could not attach shared memory" << key << "of client" << socket->property("pid").toULongLong() << ring->errorString();
+        delete ring;
+    }
+    socket->write(&reply, 1);
+}
+
+void LogServer::setThrottled(QIODevice* socket, Connection& connection, bool throttled)
+{
+    connection.throttled = throttled;
+    connection.readTokens = 0;
+    setReadBufferSize(socket, throttled ? THROTTLED_READ_BUFFER : 0);
+    qDebug() << (throttled ? "Throttling client" : "Stopped throttling client")
+             << socket->property("pid").toULongLong() << socket->property("executablePath").toString();
+}
+
+void LogServer::updateMetrics()
+{
+    QList<QIODevice*> quiet;
+    for (auto it = m_virtualClients.begin(); it != m_virtualClients.end(); ++it)
+    {
+        it->messages.update();
+        it->bytes.update();
+        if (it->lastSeen.hasExpired(DATAGRAM_SENDER_TIMEOUT))
+        {
+            quiet.append(it.key());
+        }
+    }
+    for (auto it = quiet.begin(); it != quiet.end(); ++it)
+    {
+        removeVirtualClient(*it);
+    }
+
+    bool anyThrottled = false;
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        auto socket = it.key();
+        auto& connection = it.value();
+        connection.messages.update();
+        connection.bytes.update();
+        connection.clock.update();
+
+        // A relay carries many clients, which its own server has already
+        // limited.
+        auto rate = connection.messages.perSecond();
+        if (!connection.throttled && !connection.relay && m_clientRateLimit && rate > m_clientRateLimit)
+        {
+            setThrottled(socket, connection, true);
+        }
+        else if (connection.throttled && (!m_clientRateLimit ||
+                 (rate <= m_clientRateLimit && !pendingFrames(socket, connection))))
+        {
+            setThrottled(socket, connection, false);
+        }
+        anyThrottled = anyThrottled || connection.throttled;
+    }
+    if (anyThrottled && !m_throttleTimer.isActive())
+    {
+        m_throttleTimer.start(THROTTLE_INTERVAL);
+    }
+    else if (!anyThrottled)
+    {
+        m_throttleTimer.stop();
+    }
+    // Unthrottled sockets may still hold a backlog that arrived while they
+    // were capped, and readyRead will not fire for it again.
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        if (!it->throttled && !it->ring && pendingFrames(it.key(), *it))
+        {
+            scheduleRead(it.key());
+        }
+    }
+}
+
+void LogServer::readThrottled()
+{
+    double refill = m_clientRateLimit * THROTTLE_INTERVAL / 1000.0;
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        if (it->throttled)
+        {
+            // Allow a little burst so the budget survives timer jitter.
+            it->readTokens = std::min(it->readTokens + refill, refill * 2);
+            scheduleRead(it.key());
+        }
+    }
+}
+
+void LogServer::pollRings()
+{
+    bool attached = false;
+    bool busy = false;
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        if (!it->ring)
+        {
+            continue;
+        }
+        attached = true;
+        // Throttled rings are read as readThrottled hands out tokens.
+        if (!it->throttled && it->ring->size())
+        {
+            scheduleRead(it.key());
+            busy = true;
+        }
+    }
+    if (!attached)
+    {
+        m_ringTimer.stop();
+        return;
+    }
+    auto interval = busy ? MIN_RING_POLL : std::min(m_ringTimer.interval() * 2, MAX_RING_POLL);
+    if (interval != m_ringTimer.interval())
+    {
+        m_ringTimer.setInterval(interval);
+    }
+}
+
+void LogServer::readDatagrams()
+{
+    Profiler::Scope scope(Profiler::SECTION_READ_MESSAGES);
+    QElapsedTimer clock;
+    clock.start();
+    QVector<LogMessage*> messages;
+    // Datagrams cannot be throttled, but they get the same budget per turn
+    // as the sockets so a flood of them leaves the event loop room.
+    while (clock.nsecsElapsed() < m_frameBudget && m_datagramSocket.hasPendingDatagrams())
+    {
+        auto size = m_datagramSocket.readDatagram(m_datagramBuffer.data(), m_datagramBuffer.size());
+        if (size < 0)
+        {
+            break;
+        }
+        processDatagram(m_datagramBuffer.constData(), size, nullptr, messages);
+    }
+    if (!messages.isEmpty())
+    {
+        emit messagesReceived(messages);
+    }
+    if (m_datagramSocket.hasPendingDatagrams())
+    {
+        m_datagramTimer.start(0);
+    }
+}
+
+void LogServer::processDatagram(const char* data, qint64 size, QIODevice* relay, QVector<LogMessage*>& messages)
+{
+    DatagramHeader header;
+    if (size < qint64(sizeof(header)))
+    {
+        return;
+    }
+    memcpy(&header, data, sizeof(header));
+    qint64 offset = qint64(sizeof(header)) + header.machineNameSize + header.executablePathSize;
+    if (header.magic != DatagramHeader::MAGIC || offset > size)
+    {
+        return;
+    }
+    auto identity = offsetof(DatagramHeader, machineNameSize);
+    auto sender = virtualClient(header, data + identity, int(offset - identity), relay);
+    sender->lastSeen.start();
+    sender->bytes.add(size);
+    sender->totalBytes += quint64(size);
+    // Sequence numbers wrap around. One behind the expected sequence arrived
+    // out of order and was counted as lost when its successor came. Relays
+    // come over TCP and lose nothing.
+    auto gap = qint32(header.sequence - sender->nextSequence);
+    if (!relay && gap >= 0)
+    {
+        sender->lostDatagrams += quint32(gap);
+        sender->nextSequence = header.sequence + 1;
+    }
+    else if (!relay && sender->lostDatagrams)
+    {
+        --sender->lostDatagrams;
+    }
+    // The relay's server has already corrected the timestamps, by the offset
+    // it measured; this server has no clock messages from the client.
+    auto relayOffset = relay ? qint32(header.sequence) : 0;
+    sender->clockOffset = m_clockCorrection ? relayOffset : 0;
+
+    for (quint32 i = 0; i < header.recordCount; ++i)
+    {
+        DatagramRecord record;
+        if (offset + qint64(sizeof(record)) > size)
+        {
+            break;
+        }
+        memcpy(&record, data + offset, sizeof(record));
+        auto text = data + offset + sizeof(record);
+        offset += qint64(sizeof(record)) + record.moduleSize + record.channelSize + record.messageSize;
+        if (offset > size)
+        {
+            break;
+        }
+        auto message = new LogMessage;
+        message->clockOffset = sender->clockOffset;
+        message->timestamp.setMSecsSinceEpoch(qint64(record.timestamp) - relayOffset + message->clockOffset);
+        message->pid = sender->pid;
+        message->severity = severityFromWire(record.severity);
+        message->machineName = sender->machineName;
+        message->executablePath = sender->executablePath;
+        message->module = QString::fromUtf8(text, record.moduleSize);
+        text += record.moduleSize;
+        message->channel = QString::fromUtf8(text, record.channelSize);
+        text += record.channelSize;
+        message->message = QString::fromUtf8(text, record.messageSize);
+        message->originalMessage = message->message;
+        message->isMultilineContinuation = false;
+        messages.append(message);
+        sender->messages.add(1);
+        ++sender->totalMessages;
+    }
+}
+
+LogServer::VirtualClient* LogServer::virtualClient(const DatagramHeader& header, const char* identity, int identitySize, QIODevice* relay)
+{
+    auto found = m_virtualDevices.find(qMakePair(relay, QByteArray::fromRawData(identity, identitySize)));
+    if (found != m_virtualDevices.end())
+    {
+        return &m_virtualClients[*found];
+    }
+
+    auto names = identity + (sizeof(header) - offsetof(DatagramHeader, machineNameSize));
+    VirtualClient sender;
+    sender.relay = relay;
+    sender.identity = QByteArray(identity, identitySize);
+    sender.pid = header.pid;
+    sender.machineName = QString::fromUtf8(names, header.machineNameSize);
+    sender.executablePath = QString::fromUtf8(names + header.machineNameSize, header.executablePathSize);
+    sender.nextSequence = header.sequence;
+
+    auto device = new QBuffer(relay ? static_cast<QObject*>(relay) : this);
+    device->setProperty("pid", quint64(sender.pid));
+    device->setProperty("machineName", sender.machineName);
+    device->setProperty("executablePath", sender.executablePath);
+    m_virtualDevices.insert(qMakePair(relay, sender.identity), device);
+    m_virtualClients.insert(device, sender);
+    m_clients.insert(device);
+    emit clientConnected();
+    return &m_virtualClients[device];
+}
+
+void LogServer::removeVirtualClient(QIODevice* device)
+{
+    auto sender = m_virtualClients.find(device);
+    if (sender == m_virtualClients.end())
+    {
+        return;
+    }
+    m_virtualDevices.remove(qMakePair(sender->relay, sender->identity));
+    m_virtualClients.erase(sender);
+    m_clients.remove(device);
+    device->deleteLater();
+    emit clientDisconnected();
+}
+
+qint32 LogServer::correction(const ClockEstimate& clock) const
+{
+    if (!m_clockCorrection || !clock.isSynchronized())
+    {
+        return 0;
+    }
+    return qint32(qBound<qint64>(std::numeric_limits<qint32>::min(), clock.offset(), std::numeric_limits<qint32>::max()));
+}
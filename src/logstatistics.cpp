@@ -58,11 +58,14 @@ void LogStatistics::updateStatistics()
         statistics.notice = 0;
         statistics.info = 0;
         statistics.clients = 0;
+        statistics.dropped = 0;
         ui->serverAlive->setEnabled(false);
     }
     ui->errorCount->setText(QString::number(statistics.error));
     ui->warningCount->setText(QString::number(statistics.warning));
     ui->noticeCount->setText(QString::number(statistics.notice));
     ui->infoCount->setText(QString::number(statistics.info));
+    ui->droppedCount->setVisible(statistics.dropped > 0);
+    ui->droppedCount->setText(QString("%1 dropped").arg(statistics.dropped));
     ui->serverAlive->setToolTip(QString("%1 clients connected").arg(QString::number(statistics.clients)));
 }
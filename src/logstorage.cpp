@@ -0,0 +1,294 @@
+#include "logstorage.h"
+#include "profiler.h"
+#include <QtSql>
+#include <QDebug>
+#include <QDir>
+#include <QHostInfo>
+
+namespace
+{
+
+const char* LOAD_CONNECTION = "LogStorage.load";
+const char* SAVE_CONNECTION = "LogStorage.save";
+
+}
+
+bool LogStorage::load(const QString& fileName, QVector<LogMessage*>& messages, QString* error)
+{
+    bool result = false;
+    {
+        auto db = QSqlDatabase::addDatabase("QSQLITE", LOAD_CONNECTION);
+        db.setDatabaseName(fileName);
+        if (db.open())
+        {
+            QSqlQuery query(db);
+            query.setForwardOnly(true);
+            // Files written before repeat folding have no repeats table, and
+            // those written before clock correction no clock table.
+            bool hasRepeats = db.tables().contains("repeats");
+            bool hasClock = db.tables().contains("clock");
+            result = query.exec(QString("SELECT m.time, m.pid, m.level, h.name, c.facility, c.object, m.message, p.process%1%2"
+                                " FROM messages AS m INNER JOIN hosts AS h ON m.host=h.id INNER JOIN channels AS c ON m.channel=c.id INNER JOIN processes AS p ON m.pid=p.id%3%4")
+                                .arg(hasRepeats ? ", r.count, r.last" : ", NULL, NULL")
+                                .arg(hasClock ? ", k.correction" : ", NULL")
+                                .arg(hasRepeats ? " LEFT JOIN repeats AS r ON r.message=m.rowid" : "")
+                                .arg(hasClock ? " LEFT JOIN clock AS k ON k.message=m.rowid" : ""));
+            while (result && query.next())
+            {
+                auto message = new LogMessage;
+                message->timestamp.setMSecsSinceEpoch(qint64(query.value(0).toDouble() * 1000));
+                message->pid = query.value(1).toULongLong();
+                message->severity = LogSeverity(query.value(2).toInt());
+                message->machineName = query.value(3).toString();
+                message->module = query.value(4).toString();
+                message->channel = query.value(5).toString();
+                message->message = query.value(6).toString();
+                message->executablePath = query.value(7).toString();
+                message->originalMessage = message->message;
+                message->isMultilineContinuation = false;
+                if (!query.isNull(8))
+                {
+                    message->repeatCount = query.value(8).toUInt();
+                    message->lastTimestamp.setMSecsSinceEpoch(qint64(query.value(9).toDouble() * 1000));
+                }
+                if (!query.isNull(10))
+                {
+                    message->clockOffset = query.value(10).toInt();
+                }
+                messages.append(message);
+            }
+        }
+        if (!result && error)
+        {
+            *error = db.lastError().text();
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(LOAD_CONNECTION);
+    return result;
+}
+
+bool LogStorage::save(const QVector<const LogMessage*>& messages, const QString& fileName)
+{
+    Profiler::Scope scope(Profiler::SECTION_SAVE_MODEL);
+    QTemporaryFile tempFile;
+    tempFile.open();
+
+    {
+        auto db = QSqlDatabase::addDatabase("QSQLITE", SAVE_CONNECTION);
+        db.setDatabaseName(tempFile.fileName());
+        auto success = db.open();
+        if (!success)
+        {
+            db = QSqlDatabase();
+            QSqlDatabase::removeDatabase(SAVE_CONNECTION);
+            return false;
+        }
+
+        auto check = [&](bool result)
+        {
+            if (!result)
+            {
+                auto e = db.lastError();
+                qDebug() << "Query failed: " << e.text() << e.nativeErrorCode();
+            }
+        };
+
+        check(QSqlQuery(db).exec("CREATE TABLE lsw(version INT)"));
+        check(QSqlQuery(db).exec("CREATE TABLE messages(time REAL, host INT, pid INT, level INT, channel INT, message TEXT)"));
+        check(QSqlQuery(db).exec("CREATE TABLE hosts(id INT,name TEXT)"));
+        check(QSqlQuery(db).exec("CREATE TABLE processes(id INT, module TEXT, process TEXT, host INT)"));
+        check(QSqlQuery(db).exec("CREATE TABLE channels(id INT,facility TEXT,object TEXT)"));
+        check(QSqlQuery(db).exec("CREATE TABLE repeats(message INT, count INT, last REAL)"));
+        // Milliseconds the time of a message was moved by to correct its
+        // client's clock; time - correction / 1000 is when the client sent it.
+        check(QSqlQuery(db).exec("CREATE TABLE clock(message INT, correction INT)"));
+        check(QSqlQuery(db).exec("CREATE VIEW log as "
+                  "select m.rowid, '' as timestamp, m.time, h.name as host, m.pid, m.level, m.level as type, p.module, c.facility || '-' || c.object as channel, m.message, p.process "
+                      "from messages as m, hosts as h, processes as p, channels as c "
+                      "where h.id = m.host and p.id = m.pid and c.id = m.channel"));
+
+
+
+        check(QSqlQuery(db).exec("INSERT INTO lsw VALUES (3)"));
+
+        int count = messages.size();
+        QMap<QString, int> hosts;
+        QMap<quint64, QString> processes;
+        QMap<QPair<QString, QString>, int> channels;
+
+        for (int i = 0; i < count; ++i)
+        {
+            auto message = messages[i];
+            if (!message || message->isMultilineContinuation)
+            {
+                continue;
+            }
+            if (hosts.find(message->machineName) == hosts.end())
+            {
+                hosts[message->machineName] = hosts.size() + 1;
+            }
+            processes[message->pid] = message->executablePath;
+            if (channels.find(QPair<QString, QString>(message->module, message->channel)) == channels.end())
+            {
+                channels[QPair<QString, QString>(message->module, message->channel)] = channels.size() + 1;
+            }
+        }
+
+        check(QSqlQuery(db).exec("BEGIN TRANSACTION"));
+        {
+            QSqlQuery q(db);
+            q.prepare("INSERT INTO hosts VALUES (?, ?)");
+
+            QVariantList ids;
+            QVariantList names;
+            for (auto it = hosts.begin(); it != hosts.end(); ++it)
+            {
+                ids << it.value();
+                names << it.key();
+            }
+            q.addBindValue(ids);
+            q.addBindValue(names);
+            check(q.execBatch());
+        }
+        {
+            QSqlQuery q(db);
+            q.prepare("INSERT INTO processes VALUES (?, ?, ?, ?)");
+
+            QVariantList ids;
+            QVariantList modules;
+            QVariantList process;
+            QVariantList hosts;
+            for (auto it = processes.begin(); it != processes.end(); ++it)
+            {
+                ids << it.key();
+                modules << "";
+                process << it.value();
+                hosts << 0;
+            }
+            q.addBindValue(ids);
+            q.addBindValue(modules);
+            q.addBindValue(process);
+            q.addBindValue(hosts);
+            check(q.execBatch());
+        }
+        {
+            QSqlQuery q(db);
+            q.prepare("INSERT INTO channels VALUES (?, ?, ?)");
+
+            QVariantList ids;
+            QVariantList facilities;
+            QVariantList objects;
+            for (auto it = channels.begin(); it != channels.end(); ++it)
+            {
+                ids << it.value();
+                facilities << it.key().first;
+                objects << it.key().second;
+            }
+            q.addBindValue(ids);
+            q.addBindValue(facilities);
+            q.addBindValue(objects);
+            check(q.execBatch());
+        }
+        {
+            QSqlQuery q(db);
+            q.prepare("INSERT INTO messages VALUES (?, ?, ?, ?, ?, ?)");
+
+            QVariantList time;
+            QVariantList host;
+            QVariantList pid;
+            QVariantList level;
+            QVariantList channel;
+            QVariantList message;
+            QVariantList repeatRows;
+            QVariantList repeatCounts;
+            QVariantList repeatLast;
+            QVariantList clockRows;
+            QVariantList clockOffsets;
+            for (int i = 0; i < count; ++i)
+            {
+                auto msg = messages[i];
+                if (!msg || msg->isMultilineContinuation)
+                {
+                    continue;
+                }
+                if (msg->repeatCount > 1)
+                {
+                    // Rowids of a fresh table follow insertion order from 1.
+                    repeatRows << time.size() + 1;
+                    repeatCounts << msg->repeatCount;
+                    repeatLast << double(msg->lastTimestamp.toMSecsSinceEpoch()) / 1000;
+                }
+                if (msg->clockOffset)
+                {
+                    clockRows << time.size() + 1;
+                    clockOffsets << msg->clockOffset;
+                }
+                time << double(msg->timestamp.toMSecsSinceEpoch()) / 1000;
+                host << hosts[msg->machineName];
+                pid << msg->pid;
+                level << msg->severity;
+                channel << channels[QPair<QString, QString>(msg->module, msg->channel)];
+                message << msg->originalMessage;
+            }
+            q.addBindValue(time);
+            q.addBindValue(host);
+            q.addBindValue(pid);
+            q.addBindValue(level);
+            q.addBindValue(channel);
+            q.addBindValue(message);
+            check(q.execBatch());
+
+            if (!repeatRows.isEmpty())
+            {
+                QSqlQuery r(db);
+                r.prepare("INSERT INTO repeats VALUES (?, ?, ?)");
+                r.addBindValue(repeatRows);
+                r.addBindValue(repeatCounts);
+                r.addBindValue(repeatLast);
+                check(r.execBatch());
+            }
+            if (!clockRows.isEmpty())
+            {
+                QSqlQuery k(db);
+                k.prepare("INSERT INTO clock VALUES (?, ?)");
+                k.addBindValue(clockRows);
+                k.addBindValue(clockOffsets);
+                check(k.execBatch());
+            }
+        }
+        check(QSqlQuery(db).exec("END TRANSACTION"));
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(SAVE_CONNECTION);
+
+    QFile dest(fileName);
+    if (dest.exists())
+    {
+        if (!dest.remove())
+        {
+            return false;
+        }
+    }
+    return tempFile.copy(fileName);
+}
+
+QString LogStorage::autoSaveFileName(const QString& directory)
+{
+    auto base = QString("%1%2%3.%4").arg(directory, QDir::separator(), QHostInfo::localHostName(), QDateTime::currentDateTime().toString("yyyy-MM-dd_HH.mm.ss"));
+    auto fileName = base + ".lsw";
+    for (int i = 1; QFile::exists(fileName); ++i)
+    {
+        fileName = QString("%1.%2.lsw").arg(base).arg(i);
+    }
+    return fileName;
+}
+
+bool LogStorage::autoSave(const QVector<const LogMessage*>& messages, const QString& directory)
+{
+    if (!QDir(directory).exists())
+    {
+        QDir().mkpath(directory);
+    }
+    return save(messages, autoSaveFileName(directory));
+}
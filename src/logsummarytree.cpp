@@ -0,0 +1,312 @@
+#include "logsummarytree.h"
+#include <QHash>
+#include <limits>
+
+namespace
+{
+
+quint64 pidBit(quint64 pid)
+{
+    return quint64(1) << (qHash(pid) % 64);
+}
+
+}
+
+LogSummaryTree::Summary::Summary()
+    : rows(0),
+      minTimestamp(std::numeric_limits<qint64>::max()),
+      maxTimestamp(std::numeric_limits<qint64>::min()),
+      pids(0)
+{
+    for (int i = 0; i < SEVERITY_COUNT; ++i)
+    {
+        counts[i] = 0;
+    }
+}
+
+void LogSummaryTree::Summary::add(LogSeverity severity, qint64 timestamp, quint64 pid)
+{
+    ++rows;
+    if (severity >= 0 && severity < SEVERITY_COUNT)
+    {
+        ++counts[severity];
+    }
+    minTimestamp = std::min(minTimestamp, timestamp);
+    maxTimestamp = std::max(maxTimestamp, timestamp);
+    pids |= pidBit(pid);
+}
+
+void LogSummaryTree::Summary::merge(const Summary& other)
+{
+    rows += other.rows;
+    for (int i = 0; i < SEVERITY_COUNT; ++i)
+    {
+        counts[i] += other.counts[i];
+    }
+    minTimestamp = std::min(minTimestamp, other.minTimestamp);
+    maxTimestamp = std::max(maxTimestamp, other.maxTimestamp);
+    pids |= other.pids;
+}
+
+LogSeverity LogSummaryTree::Summary::worstSeverity() const
+{
+    for (int i = SEVERITY_COUNT - 1; i > 0; --i)
+    {
+        if (counts[i])
+        {
+            return LogSeverity(i);
+        }
+    }
+    return SEVERITY_INFO;
+}
+
+bool LogSummaryTree::Summary::mayContainPid(quint64 pid) const
+{
+    return pids & pidBit(pid);
+}
+
+
+LogSummaryTree::LogSummaryTree(const QVector<LogMessage*>& messages)
+    : m_messages(messages),
+      m_rows(0)
+{
+    clear();
+}
+
+void LogSummaryTree::clear()
+{
+    m_levels.clear();
+    m_levels.append(QVector<Summary>());
+    m_rows = 0;
+}
+
+void LogSummaryTree::rebuild()
+{
+    clear();
+    for (int i = 0; i < m_messages.size(); ++i)
+    {
+        append(i);
+    }
+}
+
+void LogSummaryTree::append(int row)
+{
+    auto message = m_messages[row];
+    auto timestamp = message->timestamp.toMSecsSinceEpoch();
+    int index = row / BLOCK_SIZE;
+    for (int level = 0; level < m_levels.size(); ++level)
+    {
+        auto& nodes = m_levels[level];
+        if (index >= nodes.size())
+        {
+            nodes.resize(index + 1);
+        }
+        nodes[index].add(message->severity, timestamp, message->pid);
+        index /= FAN_OUT;
+    }
+    while (m_levels.last().size() > 1)
+    {
+        const auto& children = m_levels.last();
+        QVector<Summary> parents((children.size() + FAN_OUT - 1) / FAN_OUT);
+        for (int i = 0; i < children.size(); ++i)
+        {
+            parents[i / FAN_OUT].merge(children[i]);
+        }
+        m_levels.append(parents);
+    }
+    m_rows = row + 1;
+}
+
+int LogSummaryTree::size() const
+{
+    return m_rows;
+}
+
+bool LogSummaryTree::matches(int row, LogSeverity severity) const
+{
+    return m_messages[row]->severity == severity;
+}
+
+int LogSummaryTree::findNext(int row, LogSeverity severity) const
+{
+    if (row < 0)
+    {
+        row = 0;
+    }
+    if (row >= m_rows || severity < 0 || severity >= SEVERITY_COUNT)
+    {
+        return -1;
+    }
+    int block = row / BLOCK_SIZE;
+    int end = std::min((block + 1) * BLOCK_SIZE, m_rows);
+    for (int i = row; i < end; ++i)
+    {
+        if (matches(i, severity))
+        {
+            return i;
+        }
+    }
+
+    int level = 0;
+    int index = block + 1;
+    while (true)
+    {
+        if (index >= m_levels[level].size())
+        {
+            return -1;
+        }
+        if (m_levels[level][index].counts[severity])
+        {
+            break;
+        }
+        ++index;
+        if (index % FAN_OUT == 0 && level + 1 < m_levels.size())
+        {
+            index /= FAN_OUT;
+            ++level;
+        }
+    }
+    while (level > 0)
+    {
+        --level;
+        index *= FAN_OUT;
+        while (!m_levels[level][index].counts[severity])
+        {
+            ++index;
+        }
+    }
+    end = std::min((index + 1) * BLOCK_SIZE, m_rows);
+    for (int i = index * BLOCK_SIZE; i < end; ++i)
+    {
+        if (matches(i, severity))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int LogSummaryTree::findPrevious(int row, LogSeverity severity) const
+{
+    if (row >= m_rows)
+    {
+        row = m_rows - 1;
+    }
+    if (row < 0 || severity < 0 || severity >= SEVERITY_COUNT)
+    {
+        return -1;
+    }
+    int block = row / BLOCK_SIZE;
+    for (int i = row; i >= block * BLOCK_SIZE; --i)
+    {
+        if (matches(i, severity))
+        {
+            return i;
+        }
+    }
+
+    int level = 0;
+    int index = block - 1;
+    while (true)
+    {
+        if (index < 0)
+        {
+            return -1;
+        }
+        if (m_levels[level][index].counts[severity])
+        {
+            break;
+        }
+        if (index % FAN_OUT == 0 && level + 1 < m_levels.size())
+        {
+            index = index / FAN_OUT - 1;
+            ++level;
+        }
+        else
+        {
+            --index;
+        }
+    }
+    while (level > 0)
+    {
+        --level;
+        index = std::min(index * FAN_OUT + FAN_OUT - 1, int(m_levels[level].size()) - 1);
+        while (!m_levels[level][index].counts[severity])
+        {
+            --index;
+        }
+    }
+    int end = std::min((index + 1) * BLOCK_SIZE, m_rows);
+    for (int i = end - 1; i >= index * BLOCK_SIZE; --i)
+    {
+        if (matches(i, severity))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+LogSummaryTree::Summary LogSummaryTree::summarize(int first, int last) const
+{
+    Summary summary;
+    first = std::max(first, 0);
+    last = std::min(last, m_rows - 1);
+    if (first > last)
+    {
+        return summary;
+    }
+    int firstBlock = (first + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int lastBlock = (last + 1) / BLOCK_SIZE - 1;
+    if (firstBlock > lastBlock)
+    {
+        for (int i = first; i <= last; ++i)
+        {
+            auto message = m_messages[i];
+            summary.add(message->severity, message->timestamp.toMSecsSinceEpoch(), message->pid);
+        }
+        return summary;
+    }
+    for (int i = first; i < firstBlock * BLOCK_SIZE; ++i)
+    {
+        auto message = m_messages[i];
+        summary.add(message->severity, message->timestamp.toMSecsSinceEpoch(), message->pid);
+    }
+    collect(summary, 0, firstBlock, lastBlock);
+    for (int i = (lastBlock + 1) * BLOCK_SIZE; i <= last; ++i)
+    {
+        auto message = m_messages[i];
+        summary.add(message->severity, message->timestamp.toMSecsSinceEpoch(), message->pid);
+    }
+    return summary;
+}
+
+void LogSummaryTree::collect(Summary& summary, int level, int first, int last) const
+{
+    if (first > last)
+    {
+        return;
+    }
+    if (level + 1 < m_levels.size())
+    {
+        int parentFirst = (first + FAN_OUT - 1) / FAN_OUT;
+        int parentLast = (last + 1) / FAN_OUT - 1;
+        if (parentFirst <= parentLast)
+        {
+            for (int i = first; i < parentFirst * FAN_OUT; ++i)
+            {
+                summary.merge(m_levels[level][i]);
+            }
+            collect(summary, level + 1, parentFirst, parentLast);
+            for (int i = (parentLast + 1) * FAN_OUT; i <= last; ++i)
+            {
+                summary.merge(m_levels[level][i]);
+            }
+            return;
+        }
+    }
+    for (int i = first; i <= last; ++i)
+    {
+        summary.merge(m_levels[level][i]);
+    }
+}
@@ -35,38 +35,92 @@ const LogMessage* LogView::message(int row) const
     return source->message(filter->mapToSource(filter->index(row, 0)).row());
 }
 
-void LogView::nextSeverity(LogSeverity type)
+bool LogView::selectSourceRow(int row)
 {
-    auto selection = selectionModel()->currentIndex().row() + 1;
     auto filter = static_cast<QAbstractProxyModel*>(model());
-    auto count = filter->rowCount();
-    for (int i = 0; i < count; ++i)
+    auto index = filter->mapFromSource(sourceModel()->index(row, 0));
+    if (!index.isValid())
     {
-        auto msg = message(selection + i);
-        if (msg && msg->severity == type)
+        return false;
+    }
+    selectionModel()->setCurrentIndex(index, QItemSelectionModel::SelectCurrent | QItemSelectionModel::Rows);
+    return true;
+}
+
+void LogView::nextSeverity(LogSeverity type)
+{
+    auto filter = static_cast<LogFilter*>(model());
+    if (!filter->isSeverityVisible(type))
+    {
+        return;
+    }
+    auto& summary = sourceModel()->summary();
+    auto current = filter->mapToSource(selectionModel()->currentIndex()).row();
+    int row = current + 1;
+    while ((row = summary.findNext(row, type)) >= 0)
+    {
+        if (selectSourceRow(row))
+        {
+            return;
+        }
+        ++row;
+    }
+    row = 0;
+    while ((row = summary.findNext(row, type)) >= 0 && row <= current)
+    {
+        if (selectSourceRow(row))
         {
-            selectionModel()->setCurrentIndex(filter->index((selection + i) % count, 0),
-                                              QItemSelectionModel::SelectCurrent | QItemSelectionModel::Rows);
             return;
         }
+        ++row;
     }
 }
 
 void LogView::previousSeverity(LogSeverity type)
 {
-    auto filter = static_cast<QAbstractProxyModel*>(model());
-    auto count = filter->rowCount();
-    auto selection = selectionModel()->currentIndex().row() + count;
-    for (int i = 0; i < count; ++i)
+    auto filter = static_cast<LogFilter*>(model());
+    if (!filter->isSeverityVisible(type))
     {
-        auto msg = message((selection + count - 1 - i) % count);
-        if (msg && msg->severity == type)
+        return;
+    }
+    auto& summary = sourceModel()->summary();
+    auto current = filter->mapToSource(selectionModel()->currentIndex()).row();
+    if (current < 0 || current > summary.size())
+    {
+        current = summary.size();
+    }
+    int row = current - 1;
+    while ((row = summary.findPrevious(row, type)) >= 0)
+    {
+        if (selectSourceRow(row))
+        {
+            return;
+        }
+        --row;
+    }
+    row = summary.size() - 1;
+    while ((row = summary.findPrevious(row, type)) >= current)
+    {
+        if (selectSourceRow(row))
         {
-            selectionModel()->setCurrentIndex(filter->index((selection + count - 1 - i) % count, 0),
-                                              QItemSelectionModel::SelectCurrent | QItemSelectionModel::Rows);
             return;
         }
+        --row;
+    }
+}
+
+bool LogView::goToTimestamp(qint64 timestamp)
+{
+    auto& index = sourceModel()->timestampIndex();
+    // Rows of other runs after the first match may still be earlier.
+    for (int row = index.lowerBound(timestamp); row < index.size(); ++row)
+    {
+        if (index.timestamp(row) >= timestamp && selectSourceRow(row))
+        {
+            return true;
+        }
     }
+    return false;
 }
 
 void LogView::nextError()
@@ -4,6 +4,10 @@
 #include "logfilter.h"
 #include "overlaylayout.h"
 #include "logstatistics.h"
+#include "clientspanel.h"
+#include "diagnosticspanel.h"
+#include "patternspanel.h"
+#include "profiler.h"
 #include "logmonitorfilemodel.h"
 #include <QShortcut>
 #include <QMenu>
@@ -19,6 +23,14 @@
 #include <QFontDatabase>
 #include <QStandardPaths>
 #include <QStyleFactory>
+#include <QInputDialog>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QCheckBox>
+#include <QDateTimeEdit>
+#include <QDockWidget>
+#include <QPushButton>
 
 #include <QPainter>
 
@@ -39,6 +51,15 @@ const char* columnSettings[] = {
     "columns/message",
 };
 
+LogModel::OverloadPolicy overloadPolicy(const QSettings& settings)
+{
+    LogModel::OverloadPolicy policy;
+    policy.maxBacklog = settings.value("overload/maxBacklog", policy.maxBacklog).toInt();
+    policy.maxLag = settings.value("overload/maxLag", policy.maxLag).toInt();
+    policy.sampleInterval = settings.value("overload/sampleInterval", policy.sampleInterval).toInt();
+    return policy;
+}
+
 struct PathRec
 {
     QString path;
@@ -156,6 +177,12 @@ MainWindow::MainWindow(const QString &fileName, QWidget *parent) :
         }
         logModel->setMaxMessages(settings.value("maxMessages", 10000).toInt());
         logModel->setServerMode(settings.value("serverMode", false).toBool());
+        logModel->setClientRateLimit(settings.value("clientRateLimit", 0).toInt());
+        logModel->setDatagramsEnabled(settings.value("acceptDatagrams", false).toBool());
+        logModel->setUpstream(settings.value("relayUpstream").toString());
+        logModel->setReorderDelay(settings.value("reorderDelay", 0).toInt());
+        logModel->setClockCorrection(settings.value("correctClocks", true).toBool());
+        logModel->setOverloadPolicy(overloadPolicy(settings));
         setWindowTitle(windowTitle().arg(model->isListening() ? "Listening" : "Not listening"));
 
         connect(ui->actionDisconnectAll, &QAction::triggered, logModel, &LogModel::disconnectAll);
@@ -292,6 +319,8 @@ MainWindow::MainWindow(const QString &fileName, QWidget *parent) :
     connect(ui->actionPreviousWarning, &QAction::triggered, ui->tableView, &LogView::previousWarning);
     connect(ui->actionNextNotice, &QAction::triggered, ui->tableView, &LogView::nextNotice);
     connect(ui->actionPreviousNotice, &QAction::triggered, ui->tableView, &LogView::previousNotice);
+    connect(ui->actionGoToTime, &QAction::triggered, this, &MainWindow::goToTime);
+    connect(ui->actionTimeRange, &QAction::triggered, this, &MainWindow::editTimeRange);
 
     connect(ui->actionClear, &QAction::triggered, model, &AbstractLogModel::clear);
 
@@ -300,6 +329,9 @@ MainWindow::MainWindow(const QString &fileName, QWidget *parent) :
     connect(ui->actionSplitByPIDs, &QAction::triggered, this, &MainWindow::splitByPids);
     ui->actionSplitByPIDs->setChecked(settings.value("splitByPids").toBool());
     splitByPids();
+    connect(ui->actionFoldRepeats, &QAction::triggered, this, &MainWindow::foldRepeats);
+    ui->actionFoldRepeats->setChecked(settings.value("foldRepeats").toBool());
+    foldRepeats();
     connect(ui->actionSettings, &QAction::triggered, this, &MainWindow::showSettings);
     connect(ui->actionAboutLogLite, &QAction::triggered, this, &MainWindow::showAboutDialog);
 
@@ -343,6 +375,39 @@ MainWindow::MainWindow(const QString &fileName, QWidget *parent) :
     m_stats->setModel(model);
     ui->statusBar->addPermanentWidget(m_stats);
 
+    auto diagnostics = new QDockWidget("Diagnostics", this);
+    diagnostics->setObjectName("diagnosticsDock");
+    diagnostics->setWidget(new DiagnosticsPanel(diagnostics));
+    diagnostics->hide();
+    addDockWidget(Qt::BottomDockWidgetArea, diagnostics);
+    auto diagnosticsAction = diagnostics->toggleViewAction();
+    diagnosticsAction->setText("&Diagnostics");
+    diagnosticsAction->setShortcut(QKeySequence("Ctrl+Shift+P"));
+    ui->menu_View->insertAction(ui->actionSettings, diagnosticsAction);
+
+    if (auto logModel = dynamic_cast<LogModel*>(model))
+    {
+        auto clients = new QDockWidget("Clients", this);
+        clients->setObjectName("clientsDock");
+        clients->setWidget(new ClientsPanel(logModel, clients));
+        clients->hide();
+        addDockWidget(Qt::BottomDockWidgetArea, clients);
+        auto clientsAction = clients->toggleViewAction();
+        clientsAction->setText("&Clients");
+        clientsAction->setShortcut(QKeySequence("Ctrl+Shift+L"));
+        ui->menu_View->insertAction(ui->actionSettings, clientsAction);
+    }
+
+    auto patterns = new QDockWidget("Patterns", this);
+    patterns->setObjectName("patternsDock");
+    patterns->setWidget(new PatternsPanel(filtered, patterns));
+    patterns->hide();
+    addDockWidget(Qt::BottomDockWidgetArea, patterns);
+    auto patternsAction = patterns->toggleViewAction();
+    patternsAction->setText("P&atterns");
+    patternsAction->setShortcut(QKeySequence("Ctrl+Shift+T"));
+    ui->menu_View->insertAction(ui->actionSettings, patternsAction);
+
     ui->splitter->setCollapsible(0, false);
 
     restoreGeometry(settings.value("geometry").toByteArray());
@@ -462,6 +527,11 @@ void MainWindow::itemMenu(QPoint pos)
         {
             menu->addSeparator();
         }
+        if (message->repeatCount > 1)
+        {
+            menu->addAction(QString("Expand %1 Repeats").arg(message->repeatCount), this, &MainWindow::expandRepeats);
+            menu->addSeparator();
+        }
         if (auto logModel = dynamic_cast<LogModel*>(ui->tableView->sourceModel()))
         {
             LogModel::Client client;
@@ -496,6 +566,7 @@ void MainWindow::textFilterChanged()
 void MainWindow::textFilterTimeout()
 {
     m_quickFilterEdited.stop();
+    Profiler::Scope scope(Profiler::SECTION_FILTER_INVALIDATE);
     static_cast<LogFilter*>(ui->tableView->model())->setFilterFixedString(ui->textFilter->text());
 }
 
@@ -578,7 +649,9 @@ void MainWindow::openFilePath(QString fileName)
     if (model && !model->isListening())
     {
         auto newModel = new LogMonitorFileModel(fileName, this);
-        static_cast<LogFilter*>(ui->tableView->model())->setSourceModel(newModel);
+        auto filter = static_cast<LogFilter*>(ui->tableView->model());
+        filter->setTemplateFilter(-1);
+        filter->setSourceModel(newModel);
         m_stats->setModel(newModel);
         setWindowTitle(QString("LogLite - %1").arg(QFileInfo(fileName).fileName()));
     }
@@ -656,6 +729,87 @@ void MainWindow::findPrevious()
     ui->tableView->selectPreviousMatching(ui->searchText->text());
 }
 
+void MainWindow::goToTime()
+{
+    auto& summary = ui->tableView->sourceModel()->summary();
+    if (!summary.size())
+    {
+        return;
+    }
+    auto current = ui->tableView->message(ui->tableView->currentIndex().row());
+    auto reference = current ? current->timestamp :
+                               QDateTime::fromMSecsSinceEpoch(summary.summarize(0, summary.size() - 1).maxTimestamp);
+    bool ok;
+    auto text = QInputDialog::getText(this, "Go To Time", "Time (hh:mm:ss.zzz or yyyy-MM-dd hh:mm:ss.zzz)",
+                                      QLineEdit::Normal, reference.toString("hh:mm:ss"), &ok);
+    if (!ok || text.isEmpty())
+    {
+        return;
+    }
+    auto time = Filter::parseDateTime(text, reference.date());
+    if (!time.isValid())
+    {
+        QMessageBox msg(this);
+        msg.setIcon(QMessageBox::Warning);
+        msg.setText("Invalid time");
+        msg.setInformativeText(QString("Could not parse time %1").arg(text));
+        msg.exec();
+        return;
+    }
+    if (!ui->tableView->goToTimestamp(time.toMSecsSinceEpoch()))
+    {
+        ui->statusBar->showMessage(QString("No messages after %1").arg(time.toString("yyyy-MM-dd hh:mm:ss.zzz")), 5000);
+    }
+}
+
+void MainWindow::editTimeRange()
+{
+    auto filter = static_cast<LogFilter*>(ui->tableView->model());
+    auto& summary = ui->tableView->sourceModel()->summary();
+    auto bounds = summary.summarize(0, summary.size() - 1);
+    auto first = bounds.rows ? QDateTime::fromMSecsSinceEpoch(bounds.minTimestamp) : QDateTime::currentDateTime();
+    auto last = bounds.rows ? QDateTime::fromMSecsSinceEpoch(bounds.maxTimestamp) : first;
+
+    QDialog dlg(this);
+    dlg.setWindowTitle("Time Range");
+    auto layout = new QFormLayout(&dlg);
+
+    auto fromEnabled = new QCheckBox("From", &dlg);
+    auto from = new QDateTimeEdit(filter->timeRangeFrom().isValid() ? filter->timeRangeFrom() : first, &dlg);
+    from->setDisplayFormat("yyyy-MM-dd hh:mm:ss.zzz");
+    from->setCalendarPopup(true);
+    from->setEnabled(filter->timeRangeFrom().isValid());
+    fromEnabled->setChecked(filter->timeRangeFrom().isValid());
+    connect(fromEnabled, &QCheckBox::toggled, from, &QWidget::setEnabled);
+    layout->addRow(fromEnabled, from);
+
+    auto toEnabled = new QCheckBox("To", &dlg);
+    auto to = new QDateTimeEdit(filter->timeRangeTo().isValid() ? filter->timeRangeTo() : last, &dlg);
+    to->setDisplayFormat("yyyy-MM-dd hh:mm:ss.zzz");
+    to->setCalendarPopup(true);
+    to->setEnabled(filter->timeRangeTo().isValid());
+    toEnabled->setChecked(filter->timeRangeTo().isValid());
+    connect(toEnabled, &QCheckBox::toggled, to, &QWidget::setEnabled);
+    layout->addRow(toEnabled, to);
+
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel | QDialogButtonBox::Reset, &dlg);
+    connect(buttons, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+    connect(buttons->button(QDialogButtonBox::Reset), &QPushButton::clicked, &dlg, [=]()
+    {
+        fromEnabled->setChecked(false);
+        toEnabled->setChecked(false);
+    });
+    layout->addRow(buttons);
+
+    if (dlg.exec() == QDialog::Accepted)
+    {
+        filter->setTimeRange(fromEnabled->isChecked() ? from->dateTime() : QDateTime(),
+                             toEnabled->isChecked() ? to->dateTime() : QDateTime());
+    }
+    ui->actionTimeRange->setChecked(filter->hasTimeRange());
+}
+
 void MainWindow::setServerMode()
 {
     auto model = dynamic_cast<LogModel*>(ui->tableView->sourceModel());
@@ -674,6 +828,20 @@ void MainWindow::splitByPids()
     ui->tableView->horizontalHeader()->setSectionResizeMode(6, split ? QHeaderView::Interactive : QHeaderView::Stretch);
 }
 
+void MainWindow::foldRepeats()
+{
+    bool fold = ui->actionFoldRepeats->isChecked();
+    ui->tableView->sourceModel()->setFoldRepeats(fold);
+    QSettings().setValue("foldRepeats", fold);
+}
+
+void MainWindow::expandRepeats()
+{
+    auto filter = static_cast<LogFilter*>(ui->tableView->model());
+    auto row = filter->mapToSource(ui->tableView->selectionModel()->currentIndex()).row();
+    ui->tableView->sourceModel()->expandRepeats(row);
+}
+
 void MainWindow::showSettings()
 {
     SettingsDialog dlg(this);
@@ -694,6 +862,12 @@ void MainWindow::showSettings()
                 {
                     logModel->setAutoSaveDirectory(settings.value("autoSaveDirectory").toString());
                     logModel->setMaxMessages(settings.value("maxMessages").toInt());
+                    logModel->setClientRateLimit(settings.value("clientRateLimit", 0).toInt());
+                    logModel->setDatagramsEnabled(settings.value("acceptDatagrams", false).toBool());
+                    logModel->setUpstream(settings.value("relayUpstream").toString());
+                    logModel->setReorderDelay(settings.value("reorderDelay", 0).toInt());
+                    logModel->setClockCorrection(settings.value("correctClocks", true).toBool());
+                    logModel->setOverloadPolicy(overloadPolicy(settings));
                 }
                 model->setTimestampPrecision(TimestampPrecision(settings.value("timestampPrecision", 0).toInt()));
                 wnd->m_monospaceFont = settings.value("monospaceFont", 0).toBool();
@@ -946,7 +1120,7 @@ void MainWindow::buildClientsMenu()
             {
                 break;
             }
-            ui->menuHighlights->removeAction(*it);
+            ui->menu_Disconnect_Client->removeAction(*it);
             delete *it;
         }
         auto& clients = model->clients();
@@ -954,7 +1128,16 @@ void MainWindow::buildClientsMenu()
         for (auto it = clients.begin(); it != clients.end(); ++it)
         {
             auto path = metrics.elidedText(it->path(), Qt::ElideMiddle, 200);
-            auto name = QString("[%1] %2").arg(it->pid()).arg(path);
+            auto clientMetrics = model->clientMetrics(*it);
+            auto name = QString("[%1] %2\t%3 msg/s, %4/s, backlog %5%6%7%8")
+                    .arg(it->pid())
+                    .arg(path)
+                    .arg(clientMetrics.messagesPerSecond, 0, 'f', 0)
+                    .arg(ClientsPanel::formatBytes(clientMetrics.bytesPerSecond))
+                    .arg(ClientsPanel::formatBytes(double(clientMetrics.backlog + clientMetrics.reassemblyBytes)))
+                    .arg(clientMetrics.throttled ? ", throttled" : "")
+                    .arg(clientMetrics.datagram ? ", UDP" : "")
+                    .arg(it->relay().socket() ? QString(", via %1").arg(it->relay().machine()) : QString());
             auto action = new QAction(name, this);
             action->setProperty("socket", quint64(it->socket()));
             connect(action, &QAction::triggered, this, &MainWindow::disconnectClient);
@@ -968,7 +1151,7 @@ void MainWindow::disconnectClient()
     if (auto model = dynamic_cast<LogModel*>(ui->tableView->sourceModel()))
     {
         auto action = static_cast<QAction*>(sender());
-        auto socket = reinterpret_cast<QTcpSocket*>(action->property("socket").toULongLong());
+        auto socket = reinterpret_cast<QIODevice*>(action->property("socket").toULongLong());
         model->disconnect(LogModel::Client(socket));
     }
 }
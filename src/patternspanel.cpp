@@ -0,0 +1,261 @@
+#include "patternspanel.h"
+#include "abstractlogmodel.h"
+#include "logfilter.h"
+#include <QAbstractTableModel>
+#include <QBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QSortFilterProxyModel>
+#include <QTableView>
+
+namespace
+{
+
+enum Column
+{
+    COLUMN_COUNT,
+    COLUMN_TEMPLATE,
+    COLUMN_FIRST,
+    COLUMN_LAST,
+
+    COLUMN_TOTAL,
+};
+
+const int ID_ROLE = Qt::UserRole + 1;
+
+QString formatTime(qint64 msecs)
+{
+    return QDateTime::fromMSecsSinceEpoch(msecs).toString("yyyy-MM-dd HH:mm:ss.zzz");
+}
+
+}
+
+
+class PatternTableModel : public QAbstractTableModel
+{
+public:
+    PatternTableModel(QObject *parent)
+        :QAbstractTableModel(parent)
+    {
+    }
+
+    void setTemplates(const QVector<LogPatterns::Template>& templates)
+    {
+        beginResetModel();
+        m_templates = templates;
+        endResetModel();
+    }
+
+    int rowCount(const QModelIndex &parent) const
+    {
+        return parent.isValid() ? 0 : m_templates.size();
+    }
+
+    int columnCount(const QModelIndex &parent) const
+    {
+        return parent.isValid() ? 0 : COLUMN_TOTAL;
+    }
+
+    QVariant data(const QModelIndex &index, int role) const
+    {
+        if (!index.isValid() || index.row() >= m_templates.size())
+        {
+            return QVariant();
+        }
+        auto& pattern = m_templates[index.row()];
+        if (role == ID_ROLE)
+        {
+            return index.row();
+        }
+        if (role == Qt::TextAlignmentRole && index.column() == COLUMN_COUNT)
+        {
+            return int(Qt::AlignRight | Qt::AlignVCenter);
+        }
+        if (role != Qt::DisplayRole && role != Qt::UserRole)
+        {
+            return QVariant();
+        }
+        bool sortKey = role == Qt::UserRole;
+        switch (index.column())
+        {
+        case COLUMN_COUNT:
+            return sortKey ? QVariant(pattern.count) : QVariant(QString::number(pattern.count));
+        case COLUMN_TEMPLATE:
+            return pattern.text;
+        case COLUMN_FIRST:
+            return sortKey ? QVariant(pattern.first) : QVariant(formatTime(pattern.first));
+        case COLUMN_LAST:
+            return sortKey ? QVariant(pattern.last) : QVariant(formatTime(pattern.last));
+        }
+        return QVariant();
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const
+    {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        {
+            return QVariant();
+        }
+        const char* labels[] = {"Count", "Template", "First Seen", "Last Seen"};
+        return section >= 0 && section < COLUMN_TOTAL ? labels[section] : QVariant();
+    }
+private:
+    QVector<LogPatterns::Template> m_templates;
+};
+
+
+PatternsPanel::PatternsPanel(LogFilter *filter, QWidget *parent)
+    :QWidget(parent),
+      m_filter(filter),
+      m_dirty(true)
+{
+    auto layout = new QBoxLayout(QBoxLayout::TopToBottom);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    m_search = new QLineEdit(this);
+    m_search->setPlaceholderText("Search templates");
+    m_search->setClearButtonEnabled(true);
+    layout->addWidget(m_search);
+
+    m_patterns = new PatternTableModel(this);
+    m_sorted = new QSortFilterProxyModel(this);
+    m_sorted->setSourceModel(m_patterns);
+    m_sorted->setSortRole(Qt::UserRole);
+    m_sorted->setFilterKeyColumn(COLUMN_TEMPLATE);
+    m_sorted->setFilterCaseSensitivity(Qt::CaseInsensitive);
+    connect(m_search, &QLineEdit::textChanged, m_sorted, &QSortFilterProxyModel::setFilterFixedString);
+
+    m_table = new QTableView(this);
+    m_table->setModel(m_sorted);
+    m_table->setSortingEnabled(true);
+    m_table->sortByColumn(COLUMN_COUNT, Qt::DescendingOrder);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_table->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_table->setWordWrap(false);
+    m_table->verticalHeader()->hide();
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_table->horizontalHeader()->setSectionResizeMode(COLUMN_TEMPLATE, QHeaderView::Stretch);
+    connect(m_table->selectionModel(), &QItemSelectionModel::selectionChanged, this, &PatternsPanel::updateButtons);
+    connect(m_table, &QTableView::doubleClicked, this, &PatternsPanel::filterSelected);
+    layout->addWidget(m_table);
+
+    auto buttons = new QBoxLayout(QBoxLayout::LeftToRight);
+    m_status = new QLabel(this);
+    buttons->addWidget(m_status);
+    buttons->addStretch();
+    m_filterButton = new QPushButton("Filter by Template", this);
+    connect(m_filterButton, &QPushButton::clicked, this, &PatternsPanel::filterSelected);
+    buttons->addWidget(m_filterButton);
+    m_showAll = new QPushButton("Show All", this);
+    connect(m_showAll, &QPushButton::clicked, this, &PatternsPanel::showAll);
+    buttons->addWidget(m_showAll);
+    layout->addLayout(buttons);
+
+    setLayout(layout);
+
+    connect(m_filter, &QAbstractProxyModel::sourceModelChanged, this, &PatternsPanel::sourceModelChanged);
+    connect(&m_updateTimer, &QTimer::timeout, this, &PatternsPanel::updatePatterns);
+    sourceModelChanged();
+}
+
+void PatternsPanel::showEvent(QShowEvent *event)
+{
+    if (m_model)
+    {
+        m_model->patterns()->setEnabled(true);
+    }
+    m_updateTimer.start(1000);
+    updatePatterns();
+    QWidget::showEvent(event);
+}
+
+void PatternsPanel::hideEvent(QHideEvent *event)
+{
+    m_updateTimer.stop();
+    QWidget::hideEvent(event);
+}
+
+int PatternsPanel::selectedTemplate() const
+{
+    auto rows = m_table->selectionModel()->selectedRows();
+    return rows.isEmpty() ? -1 : rows.first().data(ID_ROLE).toInt();
+}
+
+void PatternsPanel::sourceModelChanged()
+{
+    if (m_model)
+    {
+        disconnect(m_model->patterns(), nullptr, this, nullptr);
+    }
+    m_model = static_cast<AbstractLogModel*>(m_filter->sourceModel());
+    if (m_model)
+    {
+        connect(m_model->patterns(), &LogPatterns::templatesChanged, this, &PatternsPanel::markDirty);
+        if (isVisible())
+        {
+            m_model->patterns()->setEnabled(true);
+        }
+    }
+    markDirty();
+    updatePatterns();
+}
+
+void PatternsPanel::markDirty()
+{
+    m_dirty = true;
+}
+
+void PatternsPanel::updatePatterns()
+{
+    if (!m_dirty || !isVisible())
+    {
+        updateButtons();
+        return;
+    }
+    m_dirty = false;
+
+    auto selected = selectedTemplate();
+    auto patterns = m_model ? m_model->patterns() : nullptr;
+    m_patterns->setTemplates(patterns ? patterns->templates() : QVector<LogPatterns::Template>());
+    if (selected >= 0)
+    {
+        auto index = m_sorted->mapFromSource(m_patterns->index(selected, 0));
+        if (index.isValid())
+        {
+            m_table->selectRow(index.row());
+        }
+    }
+
+    auto status = QString("%1 templates").arg(m_patterns->rowCount(QModelIndex()));
+    if (patterns && patterns->pendingRows() > 0)
+    {
+        status += QString(", %1 rows pending").arg(patterns->pendingRows());
+    }
+    m_status->setText(status);
+    updateButtons();
+}
+
+void PatternsPanel::updateButtons()
+{
+    m_filterButton->setEnabled(selectedTemplate() >= 0);
+    m_showAll->setEnabled(m_filter->templateFilter() >= 0);
+}
+
+void PatternsPanel::filterSelected()
+{
+    auto id = selectedTemplate();
+    if (id >= 0)
+    {
+        m_filter->setTemplateFilter(id);
+    }
+    updateButtons();
+}
+
+void PatternsPanel::showAll()
+{
+    m_filter->setTemplateFilter(-1);
+    updateButtons();
+}
@@ -0,0 +1,191 @@
+#include "profiler.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+
+double Profiler::Statistics::meanNanoseconds() const
+{
+    return timedCalls ? double(totalNanoseconds) / timedCalls : 0;
+}
+
+double Profiler::Statistics::percentileNanoseconds(double fraction) const
+{
+    if (!timedCalls)
+    {
+        return 0;
+    }
+    quint64 target = quint64(fraction * timedCalls);
+    quint64 seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        seen += histogram[i];
+        if (seen > target)
+        {
+            // Report the middle of the bucket, which is within a factor of
+            // 1.5 of any duration in it.
+            return 1.5 * double(quint64(1) << i);
+        }
+    }
+    return double(maxNanoseconds);
+}
+
+
+Profiler::Profiler()
+    :m_enabled(false),
+      m_traceNext(0)
+{
+    for (int i = 0; i < SECTION_COUNT; ++i)
+    {
+        m_counters[i].calls = 0;
+    }
+    reset();
+}
+
+Profiler& Profiler::instance()
+{
+    static Profiler s_profiler;
+    return s_profiler;
+}
+
+const char* Profiler::sectionName(Section section)
+{
+    static const char* s_names[] = {
+        "readMessages",
+        "addMessage",
+        "filterInvalidate",
+        "paintMap",
+        "saveModel",
+        "data",
+    };
+    return s_names[section];
+}
+
+qint64 Profiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::record(Section section, qint64 start, qint64 duration)
+{
+    auto& counters = m_counters[section];
+    auto nanoseconds = quint64(std::max<qint64>(duration, 0));
+    counters.timedCalls.fetch_add(1, std::memory_order_relaxed);
+    counters.totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    auto max = counters.maxNanoseconds.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !counters.maxNanoseconds.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+    int bucket = 0;
+    while (bucket + 1 < HISTOGRAM_BUCKETS && (nanoseconds >> (bucket + 1)))
+    {
+        ++bucket;
+    }
+    counters.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    // data() is called for every visible cell, tracing it would only
+    // push everything else out of the buffer.
+    if (section == SECTION_DATA)
+    {
+        return;
+    }
+    TraceEvent event = {section, start, duration, quint64(quintptr(QThread::currentThreadId()))};
+    QMutexLocker lock(&m_traceMutex);
+    if (m_trace.size() < MAX_TRACE_EVENTS)
+    {
+        m_trace.append(event);
+    }
+    else
+    {
+        m_trace[m_traceNext] = event;
+    }
+    m_traceNext = (m_traceNext + 1) % MAX_TRACE_EVENTS;
+}
+
+void Profiler::reset()
+{
+    for (int i = 0; i < SECTION_COUNT; ++i)
+    {
+        auto& counters = m_counters[i];
+        counters.timedCalls = 0;
+        counters.totalNanoseconds = 0;
+        counters.maxNanoseconds = 0;
+        for (int j = 0; j < HISTOGRAM_BUCKETS; ++j)
+        {
+            counters.histogram[j] = 0;
+        }
+    }
+    QMutexLocker lock(&m_traceMutex);
+    m_trace.clear();
+    m_traceNext = 0;
+}
+
+Profiler::Statistics Profiler::statistics(Section section) const
+{
+    auto& counters = m_counters[section];
+    Statistics result;
+    result.calls = counters.calls.load(std::memory_order_relaxed);
+    result.timedCalls = counters.timedCalls.load(std::memory_order_relaxed);
+    result.totalNanoseconds = counters.totalNanoseconds.load(std::memory_order_relaxed);
+    result.maxNanoseconds = counters.maxNanoseconds.load(std::memory_order_relaxed);
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        result.histogram[i] = counters.histogram[i].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+bool Profiler::exportTrace(const QString& fileName) const
+{
+    auto pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+    {
+        QMutexLocker lock(&m_traceMutex);
+        int first = m_trace.size() < MAX_TRACE_EVENTS ? 0 : m_traceNext;
+        for (int i = 0; i < m_trace.size(); ++i)
+        {
+            auto& event = m_trace[(first + i) % m_trace.size()];
+            QJsonObject object;
+            object["name"] = sectionName(event.section);
+            object["cat"] = "loglite";
+            object["ph"] = "X";
+            object["ts"] = event.start / 1000.0;
+            object["dur"] = event.duration / 1000.0;
+            object["pid"] = pid;
+            object["tid"] = double(event.thread);
+            events.append(object);
+        }
+    }
+    QJsonObject counters;
+    for (int i = 0; i < SECTION_COUNT; ++i)
+    {
+        counters[sectionName(Section(i))] = double(statistics(Section(i)).calls);
+    }
+    QJsonObject counterEvent;
+    counterEvent["name"] = "calls";
+    counterEvent["ph"] = "C";
+    counterEvent["ts"] = now() / 1000.0;
+    counterEvent["pid"] = pid;
+    counterEvent["args"] = counters;
+    events.append(counterEvent);
+
+    QJsonObject trace;
+    trace["traceEvents"] = events;
+    trace["displayTimeUnit"] = "ms";
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    return file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) >= 0;
+}
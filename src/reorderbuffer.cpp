@@ -0,0 +1,194 @@
+#include "reorderbuffer.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+const qint64 EARLIEST = std::numeric_limits<qint64>::min();
+const qint64 LATEST = std::numeric_limits<qint64>::max();
+
+}
+
+ReorderBuffer::Stream::Stream()
+    : latest(EARLIEST),
+      lastArrival(0),
+      released(EARLIEST)
+{
+}
+
+ReorderBuffer::ReorderBuffer()
+    : m_maxDelay(0),
+      m_size(0),
+      m_late(0)
+{
+}
+
+ReorderBuffer::~ReorderBuffer()
+{
+    for (auto it = m_streams.begin(); it != m_streams.end(); ++it)
+    {
+        for (auto entry = it->entries.begin(); entry != it->entries.end(); ++entry)
+        {
+            delete entry->message;
+        }
+    }
+}
+
+void ReorderBuffer::setMaxDelay(int milliseconds)
+{
+    m_maxDelay = std::max(milliseconds, 0);
+}
+
+int ReorderBuffer::maxDelay() const
+{
+    return m_maxDelay;
+}
+
+void ReorderBuffer::add(LogMessage* message, qint64 now)
+{
+    Entry entry = {message->timestamp.toMSecsSinceEpoch(), now, message};
+    auto key = qMakePair(message->machineName, message->pid);
+    auto& stream = m_streams[key];
+    stream.latest = std::max(stream.latest, entry.timestamp);
+    stream.lastArrival = now;
+    if (entry.timestamp < stream.released)
+    {
+        ++m_late;
+    }
+    // A client's own messages are nearly always in order, so this is
+    // usually an append.
+    if (stream.entries.empty() || stream.entries.back().timestamp <= entry.timestamp)
+    {
+        stream.entries.push_back(entry);
+    }
+    else
+    {
+        auto position = std::upper_bound(stream.entries.begin(), stream.entries.end(), entry.timestamp,
+                                         [](qint64 timestamp, const Entry& other)
+        {
+            return timestamp < other.timestamp;
+        });
+        stream.entries.insert(position, entry);
+    }
+    Arrival arrival = {now, entry.timestamp, key};
+    m_arrivals.push_back(arrival);
+    ++m_size;
+}
+
+void ReorderBuffer::take(qint64 now, QVector<LogMessage*>& messages)
+{
+    // A client that has sent a later message will not send an earlier one.
+    // Clients quiet for the whole delay no longer hold the others back.
+    auto watermark = LATEST;
+    auto highest = EARLIEST;
+    auto secondHighest = EARLIEST;
+    StreamKey highestStream;
+    for (auto it = m_streams.begin(); it != m_streams.end();)
+    {
+        bool quiet = it->lastArrival + m_maxDelay <= now;
+        if (quiet && it->entries.empty())
+        {
+            it = m_streams.erase(it);
+            continue;
+        }
+        if (!quiet)
+        {
+            watermark = std::min(watermark, it->latest);
+            if (it->latest > highest)
+            {
+                secondHighest = highest;
+                highest = it->latest;
+                highestStream = it.key();
+            }
+            else
+            {
+                secondHighest = std::max(secondHighest, it->latest);
+            }
+        }
+        ++it;
+    }
+    // Messages that have waited the delay go out with everything up to
+    // them, but no further than another client has got.
+    auto due = EARLIEST;
+    while (!m_arrivals.empty() && m_arrivals.front().time + m_maxDelay <= now)
+    {
+        auto& arrival = m_arrivals.front();
+        auto others = arrival.stream == highestStream ? secondHighest : highest;
+        due = std::max(due, others == EARLIEST ? arrival.timestamp : std::min(arrival.timestamp, others));
+        m_arrivals.pop_front();
+    }
+    release(std::max(due, watermark == LATEST ? EARLIEST : watermark), messages);
+    // What waited the delay but is still ahead of every other client is
+    // all that is left. It goes out merged like the rest, along with what
+    // has not waited but comes before it.
+    auto waited = EARLIEST;
+    for (auto it = m_streams.begin(); it != m_streams.end(); ++it)
+    {
+        for (auto entry = it->entries.begin(); entry != it->entries.end() && entry->arrival + m_maxDelay <= now; ++entry)
+        {
+            waited = std::max(waited, entry->timestamp);
+        }
+    }
+    if (waited != EARLIEST)
+    {
+        release(waited, messages);
+    }
+}
+
+void ReorderBuffer::takeAll(QVector<LogMessage*>& messages)
+{
+    release(LATEST, messages);
+    m_arrivals.clear();
+    m_streams.clear();
+}
+
+int ReorderBuffer::size() const
+{
+    return m_size;
+}
+
+quint64 ReorderBuffer::late() const
+{
+    return m_late;
+}
+
+void ReorderBuffer::release(qint64 bound, QVector<LogMessage*>& messages)
+{
+    typedef QPair<qint64, Stream*> Head;
+    auto later = [](const Head& a, const Head& b)
+    {
+        return a.first > b.first;
+    };
+    std::vector<Head> heads;
+    for (auto it = m_streams.begin(); it != m_streams.end(); ++it)
+    {
+        if (!it->entries.empty() && it->entries.front().timestamp <= bound)
+        {
+            heads.push_back(qMakePair(it->entries.front().timestamp, &(*it)));
+        }
+    }
+    std::make_heap(heads.begin(), heads.end(), later);
+    while (!heads.empty())
+    {
+        std::pop_heap(heads.begin(), heads.end(), later);
+        auto stream = heads.back().second;
+        heads.pop_back();
+        releaseFront(*stream, messages);
+        if (!stream->entries.empty() && stream->entries.front().timestamp <= bound)
+        {
+            heads.push_back(qMakePair(stream->entries.front().timestamp, stream));
+            std::push_heap(heads.begin(), heads.end(), later);
+        }
+    }
+}
+
+void ReorderBuffer::releaseFront(Stream& stream, QVector<LogMessage*>& messages)
+{
+    auto& entry = stream.entries.front();
+    messages.append(entry.message);
+    stream.released = std::max(stream.released, entry.timestamp);
+    stream.entries.pop_front();
+    --m_size;
+}
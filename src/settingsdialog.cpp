@@ -1,5 +1,6 @@
 #include "settingsdialog.h"
 #include "ui_settingsdialog.h"
+#include "logmodel.h"
 #include <QSettings>
 #include <QStandardPaths>
 #include <QFileDialog>
@@ -26,6 +27,15 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
     }
     ui->timestampFormat->setCurrentIndex(settings.value("timestampPrecision", 0).toInt());
     ui->monospaceFont->setChecked(settings.value("monospaceFont", 0).toBool());
+    ui->clientRateLimit->setValue(settings.value("clientRateLimit", 0).toInt());
+    ui->acceptDatagrams->setChecked(settings.value("acceptDatagrams", false).toBool());
+    ui->relayUpstream->setText(settings.value("relayUpstream").toString());
+    ui->reorderDelay->setValue(settings.value("reorderDelay", 0).toInt());
+    ui->correctClocks->setChecked(settings.value("correctClocks", true).toBool());
+    LogModel::OverloadPolicy overload;
+    ui->overloadBacklog->setValue(settings.value("overload/maxBacklog", overload.maxBacklog).toInt());
+    ui->overloadLag->setValue(settings.value("overload/maxLag", overload.maxLag).toInt());
+    ui->overloadSampleInterval->setValue(settings.value("overload/sampleInterval", overload.sampleInterval).toInt());
 
     connect(ui->browseAutoSave, &QPushButton::clicked, this, &SettingsDialog::browseForAutoSaveDirectory);
 }
@@ -59,6 +69,14 @@ void SettingsDialog::accept()
     settings.setValue("autoSaveDirectory", ui->autoSaveDirectory->text());
     settings.setValue("timestampPrecision", ui->timestampFormat->currentIndex());
     settings.setValue("monospaceFont", ui->monospaceFont->isChecked());
+    settings.setValue("clientRateLimit", ui->clientRateLimit->value());
+    settings.setValue("acceptDatagrams", ui->acceptDatagrams->isChecked());
+    settings.setValue("relayUpstream", ui->relayUpstream->text().trimmed());
+    settings.setValue("reorderDelay", ui->reorderDelay->value());
+    settings.setValue("correctClocks", ui->correctClocks->isChecked());
+    settings.setValue("overload/maxBacklog", ui->overloadBacklog->value());
+    settings.setValue("overload/maxLag", ui->overloadLag->value());
+    settings.setValue("overload/sampleInterval", ui->overloadSampleInterval->value());
     QDialog::accept();
 }
 
@@ -0,0 +1,166 @@
+#include "sharedring.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+using namespace LogProtocol;
+
+namespace
+{
+
+qint64 ringBytes(quint32 capacity)
+{
+    return qint64(sizeof(SharedRingHeader)) + qint64(capacity) * qint64(sizeof(RawLogMessage));
+}
+
+}
+
+
+SharedRing::SharedRing()
+    :m_header(nullptr),
+      m_frames(nullptr),
+      m_capacity(0)
+{
+}
+
+SharedRing::~SharedRing()
+{
+    detach();
+}
+
+bool SharedRing::create(const QString& key, quint32 capacity)
+{
+    detach();
+    if (!capacity || capacity > MAX_CAPACITY)
+    {
+        m_error = "Invalid capacity";
+        return false;
+    }
+    m_memory.setKey(key);
+    if (!m_memory.create(ringBytes(capacity)))
+    {
+        m_error = m_memory.errorString();
+        return false;
+    }
+    auto header = new (m_memory.data()) SharedRingHeader;
+    header->capacity = capacity;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    header->magic = SharedRingHeader::MAGIC;
+    return map(capacity);
+}
+
+bool SharedRing::attach(const QString& key, quint32 capacity)
+{
+    detach();
+    if (!capacity || capacity > MAX_CAPACITY)
+    {
+        m_error = "Invalid capacity";
+        return false;
+    }
+    m_memory.setKey(key);
+    if (!m_memory.attach())
+    {
+        m_error = m_memory.errorString();
+        return false;
+    }
+    // The segment comes from another process, so check it really is a ring
+    // of the size we were told before trusting any of it.
+    auto header = static_cast<const SharedRingHeader*>(m_memory.constData());
+    if (m_memory.size() < ringBytes(capacity) || header->magic != SharedRingHeader::MAGIC || header->capacity != capacity)
+    {
+        m_error = "Not a ring of the expected size";
+        m_memory.detach();
+        return false;
+    }
+    return map(capacity);
+}
+
+bool SharedRing::map(quint32 capacity)
+{
+    m_header = static_cast<SharedRingHeader*>(m_memory.data());
+    m_frames = reinterpret_cast<RawLogMessage*>(static_cast<char*>(m_memory.data()) + sizeof(SharedRingHeader));
+    m_capacity = capacity;
+    m_error.clear();
+    return true;
+}
+
+void SharedRing::detach()
+{
+    if (m_memory.isAttached())
+    {
+        m_memory.detach();
+    }
+    m_header = nullptr;
+    m_frames = nullptr;
+    m_capacity = 0;
+}
+
+bool SharedRing::isAttached() const
+{
+    return m_header;
+}
+
+QString SharedRing::key() const
+{
+    return m_memory.key();
+}
+
+quint32 SharedRing::capacity() const
+{
+    return m_capacity;
+}
+
+QString SharedRing::errorString() const
+{
+    return m_error;
+}
+
+quint32 SharedRing::write(const RawLogMessage* frames, quint32 count)
+{
+    if (!m_header)
+    {
+        return 0;
+    }
+    auto head = m_header->head.load(std::memory_order_relaxed);
+    auto tail = m_header->tail.load(std::memory_order_acquire);
+    count = std::min(count, m_capacity - quint32(head - tail));
+    auto offset = quint32(head % m_capacity);
+    auto first = std::min(count, m_capacity - offset);
+    memcpy(m_frames + offset, frames, first * sizeof(RawLogMessage));
+    memcpy(m_frames, frames + first, (count - first) * sizeof(RawLogMessage));
+    m_header->head.store(head + count, std::memory_order_release);
+    return count;
+}
+
+quint64 SharedRing::size() const
+{
+    if (!m_header)
+    {
+        return 0;
+    }
+    auto head = m_header->head.load(std::memory_order_acquire);
+    auto tail = m_header->tail.load(std::memory_order_relaxed);
+    // head is written by the other process; never read past the ring.
+    return std::min<quint64>(head - tail, m_capacity);
+}
+
+const RawLogMessage* SharedRing::read(quint32& count) const
+{
+    if (!m_header)
+    {
+        count = 0;
+        return nullptr;
+    }
+    auto offset = quint32(m_header->tail.load(std::memory_order_relaxed) % m_capacity);
+    count = quint32(std::min<quint64>(size(), m_capacity - offset));
+    return m_frames + offset;
+}
+
+void SharedRing::release(quint32 count)
+{
+    if (m_header)
+    {
+        m_header->tail.fetch_add(count, std::memory_order_release);
+    }
+}
@@ -0,0 +1,171 @@
+#include "templateminer.h"
+
+namespace
+{
+
+bool isVariable(QStringView token)
+{
+    for (auto it = token.begin(); it != token.end(); ++it)
+    {
+        if (it->isDigit())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+const QString TemplateMiner::WILDCARD = "<*>";
+
+TemplateMiner::TemplateMiner(double similarity, int prefixDepth)
+    :m_similarity(similarity),
+      m_prefixDepth(prefixDepth)
+{
+}
+
+int TemplateMiner::add(const QString& message, bool* changed)
+{
+    tokenize(message);
+    auto& leaf = m_leaves[leafKey()];
+
+    int best = -1;
+    double bestSimilarity = -1;
+    int bestWildcards = -1;
+    for (auto it = leaf.begin(); it != leaf.end(); ++it)
+    {
+        int wildcards;
+        auto value = similarity(m_clusters[*it], wildcards);
+        if (value > bestSimilarity || (value == bestSimilarity && wildcards > bestWildcards))
+        {
+            best = *it;
+            bestSimilarity = value;
+            bestWildcards = wildcards;
+        }
+    }
+
+    if (best < 0 || bestSimilarity < m_similarity)
+    {
+        Cluster cluster;
+        cluster.wildcards = 0;
+        cluster.tokens.reserve(m_tokens.size());
+        for (auto it = m_tokens.begin(); it != m_tokens.end(); ++it)
+        {
+            bool variable = isVariable(*it);
+            cluster.tokens.append(variable ? WILDCARD : it->toString());
+            cluster.wildcards += variable;
+        }
+        m_clusters.append(cluster);
+        leaf.append(m_clusters.size() - 1);
+        if (changed)
+        {
+            *changed = true;
+        }
+        return m_clusters.size() - 1;
+    }
+
+    auto& cluster = m_clusters[best];
+    bool generalised = false;
+    for (int i = 0; i < m_tokens.size(); ++i)
+    {
+        auto& token = cluster.tokens[i];
+        if (token != WILDCARD && (isVariable(m_tokens[i]) || token != m_tokens[i]))
+        {
+            token = WILDCARD;
+            ++cluster.wildcards;
+            generalised = true;
+        }
+    }
+    if (changed)
+    {
+        *changed = generalised;
+    }
+    return best;
+}
+
+int TemplateMiner::size() const
+{
+    return m_clusters.size();
+}
+
+QString TemplateMiner::text(int id) const
+{
+    if (id < 0 || id >= m_clusters.size())
+    {
+        return QString();
+    }
+    auto& tokens = m_clusters[id].tokens;
+    QString result;
+    for (int i = 0; i < tokens.size(); ++i)
+    {
+        if (i)
+        {
+            result.append(' ');
+        }
+        result.append(tokens[i]);
+    }
+    return result;
+}
+
+void TemplateMiner::clear()
+{
+    m_clusters.clear();
+    m_leaves.clear();
+}
+
+void TemplateMiner::tokenize(const QString& message)
+{
+    m_tokens.clear();
+    int start = -1;
+    for (int i = 0; i <= message.size(); ++i)
+    {
+        bool space = i == message.size() || message[i].isSpace();
+        if (space && start >= 0)
+        {
+            m_tokens.append(QStringView(message).mid(start, i - start));
+            start = -1;
+        }
+        else if (!space && start < 0)
+        {
+            start = i;
+        }
+    }
+}
+
+QString TemplateMiner::leafKey() const
+{
+    auto key = QString::number(m_tokens.size());
+    for (int i = 0; i < m_prefixDepth && i < m_tokens.size(); ++i)
+    {
+        key.append(QChar(0x1f));
+        if (isVariable(m_tokens[i]))
+        {
+            key.append(WILDCARD);
+        }
+        else
+        {
+            key.append(m_tokens[i]);
+        }
+    }
+    return key;
+}
+
+double TemplateMiner::similarity(const Cluster& cluster, int& wildcards) const
+{
+    wildcards = cluster.wildcards;
+    if (m_tokens.isEmpty())
+    {
+        return 1;
+    }
+    int equal = 0;
+    for (int i = 0; i < m_tokens.size(); ++i)
+    {
+        auto& token = cluster.tokens[i];
+        if (token != WILDCARD && token == m_tokens[i])
+        {
+            ++equal;
+        }
+    }
+    return double(equal) / m_tokens.size();
+}
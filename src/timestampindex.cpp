@@ -0,0 +1,136 @@
+#include "timestampindex.h"
+#include <algorithm>
+
+TimestampIndex::TimestampIndex(const QVector<LogMessage*>& messages)
+    : m_messages(messages),
+      m_generation(0)
+{
+}
+
+void TimestampIndex::clear()
+{
+    m_timestamps.clear();
+    m_runs.clear();
+    m_unorderedFirst.clear();
+    m_unorderedLast.clear();
+    ++m_generation;
+}
+
+void TimestampIndex::rebuild()
+{
+    clear();
+    m_timestamps.reserve(m_messages.size());
+    for (int i = 0; i < m_messages.size(); ++i)
+    {
+        append(i);
+    }
+}
+
+void TimestampIndex::append(int row)
+{
+    auto timestamp = m_messages[row]->timestamp.toMSecsSinceEpoch();
+    m_timestamps.append(timestamp);
+
+    Run* best = nullptr;
+    for (auto it = m_runs.begin(); it != m_runs.end(); ++it)
+    {
+        auto last = m_timestamps[it->last()];
+        if (last <= timestamp && (!best || m_timestamps[best->last()] < last))
+        {
+            best = &(*it);
+        }
+    }
+    if (best)
+    {
+        best->append(row);
+    }
+    else if (m_runs.size() < MAX_RUNS)
+    {
+        m_runs.append(Run(1, row));
+    }
+    else
+    {
+        // Rows come in ascending order, so the new one is the first row only
+        // after the latest timestamp so far, and the last row in place of all
+        // kept ones not before it.
+        if (m_unorderedFirst.isEmpty() || m_timestamps[m_unorderedFirst.last()] < timestamp)
+        {
+            m_unorderedFirst.append(row);
+        }
+        while (!m_unorderedLast.isEmpty() && m_timestamps[m_unorderedLast.last()] >= timestamp)
+        {
+            m_unorderedLast.removeLast();
+        }
+        m_unorderedLast.append(row);
+    }
+}
+
+int TimestampIndex::size() const
+{
+    return m_timestamps.size();
+}
+
+bool TimestampIndex::isSynchronized() const
+{
+    return m_timestamps.size() == m_messages.size();
+}
+
+int TimestampIndex::generation() const
+{
+    return m_generation;
+}
+
+qint64 TimestampIndex::timestamp(int row) const
+{
+    return m_timestamps[row];
+}
+
+int TimestampIndex::lowerBound(qint64 timestamp) const
+{
+    int result = m_timestamps.size();
+    for (auto it = m_runs.begin(); it != m_runs.end(); ++it)
+    {
+        auto found = std::lower_bound(it->begin(), it->end(), timestamp, [&](int row, qint64 value)
+        {
+            return m_timestamps[row] < value;
+        });
+        if (found != it->end())
+        {
+            result = std::min(result, *found);
+        }
+    }
+    auto found = std::lower_bound(m_unorderedFirst.begin(), m_unorderedFirst.end(), timestamp, [&](int row, qint64 value)
+    {
+        return m_timestamps[row] < value;
+    });
+    if (found != m_unorderedFirst.end())
+    {
+        result = std::min(result, *found);
+    }
+    return result;
+}
+
+int TimestampIndex::upperBound(qint64 timestamp) const
+{
+    int result = -1;
+    for (auto it = m_runs.begin(); it != m_runs.end(); ++it)
+    {
+        auto found = std::upper_bound(it->begin(), it->end(), timestamp, [&](qint64 value, int row)
+        {
+            return value < m_timestamps[row];
+        });
+        if (found != it->begin())
+        {
+            result = std::max(result, *(found - 1));
+        }
+    }
+    auto found = std::upper_bound(m_unorderedLast.begin(), m_unorderedLast.end(), timestamp, [&](qint64 value, int row)
+    {
+        return value < m_timestamps[row];
+    });
+    if (found != m_unorderedLast.begin())
+    {
+        result = std::max(result, *(found - 1));
+    }
+    return result;
+}
@@ -0,0 +1,499 @@
+#include "loadgenerator.h"
+#include "sharedring.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDateTime>
+#include <QHostInfo>
+#include <QLocalSocket>
+#include <QStringList>
+#include <QTcpSocket>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace LogProtocol;
+
+namespace
+{
+
+const qint64 MAX_PENDING_BYTES = 1024 * 1024;
+const qint64 MAX_BATCH = 1024;
+
+const char* s_words[] = {
+    "client", "server", "frame", "update", "request", "response", "entity", "buffer",
+    "texture", "network", "session", "packet", "state", "timeout", "resource", "load",
+};
+
+const char* s_modules[] = {
+    "loadgen", "network", "render", "audio",
+};
+
+const char* s_channels[] = {
+    "general", "io", "timing", "memory",
+};
+
+template<typename T, size_t N>
+int arraySize(T (&)[N])
+{
+    return N;
+}
+
+void copyString(char* destination, size_t size, const QByteArray& source)
+{
+    auto length = std::min(size - 1, size_t(source.size()));
+    memcpy(destination, source.constData(), length);
+    destination[length] = 0;
+}
+
+bool isUnconnected(QIODevice* socket)
+{
+    if (auto local = qobject_cast<QLocalSocket*>(socket))
+    {
+        return local->state() == QLocalSocket::UnconnectedState;
+    }
+    return static_cast<QTcpSocket*>(socket)->state() == QAbstractSocket::UnconnectedState;
+}
+
+}
+
+LoadGenerator::Settings::Settings()
+    :host("127.0.0.1"),
+      port(DEFAULT_PORT),
+      connections(1),
+      messagesPerConnection(10000),
+      rate(0),
+      minSize(32),
+      maxSize(128),
+      sizeDistribution(SIZE_UNIFORM),
+      multilineRatio(0.05),
+      severityMix{70, 20, 8, 2},
+      stampLatency(false),
+      seed(1),
+      firstPid(0),
+      ringCapacity(0)
+{
+}
+
+
+LoadGenerator::LoadGenerator(const Settings& settings, QObject* parent)
+    :QObject(parent),
+      m_settings(settings),
+      m_random(settings.seed),
+      m_timer(this),
+      m_sentMessages(0),
+      m_sentBytes(0),
+      m_running(false)
+{
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &LoadGenerator::tick);
+}
+
+LoadGenerator::~LoadGenerator()
+{
+    qDeleteAll(m_replay);
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        delete it->ring;
+    }
+}
+
+void LoadGenerator::setReplayMessages(const QVector<LogMessage*>& messages)
+{
+    qDeleteAll(m_replay);
+    m_replay = messages;
+}
+
+qint64 LoadGenerator::sentMessages() const
+{
+    return m_sentMessages;
+}
+
+qint64 LoadGenerator::sentBytes() const
+{
+    return m_sentBytes;
+}
+
+qint64 LoadGenerator::elapsed() const
+{
+    return m_clock.isValid() ? m_clock.elapsed() : 0;
+}
+
+qint64 LoadGenerator::steadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool LoadGenerator::parseLatencyStamp(const QString& text, qint64& nanoseconds)
+{
+    if (!text.startsWith('#'))
+    {
+        return false;
+    }
+    auto end = text.indexOf(' ');
+    if (end < 0)
+    {
+        end = text.size();
+    }
+    bool ok = false;
+    nanoseconds = QStringView(text).mid(1, end - 1).toLongLong(&ok);
+    return ok;
+}
+
+bool LoadGenerator::parseSizeDistribution(const QString& text, SizeDistribution& distribution)
+{
+    if (text == "fixed")
+    {
+        distribution = SIZE_FIXED;
+    }
+    else if (text == "uniform")
+    {
+        distribution = SIZE_UNIFORM;
+    }
+    else if (text == "exponential")
+    {
+        distribution = SIZE_EXPONENTIAL;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool LoadGenerator::parseSeverityMix(const QString& text, double* mix)
+{
+    auto parts = text.split(',');
+    if (parts.size() != SEVERITY_COUNT)
+    {
+        return false;
+    }
+    double total = 0;
+    for (int i = 0; i < SEVERITY_COUNT; ++i)
+    {
+        bool ok = false;
+        mix[i] = parts[i].toDouble(&ok);
+        if (!ok || mix[i] < 0)
+        {
+            return false;
+        }
+        total += mix[i];
+    }
+    return total > 0;
+}
+
+void LoadGenerator::start()
+{
+    if (m_running)
+    {
+        return;
+    }
+    m_running = true;
+    auto machineName = QHostInfo::localHostName().toLocal8Bit();
+    auto executablePath = QCoreApplication::applicationFilePath().toLocal8Bit();
+    auto firstPid = m_settings.firstPid ? m_settings.firstPid : quint64(QCoreApplication::applicationPid()) * 1000;
+    for (int i = 0; i < m_settings.connections; ++i)
+    {
+        Connection connection;
+        connection.pid = firstPid + i;
+        connection.sent = 0;
+        connection.replayIndex = i;
+        connection.ring = nullptr;
+        connection.awaitingRing = false;
+        if (m_settings.localName.isEmpty())
+        {
+            auto socket = new QTcpSocket(this);
+            socket->connectToHost(m_settings.host, m_settings.port);
+            connection.socket = socket;
+        }
+        else
+        {
+            auto socket = new QLocalSocket(this);
+            socket->connectToServer(m_settings.localName);
+            connection.socket = socket;
+        }
+
+        RawLogMessage msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.type = CONNECTION_MESSAGE;
+        msg.connection.version = VERSION;
+        msg.connection.pid = connection.pid;
+        copyString(msg.connection.machineName, sizeof(msg.connection.machineName), machineName);
+        copyString(msg.connection.executablePath, sizeof(msg.connection.executablePath), executablePath);
+        connection.socket->write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+
+        if (m_settings.ringCapacity)
+        {
+            auto key = QString("loglite-%1-%2-%3").arg(QCoreApplication::applicationPid()).arg(connection.pid).arg(m_random.generate());
+            connection.ring = new SharedRing;
+            if (connection.ring->create(key, m_settings.ringCapacity))
+            {
+                memset(&msg, 0, sizeof(msg));
+                msg.type = SHARED_MEMORY_MESSAGE;
+                msg.sharedMemory.capacity = m_settings.ringCapacity;
+                copyString(msg.sharedMemory.key, sizeof(msg.sharedMemory.key), key.toLatin1());
+                connection.socket->write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+                connection.awaitingRing = true;
+            }
+            else
+            {
+                qWarning() << "Could not create shared memory ring:" << connection.ring->errorString();
+                delete connection.ring;
+                connection.ring = nullptr;
+            }
+        }
+        m_connections.append(connection);
+    }
+    m_clock.start();
+    m_timer.start(1);
+}
+
+void LoadGenerator::stop()
+{
+    if (!m_running)
+    {
+        return;
+    }
+    m_running = false;
+    m_timer.stop();
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        if (auto local = qobject_cast<QLocalSocket*>(it->socket))
+        {
+            local->disconnectFromServer();
+        }
+        else
+        {
+            static_cast<QTcpSocket*>(it->socket)->disconnectFromHost();
+        }
+    }
+    emit finished();
+}
+
+void LoadGenerator::tick()
+{
+    bool done = true;
+    double seconds = m_clock.nsecsElapsed() / 1e9;
+    qint64 total = m_settings.messagesPerConnection > 0 ? m_settings.messagesPerConnection : std::numeric_limits<qint64>::max();
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+    {
+        auto& connection = *it;
+        if (isUnconnected(connection.socket))
+        {
+            continue;
+        }
+        if (connection.awaitingRing && !readRingReply(connection))
+        {
+            done = false;
+            continue;
+        }
+        bool exhausted = connection.sent >= total ||
+                (m_settings.messagesPerConnection <= 0 && !m_replay.isEmpty() && connection.replayIndex >= m_replay.size());
+        if (!exhausted)
+        {
+            qint64 target = total;
+            if (m_settings.rate > 0)
+            {
+                target = std::min(target, qint64(m_settings.rate / m_settings.connections * seconds));
+            }
+            if (connection.sent < target && !writeMessages(connection, std::min(target - connection.sent, MAX_BATCH)))
+            {
+                continue;
+            }
+            done = false;
+        }
+        else if (connection.socket->bytesToWrite() > 0 || pendingBytes(connection) > 0 ||
+                 (connection.ring && connection.ring->size() > 0))
+        {
+            flushRing(connection);
+            done = false;
+        }
+    }
+    if (done)
+    {
+        stop();
+    }
+}
+
+bool LoadGenerator::readRingReply(Connection& connection)
+{
+    char reply;
+    if (connection.socket->read(&reply, 1) != 1)
+    {
+        return false;
+    }
+    connection.awaitingRing = false;
+    if (reply != SHARED_MEMORY_ACCEPTED)
+    {
+        qWarning() << "Server rejected the shared memory ring, sending over TCP";
+        delete connection.ring;
+        connection.ring = nullptr;
+    }
+    return true;
+}
+
+void LoadGenerator::flushRing(Connection& connection)
+{
+    if (!connection.ring || connection.overflow.isEmpty())
+    {
+        return;
+    }
+    auto frames = quint32(connection.overflow.size() / qint64(sizeof(RawLogMessage)));
+    auto written = connection.ring->write(reinterpret_cast<const RawLogMessage*>(connection.overflow.constData()), frames);
+    connection.overflow.remove(0, qsizetype(written) * qsizetype(sizeof(RawLogMessage)));
+}
+
+qint64 LoadGenerator::pendingBytes(const Connection& connection) const
+{
+    return connection.ring ? connection.overflow.size() : connection.socket->bytesToWrite();
+}
+
+bool LoadGenerator::writeMessages(Connection& connection, qint64 count)
+{
+    flushRing(connection);
+    QByteArray buffer;
+    for (qint64 i = 0; i < count && pendingBytes(connection) + buffer.size() < MAX_PENDING_BYTES; ++i)
+    {
+        QByteArray text;
+        if (m_replay.isEmpty())
+        {
+            text = synthesizeText();
+            appendMessage(buffer, synthesizeSeverity(), s_modules[m_random.bounded(arraySize(s_modules))],
+                          s_channels[m_random.bounded(arraySize(s_channels))], text, QDateTime::currentMSecsSinceEpoch());
+        }
+        else
+        {
+            if (connection.replayIndex >= m_replay.size())
+            {
+                if (m_settings.messagesPerConnection <= 0)
+                {
+                    break;
+                }
+                connection.replayIndex %= m_replay.size();
+            }
+            auto message = m_replay[connection.replayIndex];
+            connection.replayIndex += m_settings.connections;
+            text = message->originalMessage.toUtf8();
+            if (m_settings.stampLatency)
+            {
+                text.prepend(QByteArray("#") + QByteArray::number(steadyNanoseconds()) + ' ');
+            }
+            appendMessage(buffer, message->severity, message->module.toLocal8Bit(), message->channel.toLocal8Bit(),
+                          text, message->timestamp.toMSecsSinceEpoch());
+        }
+        ++connection.sent;
+        ++m_sentMessages;
+    }
+    if (buffer.isEmpty())
+    {
+        return !isUnconnected(connection.socket);
+    }
+    m_sentBytes += buffer.size();
+    if (connection.ring)
+    {
+        connection.overflow.append(buffer);
+        flushRing(connection);
+        return true;
+    }
+    return connection.socket->write(buffer) == buffer.size();
+}
+
+void LoadGenerator::appendMessage(QByteArray& buffer, LogSeverity severity, const QByteArray& module, const QByteArray& channel, const QByteArray& text, qint64 timestamp) const
+{
+    const int chunkSize = int(TextMessage::TEXT_SIZE) - 1;
+    RawLogMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.text.timestamp = quint64(timestamp);
+    msg.text.severity = severity;
+    copyString(msg.text.module, sizeof(msg.text.module), module);
+    copyString(msg.text.channel, sizeof(msg.text.channel), channel);
+    int offset = 0;
+    do
+    {
+        auto chunk = text.mid(offset, chunkSize);
+        bool first = offset == 0;
+        offset += chunkSize;
+        bool last = offset >= text.size();
+        if (first)
+        {
+            msg.type = last ? SIMPLE_MESSAGE : LARGE_MESSAGE;
+        }
+        else
+        {
+            msg.type = last ? CONTINUATION_END_MESSAGE : CONTINUATION_MESSAGE;
+        }
+        memset(msg.text.message, 0, sizeof(msg.text.message));
+        memcpy(msg.text.message, chunk.constData(), chunk.size());
+        buffer.append(reinterpret_cast<const char*>(&msg), sizeof(msg));
+    }
+    while (offset < text.size());
+}
+
+QByteArray LoadGenerator::synthesizeText()
+{
+    int size = m_settings.minSize;
+    switch (m_settings.sizeDistribution)
+    {
+    case SIZE_UNIFORM:
+        size = m_settings.minSize + m_random.bounded(std::max(1, m_settings.maxSize - m_settings.minSize + 1));
+        break;
+    case SIZE_EXPONENTIAL:
+    {
+        double mean = std::max(1.0, (m_settings.maxSize - m_settings.minSize) / 4.0);
+        size = m_settings.minSize + int(-mean * std::log(1.0 - m_random.generateDouble()));
+        size = std::min(size, m_settings.maxSize);
+        break;
+    }
+    default:
+        break;
+    }
+
+    QByteArray text;
+    text.reserve(size + 32);
+    if (m_settings.stampLatency)
+    {
+        text.append('#');
+        text.append(QByteArray::number(steadyNanoseconds()));
+        text.append(' ');
+    }
+    int prefix = text.size();
+    int lines = m_random.generateDouble() < m_settings.multilineRatio ? 2 + m_random.bounded(4) : 1;
+    int lineLength = std::max(1, size / lines);
+    int lineStart = text.size();
+    while (text.size() - prefix < size)
+    {
+        if (text.size() - lineStart >= lineLength && lines > 1)
+        {
+            --lines;
+            text.append('\n');
+            lineStart = text.size();
+        }
+        else if (text.size() > lineStart)
+        {
+            text.append(' ');
+        }
+        text.append(s_words[m_random.bounded(arraySize(s_words))]);
+    }
+    text.truncate(prefix + size);
+    return text;
+}
+
+LogSeverity LoadGenerator::synthesizeSeverity()
+{
+    double total = 0;
+    for (int i = 0; i < SEVERITY_COUNT; ++i)
+    {
+        total += m_settings.severityMix[i];
+    }
+    double value = m_random.generateDouble() * total;
+    for (int i = 0; i < SEVERITY_COUNT; ++i)
+    {
+        value -= m_settings.severityMix[i];
+        if (value < 0)
+        {
+            return LogSeverity(i);
+        }
+    }
+    return SEVERITY_INFO;
+}
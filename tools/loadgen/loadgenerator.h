@@ -0,0 +1,102 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTimer>
+#include <QVector>
+#include "logmessage.h"
+#include "logprotocol.h"
+
+class QIODevice;
+class SharedRing;
+
+
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum SizeDistribution
+    {
+        SIZE_FIXED,
+        SIZE_UNIFORM,
+        SIZE_EXPONENTIAL,
+    };
+
+    struct Settings
+    {
+        Settings();
+
+        QString host;
+        quint16 port;
+        // Connect to this local socket instead of host and port when set.
+        QString localName;
+        int connections;
+        qint64 messagesPerConnection;
+        double rate;
+        int minSize;
+        int maxSize;
+        SizeDistribution sizeDistribution;
+        double multilineRatio;
+        double severityMix[SEVERITY_COUNT];
+        bool stampLatency;
+        quint32 seed;
+        quint64 firstPid;
+        // Offer the server a shared memory ring of this many frames instead
+        // of sending messages over the socket; zero for plain TCP.
+        quint32 ringCapacity;
+    };
+
+    LoadGenerator(const Settings& settings, QObject* parent = nullptr);
+    ~LoadGenerator();
+
+    void setReplayMessages(const QVector<LogMessage*>& messages);
+
+    qint64 sentMessages() const;
+    qint64 sentBytes() const;
+    qint64 elapsed() const;
+
+    static qint64 steadyNanoseconds();
+    static bool parseLatencyStamp(const QString& text, qint64& nanoseconds);
+    static bool parseSizeDistribution(const QString& text, SizeDistribution& distribution);
+    static bool parseSeverityMix(const QString& text, double* mix);
+public slots:
+    void start();
+    void stop();
+signals:
+    void finished();
+private:
+    struct Connection
+    {
+        QIODevice* socket;
+        quint64 pid;
+        qint64 sent;
+        qint64 replayIndex;
+        SharedRing* ring;
+        bool awaitingRing;
+        QByteArray overflow;
+    };
+
+    void tick();
+    bool readRingReply(Connection& connection);
+    void flushRing(Connection& connection);
+    qint64 pendingBytes(const Connection& connection) const;
+    bool writeMessages(Connection& connection, qint64 count);
+    void appendMessage(QByteArray& buffer, LogSeverity severity, const QByteArray& module, const QByteArray& channel, const QByteArray& text, qint64 timestamp) const;
+    QByteArray synthesizeText();
+    LogSeverity synthesizeSeverity();
+
+    Settings m_settings;
+    QVector<Connection> m_connections;
+    QVector<LogMessage*> m_replay;
+    QRandomGenerator m_random;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_sentMessages;
+    qint64 m_sentBytes;
+    bool m_running;
+};
+
+#endif // LOADGENERATOR_H
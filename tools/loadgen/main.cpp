@@ -0,0 +1,104 @@
+#include "loadgenerator.h"
+#include "logstorage.h"
+#include "sharedring.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QTextStream>
+#include <algorithm>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    a.setApplicationName("loglite-loadgen");
+    a.setApplicationVersion(APP_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Synthesizes or replays LogLite protocol traffic");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption hostOption("host", "Server to connect to.", "host", "127.0.0.1");
+    QCommandLineOption portOption(QStringList() << "p" << "port", "Server port.", "port", QString::number(LogProtocol::DEFAULT_PORT));
+    QCommandLineOption connectionsOption(QStringList() << "c" << "connections", "Number of concurrent connections.", "count", "1");
+    QCommandLineOption messagesOption(QStringList() << "n" << "messages", "Messages per connection, 0 to run until stopped (or once through a replay file).", "count", "10000");
+    QCommandLineOption rateOption(QStringList() << "r" << "rate", "Total messages per second over all connections, 0 for unthrottled.", "rate", "0");
+    QCommandLineOption sizeOption(QStringList() << "s" << "size", "Message size in bytes as min[:max].", "size", "32:128");
+    QCommandLineOption distributionOption("size-distribution", "fixed, uniform or exponential.", "distribution", "uniform");
+    QCommandLineOption multilineOption("multiline", "Fraction of messages containing line breaks.", "ratio", "0.05");
+    QCommandLineOption severityOption("severity-mix", "Relative weights of info,notice,warning,error.", "weights", "70,20,8,2");
+    QCommandLineOption stampOption("stamp", "Prefix messages with a steady clock stamp for latency measurement.");
+    QCommandLineOption replayOption("replay", "Replay the messages of an .lsw file instead of synthesizing them.", "file");
+    QCommandLineOption seedOption("seed", "Random seed.", "seed", "1");
+    QCommandLineOption localOption("local", "Connect to the local socket of this name instead of host and port.", "name");
+    QCommandLineOption sharedMemoryOption("shared-memory", "Send through a shared memory ring of this many frames instead of TCP (local servers only).", "frames");
+    parser.addOptions({hostOption, portOption, connectionsOption, messagesOption, rateOption, sizeOption, distributionOption,
+                       multilineOption, severityOption, stampOption, replayOption, seedOption, localOption, sharedMemoryOption});
+    parser.process(a);
+
+    LoadGenerator::Settings settings;
+    bool ok = true;
+    auto check = [&](bool valid, const QCommandLineOption& option)
+    {
+        if (!valid && ok)
+        {
+            qCritical() << "Invalid value for" << option.names().last() << parser.value(option);
+            ok = false;
+        }
+    };
+    bool valid = false;
+    settings.host = parser.value(hostOption);
+    settings.port = parser.value(portOption).toUShort(&valid);
+    check(valid, portOption);
+    settings.connections = parser.value(connectionsOption).toInt(&valid);
+    check(valid && settings.connections > 0, connectionsOption);
+    settings.messagesPerConnection = parser.value(messagesOption).toLongLong(&valid);
+    check(valid, messagesOption);
+    settings.rate = parser.value(rateOption).toDouble(&valid);
+    check(valid && settings.rate >= 0, rateOption);
+    auto sizes = parser.value(sizeOption).split(':');
+    settings.minSize = sizes.value(0).toInt(&valid);
+    check(valid && settings.minSize >= 0, sizeOption);
+    settings.maxSize = sizes.size() > 1 ? sizes.value(1).toInt(&valid) : settings.minSize;
+    check(valid && settings.maxSize >= settings.minSize, sizeOption);
+    check(LoadGenerator::parseSizeDistribution(parser.value(distributionOption), settings.sizeDistribution), distributionOption);
+    settings.multilineRatio = parser.value(multilineOption).toDouble(&valid);
+    check(valid, multilineOption);
+    check(LoadGenerator::parseSeverityMix(parser.value(severityOption), settings.severityMix), severityOption);
+    settings.stampLatency = parser.isSet(stampOption);
+    settings.seed = parser.value(seedOption).toUInt(&valid);
+    check(valid, seedOption);
+    settings.localName = parser.value(localOption);
+    if (parser.isSet(sharedMemoryOption))
+    {
+        settings.ringCapacity = parser.value(sharedMemoryOption).toUInt(&valid);
+        check(valid && settings.ringCapacity > 0 && settings.ringCapacity <= SharedRing::MAX_CAPACITY, sharedMemoryOption);
+    }
+    if (!ok)
+    {
+        return 1;
+    }
+
+    LoadGenerator generator(settings);
+    if (parser.isSet(replayOption))
+    {
+        QVector<LogMessage*> messages;
+        QString error;
+        if (!LogStorage::load(parser.value(replayOption), messages, &error) || messages.isEmpty())
+        {
+            qDeleteAll(messages);
+            qCritical() << "Could not read" << parser.value(replayOption) << error;
+            return 1;
+        }
+        generator.setReplayMessages(messages);
+    }
+
+    QObject::connect(&generator, &LoadGenerator::finished, &a, [&]()
+    {
+        auto seconds = std::max<qint64>(1, generator.elapsed()) / 1000.0;
+        QTextStream(stdout) << "sent " << generator.sentMessages() << " messages, " << generator.sentBytes() << " bytes in "
+                            << seconds << " s (" << qint64(generator.sentMessages() / seconds) << " msg/s)\n";
+        QCoreApplication::quit();
+    });
+    generator.start();
+    return a.exec();
+}